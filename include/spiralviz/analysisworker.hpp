@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/capturetimeline.hpp>
+#include <spiralviz/dsp/spectrumformat.hpp>
+#include <spiralviz/dsp/spectrumlayout.hpp>
+#include <spiralviz/fftstreamer.hpp>
+#include <spiralviz/util/realtime.hpp>
+#include <spiralviz/util/triplebuffer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// A spectrum as published by `AnalysisWorker`, with everything needed to
+/// display it.
+struct SpectrumFrame
+{
+    /// Output of the selected channel or mix, see `FFTStreamer::update_fft`,
+    /// in the format of `AnalysisWorker::set_output_format`.
+    EncodedSpectrum magnitudes;
+
+    /// Per-channel magnitudes, only when all channels get analyzed.
+    std::vector<EncodedSpectrum> channel_magnitudes;
+
+    SpectrumLayout layout;
+    std::size_t sample_rate = 0;
+    std::optional<CaptureClock::time_point> capture_time;
+
+    /// Increments with every published frame, starting from 1. 0 means that
+    /// nothing was published yet.
+    std::uint64_t sequence = 0;
+};
+
+/// What the GUI shows of a `FFTPlan`.
+struct PlanStatus
+{
+    PlanRigor rigor = PlanRigor::ESTIMATE;
+    bool from_wisdom = false;
+    std::chrono::steady_clock::duration planning_time{};
+    double mean_execute_us = 0.0;
+    std::size_t batch_count = 1;
+    std::size_t thread_count = 1;
+};
+
+/// Copy of the streamer state the GUI shows, taken by the analysis thread so
+/// that the GUI never has to stall it. See `FFTStreamer` for the fields.
+struct StreamerStatus
+{
+    struct MultiResolutionStatus
+    {
+        MultiResolutionConfig config;
+        std::vector<SpectrumBand> bands;
+    };
+
+    struct SlidingDFTStatus
+    {
+        SlidingDFTConfig config;
+        std::size_t window_size = 0;
+        std::size_t tracked_bin_count = 0;
+    };
+
+    FFTHighLevelConfig hl_config = default_hl_config;
+    FFTConfig config{};
+    bool window_pending = false;
+    std::string window_error;
+
+    SpectrumEngine engine = SpectrumEngine::LINEAR_FFT;
+    bool engine_pending = false;
+
+    /// Analysis of the first channel by the engine in use, if any.
+    std::optional<MultiResolutionStatus> multiresolution;
+    std::optional<SlidingDFTStatus> sliding_dft;
+
+    std::size_t source_rate = 0;
+    std::size_t analysis_rate = 0;
+    bool resampling = false;
+
+    std::size_t channel_count = 0;
+    ChannelSelection selected_channels;
+    bool analyze_all_channels = false;
+
+    std::size_t hop_size = 0;
+    std::size_t batch_hops = 0;
+    BacklogConfig backlog_config;
+    BacklogStats backlog_stats;
+
+    PlanStatus plan;
+    std::optional<PlanStatus> replaced_plan;
+    std::optional<PlanStatus> batch_plan;
+
+    /// Counters of the sample source.
+    std::size_t queued_samples = 0;
+    std::uint64_t dropped_samples = 0;
+    std::uint64_t overwritten_samples = 0;
+
+    SpectrumFormat output_format = SpectrumFormat::FLOAT;
+    LogLevelRange log_level_range;
+};
+
+/// Runs the analysis of a `FFTStreamer` on its own thread, as audio arrives,
+/// and hands the resulting spectra over to a single consumer (the render
+/// loop) through a `TripleBuffer`.
+///
+/// Neither side waits on the other to produce or consume spectra. Other
+/// threads do not touch the streamer either: they `post` setting changes,
+/// which the analysis thread runs in between updates, and read its state from
+/// the `status` published along with every spectrum.
+class AnalysisWorker
+{
+    public:
+    explicit AnalysisWorker(FFTStreamer* streamer) :
+        m_streamer{*streamer}
+    {}
+
+    ~AnalysisWorker();
+
+    AnalysisWorker(const AnalysisWorker&) = delete;
+    AnalysisWorker& operator=(const AnalysisWorker&) = delete;
+
+    /// Spawns the analysis thread, which applies `schedule` to itself. The
+    /// streamer must only be used through `post` from then on.
+    void start(const ThreadSchedule& schedule = {});
+
+    /// Runs `command` on the analysis thread before its next update, in the
+    /// order of posting. Runs it right away if not started yet.
+    void post(std::function<void(FFTStreamer&)> command);
+
+    /// Format the spectra get published in. Once started, only change it from
+    /// a posted command.
+    void set_output_format(SpectrumFormat format, const LogLevelRange& range = {})
+    {
+        m_format = format;
+        m_log_range = range;
+    }
+
+    SpectrumFormat output_format() const { return m_format; }
+    const LogLevelRange& log_level_range() const { return m_log_range; }
+
+    /// Consumer: switches to the newest spectrum, returning whether there was
+    /// one since the last call.
+    bool fetch_latest();
+
+    /// Consumer: newest spectrum fetched so far.
+    const SpectrumFrame& latest() const { return m_frames.read_slot(); }
+
+    /// Consumer: spectra that got replaced by newer ones before being fetched.
+    std::uint64_t skipped_frames() const { return m_skipped_frames; }
+
+    /// Spectra published so far.
+    std::uint64_t published_frames() const { return m_published.load(std::memory_order_relaxed); }
+
+    /// Consumer: switches to the newest streamer status, published along with
+    /// every spectrum and after posted commands ran. Returns whether there
+    /// was one since the last call.
+    bool fetch_status() { return m_status.fetch(); }
+
+    /// Consumer: newest streamer status fetched so far.
+    const StreamerStatus& status() const { return m_status.read_slot(); }
+
+    private:
+    void worker_loop(ThreadSchedule schedule);
+
+    /// Runs the posted commands, returning whether there were any.
+    bool run_commands();
+
+    /// Fills the write slot with the output of the last update.
+    void fill_frame(SpectrumFrame& frame, std::span<const float> magnitudes);
+
+    /// Copies the current state of the streamer into `status`.
+    void fill_status(StreamerStatus& status);
+
+    FFTStreamer& m_streamer;
+
+    std::mutex m_command_lock;
+    std::vector<std::function<void(FFTStreamer&)>> m_commands;
+    std::vector<std::function<void(FFTStreamer&)>> m_running_commands; // analysis thread only
+
+    SpectrumFormat m_format = SpectrumFormat::FLOAT;
+    LogLevelRange m_log_range;
+
+    TripleBuffer<SpectrumFrame> m_frames;
+    TripleBuffer<StreamerStatus> m_status;
+    std::atomic<std::uint64_t> m_published = 0;
+    std::uint64_t m_skipped_frames = 0; // consumer only
+
+    std::atomic<bool> m_stop = false;
+    std::thread m_thread;
+};
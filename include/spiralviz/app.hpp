@@ -6,18 +6,21 @@
 #include <SFML/Window.hpp>
 #include <SFML/Graphics.hpp>
 
+#include <spiralviz/analysisworker.hpp>
 #include <spiralviz/gui/audioinput.hpp>
 #include <spiralviz/gui/vizshader.hpp>
 #include <spiralviz/gui/fftdebug.hpp>
 #include <spiralviz/gui/noterender.hpp>
 #include <spiralviz/fftstreamer.hpp>
+#include <spiralviz/options.hpp>
+#include <spiralviz/util/latencystats.hpp>
 
 #include <optional>
 
 class App
 {
     public:
-    App();
+    App(const Options& options);
 
     void show_until_closed();
 
@@ -26,21 +29,33 @@ class App
 
     void handle_event(const sf::Event& ev);
 
-    void update_fft(sf::Time dt);
+    /// Uploads the newest spectrum published by the analysis thread, if any.
+    void update_fft();
 
-    void show_main_bar_gui();
+    /// Records how old the spectrum was when it first got on screen.
+    void record_display_latency();
 
-    double m_samples_dt = 0.0;
+    void show_main_bar_gui();
 
     sf::RenderWindow m_window;
 
     FFTStreamer m_streamer;
-    FFTHighLevelConfig m_hl_config = default_hl_config;
+
+    // After the streamer, so that its thread stops before the streamer goes
+    AnalysisWorker m_analysis;
+
+    AudioDeviceRegistry m_devices;
 
     VizShader m_viz;
 
     NoteRender m_note_render;
 
+    // Frequencies the analysis was last told to cover
+    FrequencyRange m_visible_range;
+
+    LatencyStats m_latency;
+    bool m_fft_texture_displayed = true;
+
     // Debug GUIs at the end since they refer to our fields
     FFTDebugGUI m_fft_gui;
     AudioInputGUI m_audio_input_gui;
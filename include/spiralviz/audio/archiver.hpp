@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/ringbuffer.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+
+struct ArchiveParams
+{
+    std::string path;
+    std::size_t sample_rate = 44100;
+    std::size_t channel_count = 1;
+
+    /// Audio the ring can hold while the writer is stalled on I/O, beyond
+    /// which captured blocks get dropped from the archive.
+    std::size_t buffer_ms = 4000;
+
+    /// Size of every write, except for the last one. Rounded up to a multiple
+    /// of the page size.
+    std::size_t write_block_bytes = 1 << 20;
+};
+
+/// Records captured audio losslessly to 16-bit PCM WAV files, as-is.
+///
+/// Blocks get copied from the capture callback into a preallocated ring, so
+/// the capture thread never waits on I/O: if the ring is full, the whole block
+/// is dropped and accounted for. A writer thread drains the ring in large
+/// page-aligned writes (the data chunk starts on a page boundary, padded with
+/// a JUNK chunk), and keeps the header sizes up to date after every write so
+/// that a crash leaves a playable file behind.
+///
+/// Memory usage is constant whatever the length of the session. Once a file
+/// approaches the 4GiB RIFF limit, the archive continues in a new file named
+/// after the first, e.g. `session-1.wav`.
+class CaptureArchiver
+{
+    public:
+    /// Throws `std::runtime_error` if the file cannot be created.
+    explicit CaptureArchiver(ArchiveParams params);
+
+    /// Writes whatever is left in the ring, then finalizes the file.
+    ~CaptureArchiver();
+
+    CaptureArchiver(const CaptureArchiver&) = delete;
+    CaptureArchiver& operator=(const CaptureArchiver&) = delete;
+
+    /// Capture thread: queues a block of interleaved samples, or drops it if
+    /// it does not fit in the ring. Never blocks. Only one thread may push at
+    /// a time, another one taking over only once the first one is done.
+    void push(std::span<const std::int16_t> interleaved);
+
+    const ArchiveParams& params() const { return m_params; }
+
+    std::uint64_t bytes_written() const { return m_bytes_written.load(std::memory_order_relaxed); }
+
+    /// Bytes per second over the time spent in write calls, i.e. how fast the
+    /// disk accepts the archive.
+    double write_throughput() const;
+
+    /// Most bytes the ring ever held, out of `buffer_capacity()`.
+    std::size_t high_water_mark() const { return m_high_water_mark.load(std::memory_order_relaxed); }
+    std::size_t buffer_capacity() const { return m_ring.capacity() * sizeof(std::int16_t); }
+
+    /// Captured blocks that are missing from the archive.
+    std::uint64_t dropped_blocks() const { return m_dropped_blocks.load(std::memory_order_relaxed); }
+
+    /// Number of files written to so far.
+    std::size_t segment_count() const { return m_segment_count.load(std::memory_order_relaxed); }
+
+    /// Whether writing failed, after which nothing more gets archived.
+    bool failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+    private:
+    struct AlignedDeleter
+    {
+        void operator()(std::int16_t* ptr) const;
+    };
+
+    void writer_loop();
+
+    /// Moves samples from the ring to the write buffer, writing every block
+    /// that gets filled. With `flush`, also writes a partial block.
+    void drain(bool flush);
+
+    void write_block(std::size_t bytes);
+    void open_segment();
+    void close_segment();
+    void update_header();
+
+    ArchiveParams m_params;
+    std::size_t m_frame_bytes;
+    std::uint64_t m_segment_limit;
+
+    SPSCRingBuffer<std::int16_t> m_ring;
+
+    std::unique_ptr<std::int16_t[], AlignedDeleter> m_block;
+    std::size_t m_block_fill = 0; // in samples
+
+    int m_fd = -1;
+    std::uint64_t m_segment_data_bytes = 0;
+
+    std::atomic<std::uint64_t> m_bytes_written = 0;
+    std::atomic<std::uint64_t> m_write_ns = 0;
+    std::atomic<std::size_t> m_high_water_mark = 0;
+    std::atomic<std::uint64_t> m_dropped_blocks = 0;
+    std::atomic<std::size_t> m_segment_count = 0;
+    std::atomic<bool> m_failed = false;
+
+    std::atomic<bool> m_stop_requested = false;
+    std::thread m_writer;
+};
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/ringbuffer.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+using CaptureClock = std::chrono::steady_clock;
+
+/// Maps frames of a queue to the monotonic time they were captured at.
+///
+/// The producer stamps every block it pushes with the time it received it,
+/// through a ring of its own next to the sample queue, so that the sample
+/// data itself stays untouched. The consumer advances along with what it
+/// consumes from the queue, and can then tell when its newest consumed frame
+/// was captured, interpolating within a block at the sample rate.
+class CaptureTimeline
+{
+    public:
+    explicit CaptureTimeline(std::size_t max_blocks = 8192);
+
+    /// Consumer: rate used to interpolate within blocks. Until it is set,
+    /// frames get the capture time of the block they belong to.
+    void set_sample_rate(std::size_t sample_rate) { m_sample_rate = sample_rate; }
+
+    /// Producer: records that `frame_count` more frames were queued, the last
+    /// of which was captured at `captured_at`. If stamps are not consumed fast
+    /// enough, the next ones get dropped, which only loses precision.
+    void stamp(std::size_t frame_count, CaptureClock::time_point captured_at = CaptureClock::now());
+
+    /// Consumer: `frame_count` more frames were consumed or discarded.
+    void advance(std::size_t frame_count);
+
+    /// Consumer: capture time of the newest consumed frame, if any frame was
+    /// both stamped and consumed yet.
+    std::optional<CaptureClock::time_point> last_consumed_time() const { return m_last_consumed_time; }
+
+    private:
+    struct BlockStamp
+    {
+        std::uint64_t end_frame; // frames queued up to and including the block
+        CaptureClock::time_point captured_at;
+    };
+
+    CaptureClock::duration frames_duration(std::uint64_t frame_count) const;
+
+    SPSCRingBuffer<BlockStamp> m_stamps;
+
+    // Producer side
+    std::uint64_t m_stamped_frames = 0;
+
+    // Consumer side
+    std::size_t m_sample_rate = 0;
+    std::uint64_t m_consumed_frames = 0;
+    std::optional<BlockStamp> m_last_stamp;
+    std::optional<CaptureClock::time_point> m_last_consumed_time;
+};
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct AudioDeviceCapabilities
+{
+    /// Whether the device was actually probed. If not, the other fields are
+    /// empty and nothing is known about the device, e.g. because it was in
+    /// use and could not be opened.
+    bool probed = false;
+
+    /// Rates that capture could be opened with, among common ones.
+    std::vector<std::size_t> sample_rates;
+
+    std::size_t max_channels = 0;
+
+    bool supports(std::size_t sample_rate, std::size_t channel_count) const;
+};
+
+struct AudioDeviceInfo
+{
+    std::string name;
+    bool is_default = false;
+    AudioDeviceCapabilities capabilities;
+};
+
+/// Immutable list of the capture devices at some point in time.
+struct AudioDeviceSnapshot
+{
+    std::vector<AudioDeviceInfo> devices;
+    std::chrono::steady_clock::time_point refreshed_at;
+
+    /// Incremented on every refresh that changed the list.
+    std::uint64_t generation = 0;
+
+    /// Returns null if there is no such device.
+    const AudioDeviceInfo* find(std::string_view name) const;
+};
+
+/// Keeps an up-to-date list of capture devices, without ever querying the
+/// audio backend from the calling thread.
+///
+/// A background thread refreshes the list periodically, as well as on
+/// hotplug when `/dev/snd` can be watched. Capabilities are probed once per
+/// newly seen device, and again after a hotplug. Busy devices get probed on
+/// every refresh until they can be opened. Readers get the latest snapshot
+/// with a single atomic load.
+class AudioDeviceRegistry
+{
+    public:
+    /// `active_device` names the device capture currently runs on, if any. It
+    /// gets called from the background thread. That device is left unprobed
+    /// until capture moves off it, since opening it again can glitch capture.
+    explicit AudioDeviceRegistry(
+        std::chrono::milliseconds refresh_interval = std::chrono::seconds{5},
+        std::function<std::string()> active_device = {}
+    );
+    ~AudioDeviceRegistry();
+
+    AudioDeviceRegistry(const AudioDeviceRegistry&) = delete;
+    AudioDeviceRegistry& operator=(const AudioDeviceRegistry&) = delete;
+
+    /// Never null; empty until the first refresh completes.
+    std::shared_ptr<const AudioDeviceSnapshot> snapshot() const
+    {
+        return m_snapshot.load(std::memory_order_acquire);
+    }
+
+    /// Asks for a refresh as soon as possible, without waiting for it.
+    void request_refresh() { m_refresh_requested.store(true, std::memory_order_relaxed); }
+
+    /// Whether capabilities can be probed at all in this build.
+    static bool can_probe_capabilities();
+
+    private:
+    void monitor_loop();
+    void refresh();
+
+    /// Returns true if the device nodes changed since the last call.
+    bool drain_hotplug_events();
+
+    std::chrono::milliseconds m_refresh_interval;
+    std::function<std::string()> m_active_device;
+
+    std::atomic<std::shared_ptr<const AudioDeviceSnapshot>> m_snapshot;
+
+    // Only accessed from the monitor thread. Dropped on hotplug, since a
+    // device may come back under the same name.
+    std::map<std::string, AudioDeviceCapabilities> m_capability_cache;
+    int m_inotify_fd = -1;
+
+    std::atomic<bool> m_refresh_requested = true;
+    std::atomic<bool> m_stop_requested = false;
+    std::thread m_monitor;
+};
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/samplesource.hpp>
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class PlaybackPacing
+{
+    /// Samples become available at the rate at which they would be captured.
+    REALTIME,
+    /// The whole file is available right away, for offline analysis and
+    /// benchmarking.
+    AS_FAST_AS_POSSIBLE
+};
+
+struct RawPCMParams
+{
+    SampleFormat format = SampleFormat::S16;
+    std::size_t sample_rate = 44100;
+    std::size_t channel_count = 1; // interleaved
+};
+
+/// Read-only memory mapping of a whole file.
+class MappedFile
+{
+    public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<const std::byte> bytes() const { return {m_data, m_size}; }
+
+    private:
+    const std::byte* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+/// Serves samples from a memory-mapped WAV or headerless PCM file, without
+/// copying or decoding them: the views point straight into the mapping, strided
+/// for files with several interleaved channels.
+///
+/// Only little-endian 16-bit integer and 32-bit float files are supported, as
+/// those map directly to a `SampleFormat`.
+class FileSampleSource : public SampleSource
+{
+    public:
+    /// Opens a WAV file, or a headerless PCM file if `raw_params` is set.
+    /// Throws `std::runtime_error` if the file is missing or unsupported.
+    FileSampleSource(
+        const std::string& path,
+        PlaybackPacing pacing = PlaybackPacing::REALTIME,
+        std::optional<RawPCMParams> raw_params = std::nullopt
+    );
+
+    std::size_t sample_rate() const override { return m_sample_rate; }
+    SampleFormat format() const override { return m_channels.front().format(); }
+    std::size_t channel_count() const override { return m_channels.size(); }
+
+    SampleViews peek(std::size_t channel, std::size_t max_count = std::numeric_limits<std::size_t>::max()) override;
+    std::size_t consume(std::size_t count) override;
+    std::size_t discard(std::size_t count = std::numeric_limits<std::size_t>::max()) override;
+    std::size_t available() const override;
+
+    bool exhausted() const override { return m_cursor == total_samples(); }
+
+    std::uint64_t overwritten_samples() const override { return m_overwritten; }
+
+    /// Length of the file, in frames.
+    std::size_t total_samples() const { return m_channels.front().size(); }
+
+    private:
+    void parse_wav();
+    void use_data(std::span<const std::byte> data, SampleFormat format, std::size_t channel_count);
+
+    /// How many samples have "arrived" so far with the current pacing.
+    std::size_t arrived_samples() const;
+
+    MappedFile m_file;
+    PlaybackPacing m_pacing;
+
+    std::size_t m_sample_rate = 0;
+    std::vector<SampleSpan> m_channels;
+    std::size_t m_cursor = 0;
+    std::uint64_t m_overwritten = 0;
+
+    // Only used when float data is misaligned in the file, which a WAV file
+    // with odd-sized chunks can cause.
+    std::vector<float> m_realigned;
+
+    // Lazily set on the first `peek` so that the time spent loading up the
+    // rest of the application does not count as playback.
+    mutable std::optional<std::chrono::steady_clock::time_point> m_start_time;
+};
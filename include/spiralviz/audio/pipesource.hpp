@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/filesource.hpp>
+#include <spiralviz/audio/samplequeue.hpp>
+#include <spiralviz/audio/samplesource.hpp>
+#include <spiralviz/util/realtime.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct PipeSourceParams
+{
+    /// Path to a named FIFO, or "-" for the standard input.
+    std::string path = "-";
+    RawPCMParams pcm;
+
+    /// Frames requested per `read` call. Larger blocks mean fewer syscalls,
+    /// smaller ones mean samples get to the analysis sooner.
+    std::size_t block_samples = 1024;
+
+    /// How many blocks may be queued ahead of the analysis before the reader
+    /// stops reading, pushing back on the writer.
+    std::size_t read_ahead_blocks = 64;
+
+    /// Scheduling of the reader thread.
+    ThreadSchedule reader_schedule;
+};
+
+/// Streams headerless PCM from the standard input or a named FIFO.
+///
+/// A reader thread polls the input, performs large reads and deinterleaves the
+/// samples into a `MultiChannelQueue`, without any conversion. When the queue
+/// is full, it sleeps until the analysis consumes samples. When the writer of a FIFO goes
+/// away, the FIFO is reopened to wait for the next one; EOF on the standard
+/// input ends the stream.
+class PipeSampleSource : public SampleSource
+{
+    public:
+    /// Throws `std::runtime_error` if the path cannot be opened.
+    PipeSampleSource(PipeSourceParams params);
+    ~PipeSampleSource() override;
+
+    std::size_t sample_rate() const override { return m_params.pcm.sample_rate; }
+    SampleFormat format() const override { return m_queue.format(); }
+    std::size_t channel_count() const override { return m_queue.channel_count(); }
+
+    SampleViews peek(std::size_t channel, std::size_t max_count = std::numeric_limits<std::size_t>::max()) override;
+    std::size_t consume(std::size_t count) override;
+    std::size_t discard(std::size_t count = std::numeric_limits<std::size_t>::max()) override;
+    std::size_t available() const override;
+
+    bool exhausted() const override;
+
+    std::uint64_t dropped_samples() const override { return m_queue.dropped_count(); }
+    std::uint64_t overwritten_samples() const override { return m_queue.overwritten_count(); }
+
+    /// Time samples were received from the pipe, rather than captured.
+    std::optional<CaptureClock::time_point> last_capture_time() const override { return m_timeline.last_consumed_time(); }
+
+    /// Times the reader waited a whole poll interval without receiving data.
+    std::uint64_t stall_count() const { return m_stalls.load(std::memory_order_relaxed); }
+
+    /// Reads that returned less than a full block.
+    std::uint64_t short_read_count() const { return m_short_reads.load(std::memory_order_relaxed); }
+
+    /// Times the queue filled up and the reader had to wait for the analysis to
+    /// free up space, counting each wait once however long it lasts.
+    std::uint64_t queue_full_count() const { return m_queue_full.load(std::memory_order_relaxed); }
+
+    const PipeSourceParams& params() const { return m_params; }
+
+    private:
+    void open_input();
+    void reader_loop();
+
+    /// Wakes the reader up if it is waiting for queue space.
+    void notify_space();
+
+    /// Pushes the whole frames contained in `m_staging`, keeping any trailing
+    /// partial frame for the next read.
+    void push_staged(std::size_t staged_bytes);
+
+    PipeSourceParams m_params;
+    MultiChannelQueue m_queue;
+    CaptureTimeline m_timeline;
+
+    int m_fd = -1;
+    bool m_is_stdin;
+
+    std::vector<std::byte> m_staging;
+    std::size_t m_partial_bytes = 0;
+
+    std::atomic<bool> m_stop_requested = false;
+    std::atomic<bool> m_end_of_stream = false;
+
+    std::atomic<std::uint64_t> m_stalls = 0;
+    std::atomic<std::uint64_t> m_short_reads = 0;
+    std::atomic<std::uint64_t> m_queue_full = 0;
+
+    std::mutex m_space_mutex;
+    std::condition_variable m_space_cv;
+
+    std::thread m_reader;
+};
@@ -3,30 +3,222 @@
 
 #pragma once
 
+#include <spiralviz/audio/archiver.hpp>
+#include <spiralviz/audio/capturetimeline.hpp>
+#include <spiralviz/audio/samplequeue.hpp>
+#include <spiralviz/audio/samplesource.hpp>
+#include <spiralviz/util/realtime.hpp>
+
 #include <SFML/Audio.hpp>
-#include <deque>
+#include <atomic>
+#include <condition_variable>
 #include <limits>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Roughly 6 seconds of audio at 44.1kHz, plenty for a render loop hitch.
+constexpr std::size_t default_recorder_queue_capacity = 1 << 18;
 
-class SampleQueueRecorder : public sf::SoundRecorder
+/// A single SFML capture stream, deinterleaving into its own queue.
+///
+/// The queue is left untouched when capture stops, so that whatever was
+/// captured can still be consumed.
+class CaptureStream : public sf::SoundRecorder
 {
     public:
-    SampleQueueRecorder();
+    /// With `SampleFormat::S16`, captured samples are queued as-is and the
+    /// capture thread does nothing beyond deinterleaving them.
+    ///
+    /// SFML only supports capturing 1 or 2 channels.
+    CaptureStream(SampleFormat queue_format, std::size_t channel_count, std::size_t queue_capacity);
+    ~CaptureStream() override;
 
     // SFML overrides
-    // bool onStart() override;
+    bool onStart() override;
     bool onProcessSamples(const sf::Int16* samples, std::size_t sampleCount) override;
     void onStop() override;
 
-    std::size_t consume_n_oldest(
-        std::vector<float>& target,
-        std::size_t desired = std::numeric_limits<std::size_t>::max()
+    /// Whether the capture thread is done with its last block, or was never
+    /// started. It then stays out of the queue and archiver until restarted.
+    bool is_stopped() const { return m_stopped.load(std::memory_order_acquire); }
+
+    /// Gets applied to the capture thread as soon as it runs. Must be set
+    /// before `start`.
+    void set_schedule(const ThreadSchedule& schedule) { m_schedule = schedule; }
+
+    /// Tees every captured block to `archiver`, if not null. The archiver must
+    /// outlive the capture thread or be unset first. As it takes blocks from a
+    /// single thread, no other stream may be capturing into it meanwhile.
+    void set_archiver(CaptureArchiver* archiver) { m_archiver.store(archiver, std::memory_order_release); }
+
+    MultiChannelQueue& queue() { return m_queue; }
+    const MultiChannelQueue& queue() const { return m_queue; }
+
+    /// Capture times of the frames in `queue()`, which the consumer must
+    /// advance along with it.
+    CaptureTimeline& timeline() { return m_timeline; }
+
+    private:
+    MultiChannelQueue m_queue;
+    CaptureTimeline m_timeline;
+
+    ThreadSchedule m_schedule;
+    bool m_schedule_applied = false; // reset by `onStart`, then capture thread only
+    std::atomic<CaptureArchiver*> m_archiver = nullptr;
+    std::atomic<bool> m_stopped = true;
+};
+
+struct DeviceSwitchConfig
+{
+    /// Length of the crossfade between the old and new device. 0 cuts over
+    /// without crossfading.
+    std::size_t crossfade_ms = 20;
+
+    /// Audio of the new device dropped before cutting over, which leaves
+    /// some time for its first blocks to settle.
+    std::size_t warmup_ms = 50;
+};
+
+/// Live capture source, which can switch devices without clearing what was
+/// captured so far.
+///
+/// Switching opens the new device on a second `CaptureStream`, on a
+/// background thread as opening can take hundreds of milliseconds. SFML only
+/// allows a single capture at a time, so the old device stops right before,
+/// and there is a gap in the audio as long as opening takes. Meanwhile, the
+/// consumer keeps draining what the old device captured. Once the new stream
+/// warmed up, it crossfades from the last frames of the old device into the
+/// new device, then follows it.
+class SampleQueueRecorder : public SampleSource
+{
+    public:
+    SampleQueueRecorder(
+        SampleFormat queue_format = SampleFormat::S16,
+        std::size_t channel_count = 1,
+        std::size_t queue_capacity = default_recorder_queue_capacity
     );
-    void discard_n_oldest(std::size_t count = std::numeric_limits<std::size_t>::max());
+    ~SampleQueueRecorder() override;
+
+    /// Starts capturing from the default device.
+    bool start(std::size_t sample_rate);
+
+    /// Starts capturing from `device` instead of the current device, as
+    /// described above. Returns right away, the device gets opened in the
+    /// background. If it cannot be, the current device gets restarted and
+    /// `failed_device` tells. Requests made while opening are handled in
+    /// turn, only the newest one is kept.
+    void switch_device(const std::string& device);
+
+    /// Whether a switch is still opening the new device or waiting for it to
+    /// warm up.
+    bool is_switching() const { return m_switching.load(std::memory_order_acquire); }
+
+    /// Device the last switch failed to open, empty if it did not fail.
+    std::string failed_device() const;
+
+    /// Name of the device currently feeding the analysis.
+    std::string device() const;
+
+    /// Archives everything the device feeding the analysis captures from now
+    /// on. Must be set before `start`.
+    void set_archiver(std::unique_ptr<CaptureArchiver> archiver);
+    const CaptureArchiver* archiver() const { return m_archiver.get(); }
 
-    std::size_t num_available_samples() const;
+    /// Scheduling of the capture threads. Must be set before `start`.
+    void set_capture_schedule(const ThreadSchedule& schedule);
+
+    void set_switch_config(const DeviceSwitchConfig& config) { m_switch_config = config; }
+    const DeviceSwitchConfig& switch_config() const { return m_switch_config; }
+
+    // SampleSource overrides
+    std::size_t sample_rate() const override { return m_sample_rate; }
+    SampleFormat format() const override { return m_format; }
+    std::size_t channel_count() const override { return m_channel_count; }
+
+    SampleViews peek(std::size_t channel, std::size_t max_count = std::numeric_limits<std::size_t>::max()) override;
+    std::size_t consume(std::size_t count) override;
+    std::size_t discard(std::size_t count = std::numeric_limits<std::size_t>::max()) override;
+    std::size_t available() const override;
+
+    std::uint64_t dropped_samples() const override;
+    std::uint64_t overwritten_samples() const override;
+
+    std::optional<CaptureClock::time_point> last_capture_time() const override { return m_last_capture_time; }
 
     private:
-    mutable std::mutex m_stream_lock;
-    std::deque<float> m_sample_stream;
-};
\ No newline at end of file
+    std::unique_ptr<CaptureStream> make_stream() const;
+
+    /// Opens the devices `switch_device` asks for.
+    void opener_loop();
+
+    /// Takes the stream the opener started, then cuts over to it once it
+    /// warmed up.
+    void update_switch();
+
+    /// Destroys the drained stream, once it is no longer needed.
+    void finish_draining();
+
+    /// Updates `m_switching`, with `m_switch_lock` held.
+    void update_switching();
+
+    /// Pops or discards `count` frames across the draining, crossfade and
+    /// live segments, in that order.
+    std::size_t release(std::size_t count, bool discard);
+
+    SampleFormat m_format;
+    std::size_t m_channel_count;
+    std::size_t m_queue_capacity;
+    std::size_t m_sample_rate = 0;
+
+    DeviceSwitchConfig m_switch_config;
+    ThreadSchedule m_capture_schedule;
+
+    // Declared before the streams, so that it outlives their capture threads
+    std::unique_ptr<CaptureArchiver> m_archiver;
+
+    std::unique_ptr<CaptureStream> m_active;
+    std::unique_ptr<CaptureStream> m_pending;
+
+    // Shared with the opener thread and `switch_device`. The opener hands
+    // over started streams in `m_opened`, and `m_switch_changed` tells the
+    // consumer to look without taking the lock on every peek.
+    //
+    // Every stream but the newest one handed over got stopped by the opener,
+    // which may still restart that one. The consumer thus only ever destroys
+    // stopped streams, whose capture thread was joined.
+    mutable std::mutex m_switch_lock;
+    std::condition_variable m_switch_cv;
+    std::optional<std::string> m_open_request;
+    bool m_opening = false;
+    std::unique_ptr<CaptureStream> m_opened;
+    bool m_cutover_pending = false; // the consumer holds a stream in `m_pending`
+    CaptureStream* m_capturing = nullptr; // newest stream started, opener only once started
+    std::string m_device;
+    std::string m_failed_device;
+    bool m_stop_opener = false;
+    std::atomic<bool> m_switch_changed = false;
+    std::atomic<bool> m_switching = false;
+
+    // Old stream being drained after a cut-over, and how many of its frames
+    // remain before the crossfade
+    std::unique_ptr<CaptureStream> m_draining;
+    std::size_t m_draining_remaining = 0;
+
+    // Per-channel crossfaded frames, in the queue format
+    std::vector<std::vector<float>> m_crossfade_f32;
+    std::vector<std::vector<std::int16_t>> m_crossfade_s16;
+    std::size_t m_crossfade_offset = 0;
+    std::size_t m_crossfade_size = 0;
+
+    std::optional<CaptureClock::time_point> m_last_capture_time;
+
+    // Counters of the streams that were destroyed
+    std::uint64_t m_retired_dropped = 0;
+    std::uint64_t m_retired_overwritten = 0;
+
+    std::thread m_opener; // started on the first switch
+};
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+
+// Not using std::hardware_destructive_interference_size, because GCC warns
+// about it being ABI-unstable whenever it gets used in a header.
+constexpr std::size_t cache_line_size = 64;
+
+/// Readable region of a ring buffer as (at most) two contiguous views. The
+/// `second` view is only non-empty when the readable data wraps around the end
+/// of the storage, in which case it directly follows `first` in time.
+template<class T>
+struct RingReadView
+{
+    std::span<const T> first;
+    std::span<const T> second;
+
+    std::size_t size() const { return first.size() + second.size(); }
+    bool empty() const { return size() == 0; }
+};
+
+/// Writable region of a ring buffer, see `RingReadView`.
+template<class T>
+struct RingWriteView
+{
+    std::span<T> first;
+    std::span<T> second;
+
+    std::size_t size() const { return first.size() + second.size(); }
+    bool empty() const { return size() == 0; }
+};
+
+/// Fixed-capacity lock-free single-producer single-consumer ring buffer.
+///
+/// One thread may use the producer functions (`prepare_write`,
+/// `commit_write`, `push`) while another thread uses the consumer functions
+/// (`peek`, `pop`, `discard`, `clear`) without any locking. The read and write
+/// indices are free-running counters, which is why the capacity always gets
+/// rounded up to a power of two.
+template<class T>
+class SPSCRingBuffer
+{
+    public:
+    explicit SPSCRingBuffer(std::size_t min_capacity) :
+        m_capacity{std::bit_ceil(std::max<std::size_t>(min_capacity, 1))},
+        m_storage{std::make_unique<T[]>(m_capacity)}
+    {}
+
+    SPSCRingBuffer(const SPSCRingBuffer&) = delete;
+    SPSCRingBuffer& operator=(const SPSCRingBuffer&) = delete;
+
+    /// Producer: returns views over the free space for up to `count` items,
+    /// which must then be filled and published with `commit_write`. Whatever
+    /// part of `count` does not fit is accounted for as dropped.
+    RingWriteView<T> prepare_write(std::size_t count)
+    {
+        const std::size_t write = m_write_index.load(std::memory_order_relaxed);
+        const std::size_t read = m_read_index.load(std::memory_order_acquire);
+        const std::size_t granted = std::min(count, m_capacity - (write - read));
+
+        if (granted < count)
+        {
+            m_dropped.fetch_add(count - granted, std::memory_order_relaxed);
+        }
+
+        const std::size_t offset = write & (m_capacity - 1);
+        const std::size_t first_size = std::min(granted, m_capacity - offset);
+
+        return {
+            .first = {m_storage.get() + offset, first_size},
+            .second = {m_storage.get(), granted - first_size}
+        };
+    }
+
+    /// Producer: makes `count` items previously handed out by `prepare_write`
+    /// visible to the consumer.
+    void commit_write(std::size_t count)
+    {
+        const std::size_t write = m_write_index.load(std::memory_order_relaxed);
+        m_write_index.store(write + count, std::memory_order_release);
+    }
+
+    /// Producer: copies as much of `items` as fits. Returns the number of items
+    /// that were actually written.
+    std::size_t push(std::span<const T> items)
+    {
+        const auto views = prepare_write(items.size());
+        std::copy_n(items.begin(), views.first.size(), views.first.begin());
+        std::copy_n(items.begin() + views.first.size(), views.second.size(), views.second.begin());
+        commit_write(views.size());
+        return views.size();
+    }
+
+    /// Consumer: returns views over up to `max_count` of the oldest items. The
+    /// views remain valid until the consumer calls `pop`, `discard` or `clear`.
+    RingReadView<T> peek(std::size_t max_count = std::numeric_limits<std::size_t>::max()) const
+    {
+        const std::size_t read = m_read_index.load(std::memory_order_relaxed);
+        const std::size_t write = m_write_index.load(std::memory_order_acquire);
+        const std::size_t count = std::min(max_count, write - read);
+
+        const std::size_t offset = read & (m_capacity - 1);
+        const std::size_t first_size = std::min(count, m_capacity - offset);
+
+        return {
+            .first = {m_storage.get() + offset, first_size},
+            .second = {m_storage.get(), count - first_size}
+        };
+    }
+
+    /// Consumer: releases up to `count` of the oldest items back to the
+    /// producer. Returns the number of items that were released.
+    std::size_t pop(std::size_t count)
+    {
+        const std::size_t read = m_read_index.load(std::memory_order_relaxed);
+        const std::size_t write = m_write_index.load(std::memory_order_acquire);
+        count = std::min(count, write - read);
+        m_read_index.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+    /// Consumer: like `pop`, but for items that are getting skipped over
+    /// without ever being used, which are accounted for as overwritten.
+    std::size_t discard(std::size_t count = std::numeric_limits<std::size_t>::max())
+    {
+        count = pop(count);
+        m_overwritten.fetch_add(count, std::memory_order_relaxed);
+        return count;
+    }
+
+    /// Consumer: releases everything without accounting for it.
+    void clear() { pop(size()); }
+
+    /// Number of readable items. Exact from the consumer side, and a lower
+    /// bound of the free space from the producer side.
+    std::size_t size() const
+    {
+        // read index first: it can never overtake a write index loaded later
+        const std::size_t read = m_read_index.load(std::memory_order_acquire);
+        return m_write_index.load(std::memory_order_acquire) - read;
+    }
+
+    std::size_t capacity() const { return m_capacity; }
+
+    /// Total number of items ever committed by the producer.
+    std::uint64_t total_written() const { return m_write_index.load(std::memory_order_acquire); }
+
+    /// Items the producer could not write because the buffer was full.
+    std::uint64_t dropped_count() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /// Items the consumer skipped with `discard`.
+    std::uint64_t overwritten_count() const { return m_overwritten.load(std::memory_order_relaxed); }
+
+    private:
+    std::size_t m_capacity;
+    std::unique_ptr<T[]> m_storage;
+
+    // Each index gets its own cache line so that the producer and consumer
+    // cores do not keep invalidating each other's line.
+    alignas(cache_line_size) std::atomic<std::size_t> m_write_index{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+
+    alignas(cache_line_size) std::atomic<std::size_t> m_read_index{0};
+    std::atomic<std::uint64_t> m_overwritten{0};
+};
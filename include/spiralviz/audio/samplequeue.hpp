@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/ringbuffer.hpp>
+#include <spiralviz/audio/samples.hpp>
+
+#include <limits>
+#include <memory>
+#include <variant>
+#include <vector>
+
+/// Lock-free SPSC queue of mono samples stored in a fixed `SampleFormat`.
+///
+/// Pushing samples of another format converts them on the fly. Storing S16
+/// halves the memory footprint and reduces the producer's work to a copy,
+/// leaving the conversion to whoever reads the samples.
+class SampleQueue
+{
+    public:
+    SampleQueue(SampleFormat format, std::size_t capacity);
+
+    SampleFormat format() const { return m_format; }
+
+    // Producer API
+    std::size_t push(SampleSpan samples);
+    std::size_t free_space() const;
+
+    // Consumer API, see `SPSCRingBuffer`
+    SampleViews peek(std::size_t max_count = std::numeric_limits<std::size_t>::max()) const;
+    std::size_t pop(std::size_t count);
+    std::size_t discard(std::size_t count = std::numeric_limits<std::size_t>::max());
+    void clear();
+
+    std::size_t size() const;
+    std::size_t capacity() const;
+    std::uint64_t total_written() const;
+    std::uint64_t dropped_count() const;
+    std::uint64_t overwritten_count() const;
+
+    private:
+    SampleFormat m_format;
+    std::variant<SPSCRingBuffer<float>, SPSCRingBuffer<std::int16_t>> m_ring;
+};
+
+/// One `SampleQueue` per channel, filled from interleaved frames.
+///
+/// The producer deinterleaves whole frames only, so that all channels always
+/// hold the same number of samples from the consumer's point of view.
+/// Consumer operations apply to every channel at once.
+class MultiChannelQueue
+{
+    public:
+    MultiChannelQueue(SampleFormat format, std::size_t channel_count, std::size_t capacity);
+
+    SampleFormat format() const { return m_channels.front()->format(); }
+    std::size_t channel_count() const { return m_channels.size(); }
+
+    // Producer API
+    /// Pushes as many whole frames from `interleaved` as fit in every channel.
+    /// Returns the number of frames that were pushed.
+    std::size_t push_interleaved(std::span<const std::int16_t> interleaved);
+    std::size_t push_interleaved(std::span<const float> interleaved);
+
+    // Consumer API
+    SampleViews peek(std::size_t channel, std::size_t max_count = std::numeric_limits<std::size_t>::max()) const;
+    std::size_t pop(std::size_t count);
+    std::size_t discard(std::size_t count = std::numeric_limits<std::size_t>::max());
+    void clear();
+
+    /// Frames readable in every channel.
+    std::size_t size() const;
+    std::size_t capacity() const { return m_channels.front()->capacity(); }
+    std::size_t free_space() const;
+
+    std::uint64_t dropped_count() const { return m_dropped.load(std::memory_order_relaxed); }
+    std::uint64_t overwritten_count() const { return m_channels.front()->overwritten_count(); }
+
+    private:
+    template<class T>
+    std::size_t push_frames(std::span<const T> interleaved);
+
+    std::vector<std::unique_ptr<SampleQueue>> m_channels;
+    std::atomic<std::uint64_t> m_dropped = 0;
+};
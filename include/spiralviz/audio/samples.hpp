@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <span>
+
+enum class SampleFormat
+{
+    F32 = 0, // float in [-1; 1]
+    S16 = 1  // native signed 16-bit integer, as captured
+};
+
+static constexpr const char* get_sample_format_string(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::F32: return "32-bit float";
+    case SampleFormat::S16: return "16-bit integer";
+    default: return "???";
+    }
+}
+
+constexpr std::size_t sample_format_size(SampleFormat format)
+{
+    return format == SampleFormat::S16 ? sizeof(std::int16_t) : sizeof(float);
+}
+
+/// Factor to apply to a S16 sample to get it in the same [-1; 1] range as F32.
+constexpr float s16_sample_scale = 1.0f / 32768.0f;
+
+constexpr float s16_to_f32(std::int16_t sample)
+{
+    return sample * s16_sample_scale;
+}
+
+inline std::int16_t f32_to_s16(float sample)
+{
+    return std::int16_t(std::clamp(std::lround(sample * 32768.0f), -32768l, 32767l));
+}
+
+/// Non-owning view over samples of a single channel, in either of the
+/// supported sample formats.
+///
+/// Samples may be strided, e.g. when viewing one channel of interleaved data,
+/// in which case they can only be accessed through `copy_samples`.
+class SampleSpan
+{
+    public:
+    SampleSpan() = default;
+
+    SampleSpan(std::span<const float> samples, std::size_t stride = 1) :
+        m_format{SampleFormat::F32},
+        m_data{samples.data()},
+        m_size{samples.size()},
+        m_stride{stride}
+    {}
+
+    SampleSpan(std::span<const std::int16_t> samples, std::size_t stride = 1) :
+        m_format{SampleFormat::S16},
+        m_data{samples.data()},
+        m_size{samples.size()},
+        m_stride{stride}
+    {}
+
+    /// Creates a view over `size` samples of a channel within interleaved
+    /// data, where `first_sample` points to the first sample of that channel.
+    template<class T>
+    static SampleSpan interleaved(const T* first_sample, std::size_t size, std::size_t channel_count)
+    {
+        return SampleSpan{std::span<const T>{first_sample, size}, channel_count};
+    }
+
+    SampleFormat format() const { return m_format; }
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    std::size_t stride() const { return m_stride; }
+    bool contiguous() const { return m_stride == 1 || m_size <= 1; }
+
+    std::span<const float> f32() const
+    {
+        assert((m_format == SampleFormat::F32 && contiguous()) || empty());
+        return {static_cast<const float*>(m_data), m_size};
+    }
+
+    std::span<const std::int16_t> s16() const
+    {
+        assert((m_format == SampleFormat::S16 && contiguous()) || empty());
+        return {static_cast<const std::int16_t*>(m_data), m_size};
+    }
+
+    /// Pointer to the first sample; only meaningful along with `stride`.
+    const void* data() const { return m_data; }
+
+    SampleSpan subspan(std::size_t offset, std::size_t count) const
+    {
+        assert(offset + count <= m_size);
+
+        SampleSpan ret = *this;
+        ret.m_data = static_cast<const char*>(m_data) + offset * m_stride * sample_format_size(m_format);
+        ret.m_size = count;
+        return ret;
+    }
+
+    SampleSpan first(std::size_t count) const { return subspan(0, count); }
+    SampleSpan last(std::size_t count) const { return subspan(m_size - count, count); }
+
+    private:
+    SampleFormat m_format = SampleFormat::F32;
+    const void* m_data = nullptr;
+    std::size_t m_size = 0;
+    std::size_t m_stride = 1;
+};
+
+/// Readable samples of a queue as (at most) two views, see `RingReadView`.
+struct SampleViews
+{
+    SampleSpan first;
+    SampleSpan second;
+
+    std::size_t size() const { return first.size() + second.size(); }
+    bool empty() const { return size() == 0; }
+};
+
+/// Copies samples from `source` (of any format and stride) into `target`,
+/// which must be of the same size, converting them if needed.
+void copy_samples(SampleSpan source, std::span<float> target);
+void copy_samples(SampleSpan source, std::span<std::int16_t> target);
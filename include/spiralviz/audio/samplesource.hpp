@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/capturetimeline.hpp>
+#include <spiralviz/audio/samples.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+/// Anything `FFTStreamer` can pull samples from.
+///
+/// Samples are handed out as per-channel views rather than copied. Counts are
+/// expressed in frames, i.e. one sample of every channel. All of the consumer
+/// functions must be called from the same thread; the source may be filled in
+/// from another one.
+class SampleSource
+{
+    public:
+    virtual ~SampleSource() = default;
+
+    virtual std::size_t sample_rate() const = 0;
+    virtual SampleFormat format() const = 0;
+    virtual std::size_t channel_count() const { return 1; }
+
+    /// Returns views over up to `max_count` of the oldest available samples of
+    /// `channel`. They remain valid until the next call to `consume` or
+    /// `discard`.
+    virtual SampleViews peek(std::size_t channel, std::size_t max_count = std::numeric_limits<std::size_t>::max()) = 0;
+
+    /// Releases `count` frames returned by `peek` once they were used.
+    virtual std::size_t consume(std::size_t count) = 0;
+
+    /// Skips over up to `count` of the oldest frames without using them.
+    virtual std::size_t discard(std::size_t count = std::numeric_limits<std::size_t>::max()) = 0;
+
+    virtual std::size_t available() const = 0;
+
+    /// Whether no samples will ever become available again, e.g. at the end
+    /// of a file.
+    virtual bool exhausted() const { return false; }
+
+    /// Samples lost before they could be made available, e.g. due to a full
+    /// queue.
+    virtual std::uint64_t dropped_samples() const { return 0; }
+
+    /// Samples that got discarded by the consumer without being analyzed.
+    virtual std::uint64_t overwritten_samples() const { return 0; }
+
+    /// When the newest consumed frame was captured, for sources that know,
+    /// e.g. live capture.
+    virtual std::optional<CaptureClock::time_point> last_capture_time() const { return std::nullopt; }
+};
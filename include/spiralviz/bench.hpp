@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/options.hpp>
+
+/// Runs the analysis pipeline over the whole input as fast as possible and
+/// prints timing statistics to stdout. Returns a process exit code.
+int run_benchmark(const Options& options);
+
+/// Times the windowing and magnitude kernels, and whole hops, at window sizes
+/// from 4096 to 131072 samples for every instruction set the CPU supports, and
+/// prints them to stdout. Returns a process exit code.
+int run_kernel_benchmark(const Options& options);
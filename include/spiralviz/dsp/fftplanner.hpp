@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/dsp/windowedfft.hpp>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+struct PlanningConfig
+{
+    /// Rigor of the plans the analysis should end up with.
+    PlanRigor rigor = PlanRigor::MEASURE;
+
+    /// Whether to load and save FFTW wisdom, so that measuring only happens
+    /// once per machine.
+    bool use_wisdom = true;
+
+    /// Empty means a file keyed by the CPU model and features, under the user
+    /// cache directory.
+    std::string wisdom_path;
+
+    /// Threads each FFT may be split over, see `FFTPlan`. 0 lets the analysis
+    /// pick according to the FFT size and the cores left over by channels.
+    std::size_t fft_threads = 0;
+};
+
+/// What a plan gets requested for, see `FFTPlanner::request`.
+enum class PlanSlot
+{
+    WINDOW = 0, // the FFTs of each channel
+    BATCH = 1,  // their batched FFTs, see `FFTStreamer::set_batch_hops`
+    BANDS = 2   // the bands of the multi-resolution engine
+};
+
+/// Hands out FFT plans without ever stalling the caller on measurements.
+///
+/// Wisdom gets loaded on construction. If a plan of the requested rigor can be
+/// made from wisdom, it is returned right away. Otherwise, the caller gets an
+/// `ESTIMATE` plan, while the requested one gets built on a background thread
+/// and can then be swapped in with `take_upgrade`. New wisdom is saved as soon
+/// as a plan got measured.
+///
+/// `request` goes further and never plans on the calling thread at all, for
+/// callers which can keep using their current plan in the meantime.
+class FFTPlanner
+{
+    public:
+    explicit FFTPlanner(PlanningConfig config = {});
+    ~FFTPlanner();
+
+    FFTPlanner(const FFTPlanner&) = delete;
+    FFTPlanner& operator=(const FFTPlanner&) = delete;
+
+    /// Returns the best plan for `size` (and `batch_count` transforms at
+    /// once over up to `thread_count` threads, see `FFTPlan`) available
+    /// without measuring.
+    std::shared_ptr<const FFTPlan> plan(std::size_t size, std::size_t batch_count = 1, std::size_t thread_count = 1);
+
+    /// Returns the plan built in the background for the same parameters as
+    /// `plan` once it is ready, then null.
+    std::shared_ptr<const FFTPlan> take_upgrade(
+        std::size_t size,
+        std::size_t batch_count = 1,
+        std::size_t thread_count = 1
+    );
+
+    /// Same as `take_upgrade`, for the parameters of `current`.
+    std::shared_ptr<const FFTPlan> take_upgrade(const FFTPlan& current);
+
+    /// Same as `plan`, except that if the plan would take any planning, it
+    /// gets built on the background thread and null is returned. Calling
+    /// again with the same parameters returns it once ready. A plan returned
+    /// below the configured rigor gets upgraded like those from `plan`.
+    ///
+    /// A request supersedes the pending ones of the same `slot`, so that e.g.
+    /// dragging a window size around only ever builds the latest size. So do
+    /// the upgrades of the plans requested for that slot before: they get
+    /// dropped if not built yet, and released if nobody took them.
+    ///
+    /// Throws `std::runtime_error` if building the plan failed, e.g. as FFTW
+    /// could not allocate it. The failure is only reported once, requesting
+    /// the same plan again retries.
+    std::shared_ptr<const FFTPlan> request(
+        PlanSlot slot,
+        std::size_t size,
+        std::size_t batch_count = 1,
+        std::size_t thread_count = 1
+    );
+
+    /// Queues the upgrade of `plan` again if a request superseded it, for
+    /// when `slot` ends up keeping it, e.g. after going back to the current
+    /// size before the plan for another one was ready.
+    void keep_upgrading(PlanSlot slot, const FFTPlan& plan);
+
+    /// Keeps `plan` alive until the planner thread releases it, so that the
+    /// caller does not wait on the planner lock just to destroy it.
+    void retire(std::shared_ptr<const FFTPlan> plan);
+
+    const PlanningConfig& config() const { return m_config; }
+    const std::string& wisdom_path() const { return m_wisdom_path; }
+    bool wisdom_loaded() const { return m_wisdom_loaded; }
+
+    /// Whether a plan is being built in the background.
+    bool is_planning() const;
+
+    private:
+    // Size, batch count and thread count
+    using PlanShape = std::tuple<std::size_t, std::size_t, std::size_t>;
+    using RequestKey = std::pair<PlanSlot, PlanShape>;
+
+    void planner_loop();
+
+    /// Makes the upgrade of `shape` the one built for `slot`, dropping the
+    /// previous one. Expects `m_lock` to be held.
+    void own_upgrade(PlanSlot slot, const PlanShape& shape, PlanRigor rigor);
+
+    /// Drops the upgrade of `slot` unless another slot wants it too. Expects
+    /// `m_lock` to be held.
+    void drop_upgrade(PlanSlot slot);
+
+    /// Builds the plan for a request, from wisdom if possible. Throws
+    /// `std::runtime_error` if it could not be built.
+    std::shared_ptr<const FFTPlan> build_requested(const PlanShape& shape);
+
+    PlanningConfig m_config;
+    std::string m_wisdom_path;
+    bool m_wisdom_loaded = false;
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_cv;
+    std::vector<PlanShape> m_queued_shapes;
+    std::map<PlanShape, std::shared_ptr<const FFTPlan>> m_upgrades;
+
+    // Upgrade being built, and whether its slot moved on in the meantime
+    std::optional<PlanShape> m_building;
+    bool m_building_dropped = false;
+
+    // Upgrades of the plans handed out by `request`, by slot
+    std::map<PlanSlot, PlanShape> m_slot_upgrades;
+
+    // Requests are served before upgrades, as their caller waits on them
+    std::vector<RequestKey> m_requested_shapes;
+    std::map<RequestKey, std::shared_ptr<const FFTPlan>> m_requested;
+    std::map<RequestKey, std::string> m_failed;
+    std::vector<std::shared_ptr<const FFTPlan>> m_retired;
+    bool m_planning = false;
+    bool m_stop = false;
+
+    std::thread m_thread;
+};
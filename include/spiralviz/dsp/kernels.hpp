@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// Hot loops over whole FFT windows. These are written with explicit SIMD where
+// available since we do not rely on -O2 auto-vectorization.
+//
+// Every kernel exists for each instruction set of `KernelISA` the build can
+// target. The best one supported by the CPU gets picked on first use.
+//
+// For all of these, `out`, `window` and `in` must have the same size.
+
+enum class KernelISA
+{
+    SCALAR = 0,
+    SSE2 = 1,
+    AVX2 = 2,   // with FMA
+    AVX512 = 3  // AVX-512F
+};
+
+static constexpr const char* get_kernel_isa_string(KernelISA isa)
+{
+    switch (isa)
+    {
+    case KernelISA::SCALAR: return "scalar";
+    case KernelISA::SSE2: return "SSE2";
+    case KernelISA::AVX2: return "AVX2";
+    case KernelISA::AVX512: return "AVX-512";
+    default: return "???";
+    }
+}
+
+/// Whether kernels for `isa` were built and can run on this CPU.
+bool is_kernel_isa_supported(KernelISA isa);
+
+/// The fastest supported instruction set, which is used by default.
+KernelISA best_kernel_isa();
+
+/// Instruction set of the kernels currently in use.
+KernelISA active_kernel_isa();
+
+/// Makes every kernel use `isa`, e.g. to compare implementations. Should not
+/// be called while kernels are running on other threads.
+///
+/// Throws `std::runtime_error` if `isa` is not supported.
+void set_kernel_isa(KernelISA isa);
+
+/// Real and imaginary parts of complex values, stored in separate arrays as
+/// output by FFTW's split-array interface.
+struct SplitComplexSpan
+{
+    std::span<const float> real;
+    std::span<const float> imag;
+
+    std::size_t size() const { return real.size(); }
+
+    SplitComplexSpan first(std::size_t count) const
+    {
+        return {real.first(count), imag.first(count)};
+    }
+
+    SplitComplexSpan subspan(std::size_t offset, std::size_t count) const
+    {
+        return {real.subspan(offset, count), imag.subspan(offset, count)};
+    }
+};
+
+/// out[i] = window[i] * in[i]
+void window_multiply(
+    std::span<float> out,
+    std::span<const float> window,
+    std::span<const float> in
+);
+
+/// out[i] = window[i] * (in[i] * scale)
+///
+/// Fuses the conversion of native S16 samples into the windowing pass, so that
+/// the samples never need to exist as floats outside of the FFT input buffer.
+void window_multiply_s16(
+    std::span<float> out,
+    std::span<const float> window,
+    std::span<const std::int16_t> in,
+    float scale
+);
+
+/// Returns the sum of a[i] * b[i].
+float dot_product(
+    std::span<const float> a,
+    std::span<const float> b
+);
+
+/// out[i] = |in[i]| * scale
+///
+/// `out` may be the memory of `in.real`, so that magnitudes get written over
+/// the real parts.
+void complex_magnitudes(
+    std::span<float> out,
+    SplitComplexSpan in,
+    float scale
+);
+
+/// out[i] = |a_weight * a[i] + b_weight * b[i]| * scale
+///
+/// As the DFT is linear, this yields the spectrum of a mix of two signals
+/// (e.g. mid/side from left/right) without transforming the mix itself.
+void complex_mix_magnitudes(
+    std::span<float> out,
+    SplitComplexSpan a,
+    SplitComplexSpan b,
+    float a_weight,
+    float b_weight,
+    float scale
+);
+
+/// out[i] = round(clamp(log2(in[i]) * scale + offset, 0, max)), where max is
+/// the largest value `out` can hold, e.g. to store levels in dB as compact
+/// codes (see `EncodedSpectrum`). Zeros end up as 0.
+///
+/// The SIMD versions approximate log2, which may only make them round to the
+/// neighboring code now and then.
+void quantize_log2(
+    std::span<std::uint16_t> out,
+    std::span<const float> in,
+    float scale,
+    float offset
+);
+void quantize_log2(
+    std::span<std::uint8_t> out,
+    std::span<const float> in,
+    float scale,
+    float offset
+);
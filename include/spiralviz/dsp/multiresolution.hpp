@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/dsp/resampler.hpp>
+#include <spiralviz/dsp/signalspectrum.hpp>
+#include <spiralviz/dsp/spectrumlayout.hpp>
+#include <spiralviz/dsp/windowedfft.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+struct MultiResolutionConfig
+{
+    /// FFT size of every band. Each band sees half the rate of the band above
+    /// it, so its window lasts twice as long and resolves twice as finely.
+    std::size_t band_window_size = 2048;
+
+    /// Bands stop getting decimated once their window would last longer than
+    /// this, and the lowest one covers everything below. This bounds the
+    /// latency of the lowest notes.
+    std::size_t max_window_ms = 750;
+
+    /// Resolution and lower bound of the output.
+    float cents_per_bin = 10.0f;
+    float min_frequency = 27.5f; // A0
+
+    auto operator<=>(const MultiResolutionConfig&) const = default;
+};
+
+/// A single octave-spaced band of `MultiResolutionSpectrum`.
+struct SpectrumBand
+{
+    double sample_rate;
+
+    /// Frequencies the band covers in the output, in Hz.
+    double low_frequency;
+    double high_frequency;
+
+    /// Latency added by the decimation filters in front of the band.
+    double filter_delay_s;
+};
+
+/// Spectrum analysis of a single signal, where each octave band gets its own
+/// decimation rate and thus window length, combined into a cents-indexed
+/// output matching the log-frequency axis of the spiral.
+///
+/// All of the bands run FFTs of the same size. The top band runs at the input
+/// rate, and every band below at half the rate of the one above, through a
+/// chain of 2:1 `PolyphaseResampler`s. High notes thus get short windows and
+/// fresh updates, while the lowest notes keep the resolution of a single long
+/// FFT. Band b only gets transformed once every 2^b hops, which keeps the
+/// overlap of every band the same and the total work per hop much lower than
+/// that of a single FFT of the longest window.
+class MultiResolutionSpectrum : public SignalSpectrum
+{
+    public:
+    /// `plan` must be of `config.band_window_size`. `level_reference_size` is
+    /// the size of a plain FFT whose levels the output should match, so that
+    /// both engines can share the same volume range.
+    MultiResolutionSpectrum(
+        std::size_t sample_rate,
+        const FFTHighLevelConfig& window_config,
+        const MultiResolutionConfig& config,
+        std::shared_ptr<const FFTPlan> plan,
+        std::size_t level_reference_size
+    );
+
+    /// Feeds new samples at the input rate to every band.
+    void push_samples(SampleSpan samples) override;
+
+    /// Transforms the bands which advanced by at least `hop` samples, counted
+    /// at each band's own rate, then returns the updated cents-indexed
+    /// magnitudes. The span remains valid until the next call.
+    std::span<float> compute(std::size_t hop) override;
+
+    /// Swaps in another plan of the same size, see `WindowedFFT::set_plan`.
+    void set_plan(std::shared_ptr<const FFTPlan> plan);
+
+    /// Switches every band to the window of `window_config`, and the levels
+    /// to those of `level_reference_size`. The history of the bands carries
+    /// over, see `WindowedFFT::update_from_config`.
+    void set_window(const FFTHighLevelConfig& window_config, std::size_t level_reference_size);
+
+    const SpectrumLayout& layout() const override { return m_layout; }
+
+    /// Input samples covered by the window of the lowest band.
+    std::size_t history_size() const override { return m_config.band_window_size << (m_bands.size() - 1); }
+
+    const std::vector<SpectrumBand>& bands() const { return m_bands; }
+    const MultiResolutionConfig& config() const { return m_config; }
+
+    /// FFTs computed so far, across all bands.
+    std::uint64_t transform_count() const { return m_transform_count; }
+
+    private:
+    /// Where an output bin reads its magnitude from.
+    struct BinSource
+    {
+        std::uint32_t band = 0;
+
+        /// Band bins covered by the output bin, whose maximum gets picked. If
+        /// the output bin is narrower than a band bin, it instead interpolates
+        /// between `first` and `first + 1` by `fraction`.
+        std::uint32_t first = 0;
+        std::uint32_t last = 0;
+        float fraction = 0.0f;
+        bool interpolate = false;
+    };
+
+    void build_layout(std::size_t sample_rate);
+    void set_level_reference(std::size_t level_reference_size);
+
+    MultiResolutionConfig m_config;
+    SpectrumLayout m_layout;
+    std::vector<SpectrumBand> m_bands;
+
+    std::vector<WindowedFFT> m_band_ffts;
+
+    // One fewer than bands: decimator b feeds band b + 1
+    std::vector<PolyphaseResampler> m_decimators;
+    std::vector<std::vector<float>> m_decimated;
+
+    // Samples each band received since its last transform
+    std::vector<std::size_t> m_pending;
+    std::vector<std::vector<float>> m_band_magnitudes;
+    std::vector<bool> m_band_ready;
+
+    std::vector<BinSource> m_bin_sources;
+    std::vector<float> m_output;
+    float m_level_gain;
+
+    std::uint64_t m_transform_count = 0;
+};
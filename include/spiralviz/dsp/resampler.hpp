@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/samples.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct ResamplingConfig
+{
+    /// Sample rate the FFT runs at. 0 means the rate of the source, in which
+    /// case no resampling happens.
+    std::size_t analysis_rate = 0;
+
+    /// Attenuation of the anti-aliasing filter's stopband. Higher values
+    /// cost more taps.
+    float stopband_db = 80.0f;
+};
+
+/// Rational polyphase resampler for a single channel, by a factor of
+/// `output_rate / input_rate`, using a Kaiser-windowed sinc low-pass filter.
+///
+/// Only the filter phases that land on an output sample are ever evaluated,
+/// so decimating by M costs roughly 1/M of filtering at the input rate.
+/// History is kept across calls to `process`, which can thus be fed blocks of
+/// any size without discontinuities.
+class PolyphaseResampler
+{
+    public:
+    /// Throws `std::runtime_error` if the ratio between both rates cannot be
+    /// reduced to a reasonably small fraction.
+    PolyphaseResampler(std::size_t input_rate, std::size_t output_rate, float stopband_db = 80.0f);
+
+    /// Resamples `input`, appending the resulting samples to `output`.
+    /// Returns the number of samples that were appended.
+    std::size_t process(SampleSpan input, std::vector<float>& output);
+
+    /// Forgets about past input, as if no sample had ever been processed.
+    void reset();
+
+    std::size_t input_rate() const { return m_input_rate; }
+    std::size_t output_rate() const { return m_output_rate; }
+
+    std::size_t taps_per_phase() const { return m_taps_per_phase; }
+
+    private:
+    std::size_t m_input_rate, m_output_rate;
+
+    // Resampling ratio as upsampling by L followed by decimating by M
+    std::size_t m_up, m_down;
+
+    std::size_t m_taps_per_phase;
+
+    // One row of `m_taps_per_phase` coefficients per phase, stored in
+    // reverse so that each output is a dot product with contiguous input.
+    std::vector<float> m_coeffs;
+
+    // Last `m_taps_per_phase - 1` input samples, followed by the current block
+    std::vector<float> m_history;
+
+    // Position of the next output sample, in units of 1/L input samples
+    // relative to the newest sample of the history that got kept
+    std::size_t m_time = 0;
+};
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/samples.hpp>
+#include <spiralviz/dsp/spectrumlayout.hpp>
+
+#include <span>
+
+/// Spectrum analysis of a single signal that keeps its own history: it gets
+/// fed every sample, and is read out once per hop. This is what the engines
+/// other than the plain linear FFT implement, so that `FFTStreamer` can drive
+/// any of them the same way.
+class SignalSpectrum
+{
+    public:
+    virtual ~SignalSpectrum() = default;
+
+    virtual void push_samples(SampleSpan samples) = 0;
+
+    /// Returns the magnitudes as of the last sample pushed, `hop` samples
+    /// after the previous call. The span remains valid until the next call.
+    virtual std::span<float> compute(std::size_t hop) = 0;
+
+    /// How the bins of the output map to frequencies.
+    virtual const SpectrumLayout& layout() const = 0;
+
+    /// How many of the last samples pushed still affect the output.
+    virtual std::size_t history_size() const = 0;
+};
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/dsp/signalspectrum.hpp>
+#include <spiralviz/dsp/spectrumlayout.hpp>
+#include <spiralviz/dsp/windowedfft.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct SlidingDFTConfig
+{
+    /// Range of the output. Every sample costs as much as the bins tracked,
+    /// which grow with it, so this should stick to the notes of interest.
+    float min_frequency = 27.5f;   // A0
+    float max_frequency = 4186.0f; // C8
+
+    /// Resolution of the output.
+    float cents_per_bin = 10.0f;
+
+    /// Per-sample decay of the running sums. Below 1, rounding errors fade
+    /// out instead of accumulating, at the cost of slightly favoring the
+    /// newest samples of the window.
+    float damping = 0.999999f;
+};
+
+/// Sliding DFT of a fixed set of bins, updated with every sample, producing a
+/// cents-indexed output like `MultiResolutionSpectrum`.
+///
+/// This is the modulated SDFT: each tracked bin keeps a running sum of the
+/// input modulated by its own frequency, to which every new sample gets added
+/// while the sample leaving the window gets removed, so that a sample costs
+/// one complex multiply-add per bin whatever the window size. The modulation
+/// comes from a table indexed modulo the window size, rather than from a
+/// recursive oscillator, so it cannot drift; damping takes care of rounding
+/// errors in the sums.
+///
+/// As the window cannot be applied to the samples, it gets applied to the
+/// bins instead, by convolution with the few non-zero bins of its transform.
+/// This only works for symmetric cosine-sum windows (every `WindowType`), so
+/// the symmetry skew does not apply.
+///
+/// Each output bin reads the DFT bin nearest to its center, or interpolates
+/// between the two around it if narrower than a DFT bin. Only those bins, and
+/// the ones the window takes around them, get tracked: high notes, where an
+/// output bin spans many DFT bins, skip most of them. A tone in between two
+/// output bins then gets attenuated like by the main lobe of the window.
+///
+/// Reading the spectrum out costs as much as the bins tracked, and can thus
+/// happen at any hop: short hops get fresh spectra for cheap.
+class SlidingDFT : public SignalSpectrum
+{
+    public:
+    /// `window_size` must be a power of two. Levels match those of a
+    /// `WindowedFFT` of the same size.
+    SlidingDFT(
+        std::size_t sample_rate,
+        std::size_t window_size,
+        WindowType window_type,
+        const SlidingDFTConfig& config
+    );
+
+    void push_samples(SampleSpan samples) override;
+
+    /// The sums are always up to date, so `hop` is irrelevant.
+    std::span<float> compute(std::size_t hop) override;
+
+    const SpectrumLayout& layout() const override { return m_layout; }
+    std::size_t history_size() const override { return m_window_size; }
+
+    const SlidingDFTConfig& config() const { return m_config; }
+    std::size_t window_size() const { return m_window_size; }
+    WindowType window_type() const { return m_window_type; }
+
+    /// DFT bins whose sums get updated with every sample.
+    std::size_t tracked_bin_count() const { return m_sum_real.size(); }
+
+    private:
+    /// Where an output bin reads its magnitude from, either a single bin or
+    /// interpolated between `first` and `first + 1` by `fraction`. Indices
+    /// are into `m_magnitudes`.
+    struct BinSource
+    {
+        std::uint32_t first = 0;
+        float fraction = 0.0f;
+        bool interpolate = false;
+    };
+
+    /// Consecutive DFT bins, whose sums are stored next to each other.
+    struct BinRun
+    {
+        std::size_t first = 0;
+        std::size_t count = 0;
+    };
+
+    void build_layout(std::size_t sample_rate);
+
+    /// Adds one sample to every sum.
+    void push_sample(float sample);
+
+    SlidingDFTConfig m_config;
+    SpectrumLayout m_layout;
+
+    std::size_t m_window_size;
+    WindowType m_window_type;
+
+    // cos and sin of 2 pi i / N
+    std::vector<float> m_cos_table;
+    std::vector<float> m_sin_table;
+
+    // Last N samples, where `m_position` (the index of the next sample modulo
+    // N) is the oldest one
+    std::vector<float> m_history;
+    std::size_t m_position = 0;
+
+    // Coefficients of the bins of the window transform, from the center bin
+    // outwards
+    std::array<float, 4> m_window_kernel{};
+    std::size_t m_window_taps = 0;
+
+    // Sums of the runs one after the other
+    std::vector<BinRun> m_tracked_runs;
+    std::vector<float> m_sum_real;
+    std::vector<float> m_sum_imag;
+
+    // Sums rotated back to the phase of a DFT over the current window
+    std::vector<float> m_rotated_real;
+    std::vector<float> m_rotated_imag;
+
+    float m_damping;
+    float m_leaving_gain; // damping^N, applied to the sample leaving the window
+
+    // Windowed magnitudes of the bins the output reads, in order, and where
+    // their sums are
+    std::vector<float> m_magnitudes;
+    std::vector<std::size_t> m_windowed_positions;
+    float m_magnitude_scale;
+
+    std::vector<float> m_samples; // conversion buffer
+    std::vector<BinSource> m_bin_sources;
+    std::vector<float> m_output;
+};
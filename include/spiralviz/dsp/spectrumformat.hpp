@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+enum class SpectrumFormat
+{
+    FLOAT = 0,   // linear magnitudes, as computed
+    LOG_U16 = 1, // levels in dB, quantized to 16 bits over `LogLevelRange`
+    LOG_U8 = 2   // same with 8 bits, i.e. about half a dB per step by default
+};
+
+static constexpr const char* get_spectrum_format_string(SpectrumFormat format)
+{
+    switch (format)
+    {
+    case SpectrumFormat::FLOAT: return "32-bit float";
+    case SpectrumFormat::LOG_U16: return "16-bit dB";
+    case SpectrumFormat::LOG_U8: return "8-bit dB";
+    default: return "???";
+    }
+}
+
+/// Levels the log formats can represent, relative to a magnitude of 1. Levels
+/// outside of it get clamped.
+struct LogLevelRange
+{
+    float min_db = -80.0f;
+    float max_db = 40.0f;
+
+    auto operator<=>(const LogLevelRange&) const = default;
+};
+
+/// A spectrum stored in any `SpectrumFormat`. Only the storage of its format
+/// is used, the others stay empty.
+///
+/// The log formats take a half or a quarter of the memory and upload bandwidth
+/// of the linear magnitudes, which matters once many spectra get kept around.
+struct EncodedSpectrum
+{
+    SpectrumFormat format = SpectrumFormat::FLOAT;
+    LogLevelRange range;
+
+    std::vector<float> linear;
+    std::vector<std::uint16_t> log_u16;
+    std::vector<std::uint8_t> log_u8;
+
+    /// Replaces the contents with `magnitudes`, reusing the storage.
+    void encode(std::span<const float> magnitudes, SpectrumFormat new_format, const LogLevelRange& new_range = {});
+
+    std::size_t size() const;
+
+    /// Linear magnitude of bin `i`, up to the quantization of the format.
+    float magnitude(std::size_t i) const;
+
+    /// Codes of the log formats, from 0 for `range.min_db` to this for
+    /// `range.max_db`.
+    std::uint32_t max_code() const;
+};
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+enum class SpectrumScale
+{
+    LINEAR = 0, // FFT bins, evenly spaced from 0 Hz to the Nyquist frequency
+    CENTS = 1   // evenly spaced in cents, from `min_frequency` on
+};
+
+/// How the bins of a spectrum map to frequencies, so that whatever displays it
+/// can look up any frequency whichever analysis produced it.
+struct SpectrumLayout
+{
+    SpectrumScale scale = SpectrumScale::LINEAR;
+
+    /// `CENTS` only: bin i is centered on
+    /// `min_frequency * 2^(i * cents_per_bin / 1200)`.
+    float min_frequency = 0.0f;
+    float cents_per_bin = 0.0f;
+
+    /// The spectrum may only be a slice of every bin the analysis can
+    /// produce, see `FrequencyRange`: its bin i is bin `first_bin + i` of the
+    /// whole spectrum, which has `full_size` bins. 0 means it is whole.
+    std::uint32_t first_bin = 0;
+    std::uint32_t full_size = 0;
+
+    auto operator<=>(const SpectrumLayout&) const = default;
+};
+
+/// Frequencies that a display actually shows, in Hz, so that analyses can skip
+/// the bins outside of it. Covers everything by default.
+struct FrequencyRange
+{
+    float low = 0.0f;
+    float high = std::numeric_limits<float>::infinity();
+
+    auto operator<=>(const FrequencyRange&) const = default;
+};
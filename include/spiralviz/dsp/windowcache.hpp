@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/dsp/windowedfft.hpp>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Identifies a window table, see `FFTHighLevelConfig`.
+struct WindowTableKey
+{
+    WindowType type;
+    float symmetry_skew_factor;
+    std::size_t size;
+
+    auto operator<=>(const WindowTableKey&) const = default;
+};
+
+/// Process-wide memo of window tables, so that every FFT, band and streamer
+/// asking for the same window shares a single immutable table.
+///
+/// Tables can either be built right away on the calling thread with `get`, or
+/// requested from a background thread with `request`, which never blocks on
+/// building: the caller keeps using whichever table it had until the new one
+/// is ready, e.g. while a slider gets dragged.
+class WindowTableCache
+{
+    public:
+    using Table = std::shared_ptr<const std::vector<float>>;
+
+    static WindowTableCache& shared();
+
+    WindowTableCache() = default;
+    ~WindowTableCache();
+
+    WindowTableCache(const WindowTableCache&) = delete;
+    WindowTableCache& operator=(const WindowTableCache&) = delete;
+
+    /// Returns the table for `key`, building it first if needed.
+    Table get(const WindowTableKey& key);
+
+    /// Returns the table for `key` if it is ready, otherwise queues it for
+    /// the background thread and returns null. Call again later to pick it up.
+    ///
+    /// A queued table of the same type and size but another skew gets
+    /// replaced, so that only the latest step of a slider gets built.
+    Table request(const WindowTableKey& key);
+
+    private:
+    /// Tables only referenced by the cache get dropped beyond this, oldest
+    /// first.
+    static constexpr std::size_t max_unused_tables = 8;
+
+    void insert(const WindowTableKey& key, Table table);
+    void builder_loop();
+
+    std::mutex m_lock;
+    std::condition_variable m_cv;
+
+    // In order of insertion, to drop the oldest unused ones first
+    std::vector<std::pair<WindowTableKey, Table>> m_tables;
+    std::vector<WindowTableKey> m_queued_keys;
+    bool m_stop = false;
+
+    std::thread m_thread; // started on the first request
+};
+
+/// Builds the table for `key` on the calling thread, without memoizing it.
+std::vector<float> build_window_table(const WindowTableKey& key);
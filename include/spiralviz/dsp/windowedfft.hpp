@@ -3,19 +3,23 @@
 
 #pragma once
 
+#include <spiralviz/audio/samples.hpp>
+#include <spiralviz/dsp/kernels.hpp>
 #include <spiralviz/dsp/util.hpp>
 
 #include <fftw3.h>
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <span>
 
 using FFTWFloat = float;
-using FFTWComplex = fftwf_complex;
 using FFTInSample = float;
 using FFTWFPlan = std::remove_pointer_t<fftwf_plan>;
 
@@ -24,15 +28,25 @@ struct FFTWFAllocDeleter
     void operator()(void* ptr) { fftwf_free(ptr); }
 };
 
+/// FFTW's planner is not thread-safe: creating or destroying plans, and
+/// importing or exporting wisdom, must be done while holding this.
+std::mutex& fftw_planner_mutex();
+
+/// Whether FFTW was built with its threads library, which plans for more than
+/// one thread require. Initializes the library the first time.
+bool fftw_has_threads();
+
 struct FFTWFPlanDeleter
 {
-    void operator()(fftwf_plan ptr) { fftwf_destroy_plan(ptr); }
+    void operator()(fftwf_plan ptr);
 };
 
 struct FFTConfig
 {
     std::size_t window_size_samples; // N
-    std::vector<float> window_factors;
+
+    // Immutable, so that every channel can share the same table
+    std::shared_ptr<const std::vector<float>> window_factors;
 };
 
 enum class WindowType
@@ -55,50 +69,248 @@ static constexpr const char* get_window_type_string(WindowType type)
 
 struct FFTHighLevelConfig
 {
-    // float window_size_ms;
+    /// Duration of the FFT window, which trades latency for frequency
+    /// resolution.
+    float window_size_ms;
     float symmetry_skew_factor;
     WindowType type;
 
+    /// Size of the window at `sample_rate`, rounded to the nearest size made
+    /// of factors of 2, 3 and 5 only, which FFTW handles best.
+    std::size_t window_size(std::size_t sample_rate) const;
     FFTConfig as_fft_config(std::size_t sample_rate) const;
 
+    /// Window table of this type for any window size, shared with everything
+    /// else using the same window, see `WindowTableCache`.
+    std::shared_ptr<const std::vector<float>> make_window_factors(std::size_t window_size) const;
+
+    /// Same as `make_window_factors`, but returns null rather than building
+    /// the table on the calling thread. It gets built in the background, to be
+    /// picked up by a later call.
+    std::shared_ptr<const std::vector<float>> request_window_factors(std::size_t window_size) const;
+
     auto operator<=>(const FFTHighLevelConfig&) const = default;
 };
 
 constexpr FFTHighLevelConfig default_hl_config {
-    // .window_size_ms = 300,
+    .window_size_ms = 743.0f, // 32768 samples at 44.1kHz
     .symmetry_skew_factor = 5.0,
     .type = WindowType::BLACKMAN_HARRIS
 };
 
+/// How hard FFTW tries to find a fast plan, from instant to minutes.
+enum class PlanRigor
+{
+    ESTIMATE = 0,
+    MEASURE = 1,
+    PATIENT = 2
+};
+
+static constexpr const char* get_plan_rigor_string(PlanRigor rigor)
+{
+    switch (rigor)
+    {
+    case PlanRigor::ESTIMATE: return "Estimate";
+    case PlanRigor::MEASURE: return "Measure";
+    case PlanRigor::PATIENT: return "Patient";
+    default: return "???";
+    }
+}
+
+/// Real-to-complex FFTW plan for a given size. As it gets executed on the
+/// buffers of whoever uses it, a single plan can be shared between several
+/// `WindowedFFT`s, including across threads.
+///
+/// The output is split into separate real and imaginary arrays (FFTW's guru
+/// split interface), which the magnitude kernels can stream through with
+/// plain vector loads.
+///
+/// A plan may also cover a batch of transforms of the same size, laid out one
+/// after the other in memory, which FFTW runs in a single execution.
+///
+/// A plan may also split each execution over up to `thread_count` of FFTW's
+/// own threads. Beyond `ESTIMATE`, FFTW measures how many actually pay off,
+/// which for small sizes is usually one.
+class FFTPlan
+{
+public:
+    /// Plans from scratch, unless FFTW has wisdom for this size and rigor.
+    /// Anything beyond `ESTIMATE` may take a while. `thread_count` falls back
+    /// to 1 without `fftw_has_threads`.
+    explicit FFTPlan(
+        std::size_t size,
+        PlanRigor rigor = PlanRigor::ESTIMATE,
+        std::size_t batch_count = 1,
+        std::size_t thread_count = 1
+    );
+
+    /// Returns null if FFTW has no wisdom for this size and rigor, rather than
+    /// planning from scratch.
+    static std::shared_ptr<const FFTPlan> from_wisdom(
+        std::size_t size,
+        PlanRigor rigor,
+        std::size_t batch_count = 1,
+        std::size_t thread_count = 1
+    );
+
+    /// Distance between the outputs of two transforms of a batch, in bins.
+    /// Rounded up from `size / 2 + 1`, so that every output of a batch is as
+    /// aligned as the first one. Inputs are `size` apart.
+    static std::size_t output_stride(std::size_t size) { return (size / 2 + 1 + 15) & ~std::size_t(15); }
+
+    std::size_t size() const { return m_size; }
+    std::size_t batch_count() const { return m_batch_count; }
+    std::size_t thread_count() const { return m_thread_count; }
+    PlanRigor rigor() const { return m_rigor; }
+
+    /// Whether the plan was created from wisdom rather than from scratch.
+    bool is_from_wisdom() const { return m_from_wisdom; }
+
+    std::chrono::steady_clock::duration planning_time() const { return m_planning_time; }
+
+    /// `in` must hold `size()` reals, `real` and `imag` `size() / 2 + 1` each,
+    /// all allocated through fftwf_alloc_* for alignment. With batches, that
+    /// is `batch_count()` times as much, at the strides described above.
+    void execute(FFTWFloat* in, FFTWFloat* real, FFTWFloat* imag) const;
+
+    /// Average wall time of `execute` so far, in microseconds, for the whole
+    /// batch.
+    double mean_execute_us() const;
+    std::uint64_t execute_count() const { return m_execute_count.load(std::memory_order_relaxed); }
+
+private:
+    FFTPlan(std::size_t size, PlanRigor rigor, std::size_t batch_count, std::size_t thread_count, bool wisdom_only);
+
+    std::size_t m_size;
+    std::size_t m_batch_count;
+    std::size_t m_thread_count;
+    PlanRigor m_rigor;
+    bool m_from_wisdom = false;
+    std::chrono::steady_clock::duration m_planning_time{};
+    std::unique_ptr<FFTWFPlan, FFTWFPlanDeleter> m_plan;
+
+    mutable std::atomic<std::uint64_t> m_execute_ns = 0;
+    mutable std::atomic<std::uint64_t> m_execute_count = 0;
+};
+
 class WindowedFFT
 {
 public:
-    WindowedFFT(FFTConfig config) noexcept;
+    /// `input_format` determines how the sample window is stored. With S16,
+    /// samples are only converted to floats while being windowed.
+    ///
+    /// If `plan` is null, the FFT creates its own.
+    WindowedFFT(
+        FFTConfig config,
+        SampleFormat input_format = SampleFormat::F32,
+        std::shared_ptr<const FFTPlan> plan = nullptr
+    );
 
-    /// Left-shifts the buffer to fit new samples at the right, computes the
-    /// new FFT with the desired parameters, then returns a span representing
+    /// Appends new samples to the window, dropping the oldest ones, computes
+    /// the new FFT with the desired parameters, then returns a span representing
     /// the output of the FFT which will remain valid and can be written to
     /// until any further action is performed on this object.
     std::span<float> consume_samples(std::span<const FFTInSample> samples);
 
+    /// Appends new samples to the window, dropping the oldest ones, without
+    /// computing the FFT. Useful when the new samples are split over several
+    /// views. Only the last N samples are kept if more are provided.
+    void push_samples(std::span<const FFTInSample> samples);
+    void push_samples(SampleSpan samples);
+
+    /// Computes the FFT over the current window, see `consume_samples`.
+    /// Equivalent to `transform()` followed by `magnitudes()`.
+    std::span<float> compute();
+
+    /// Computes the FFT over the current window, without deriving the
+    /// magnitudes yet, so that `spectrum` can be used.
+    void transform();
+
+    /// Complex output of the last `transform`, with `output_size()` bins.
+    SplitComplexSpan spectrum() const;
+
+    /// Turns the output of the last `transform` into normalized magnitudes,
+    /// in place over the real parts: `spectrum` becomes invalid until the
+    /// next `transform`.
+    /// Lifetime rules are the same as for `consume_samples`.
+    std::span<float> magnitudes();
+
+    /// Same as `magnitudes`, but only for output bins `first_bin` to
+    /// `first_bin + bin_count - 1`, e.g. those that get displayed. The rest
+    /// of `spectrum` is left as is.
+    std::span<float> magnitudes(std::size_t first_bin, std::size_t bin_count);
+
+    /// Enables batched transforms, where each slot of the batch gets its own
+    /// snapshot of the window through `stage_batch`. The samples of several
+    /// hops can then be pushed one hop at a time, with a snapshot after each,
+    /// and all of the snapshots transformed in one go. `plan` must be a batch
+    /// of the window size. Null disables batching and frees the slots.
+    void set_batch_plan(std::shared_ptr<const FFTPlan> plan);
+
+    /// Slots of the batch, 0 if batching is disabled.
+    std::size_t batch_capacity() const { return m_batch_plan != nullptr ? m_batch_plan->batch_count() : 0; }
+
+    /// Windows the current history into `slot`.
+    void stage_batch(std::size_t slot);
+
+    /// Transforms the first `count` slots. A full batch takes a single
+    /// execution of the batch plan, and fewer slots one execution of the
+    /// regular plan each.
+    void transform_batch(std::size_t count);
+
+    /// Same as `spectrum` and `magnitudes`, for a slot of the last
+    /// `transform_batch`.
+    SplitComplexSpan batch_spectrum(std::size_t slot) const;
+    std::span<float> batch_magnitudes(std::size_t slot);
+    std::span<float> batch_magnitudes(std::size_t slot, std::size_t first_bin, std::size_t bin_count);
+
+    /// Number of output bins.
+    std::size_t output_size() const { return m_config.window_size_samples / 2 - 1; }
+
+    /// Factor by which magnitudes get scaled, see `magnitudes`.
+    float magnitude_scale() const;
+
     /// Clears the internal buffer so that all samples become zero. Does not
     /// cause reallocation and does not touch the internal fftw objects.
     void clear();
 
-    void update_from_config(const FFTConfig& config);
+    /// If the window size changes, `plan` is used as the new plan if it is of
+    /// the right size, otherwise a new one is created. The newest samples of
+    /// the history carry over, so the next spectrum does not start from
+    /// silence. Batching gets disabled until the next `set_batch_plan`.
+    void update_from_config(const FFTConfig& config, std::shared_ptr<const FFTPlan> plan = nullptr);
     const FFTConfig& config() const { return m_config; }
 
-private:
-    std::size_t initial_sample_buffer_cursor() const;
-    void left_shift_sample_buffer(std::size_t by);
+    /// Swaps in another plan of the same size, e.g. a better one that got
+    /// built in the meantime. The window is left untouched.
+    void set_plan(std::shared_ptr<const FFTPlan> plan);
+    const FFTPlan& plan() const { return *m_fft_plan; }
+
+    SampleFormat input_format() const { return m_input_format; }
 
-    void populate_fft_buffer();
+private:
+    void populate_fft_buffer(std::span<float> fft_in);
 
     FFTConfig m_config;
+    SampleFormat m_input_format;
 
+    // Only the buffer matching `m_input_format` is used. Both are circular:
+    // new samples overwrite the oldest ones, so that pushing costs as much as
+    // the samples pushed rather than the whole window.
     std::vector<FFTInSample> m_sample_buffer;
+    std::vector<std::int16_t> m_sample_buffer_s16;
+
+    // Where the next sample goes, which is also where the oldest one is
+    std::size_t m_write_pos = 0;
 
     std::unique_ptr<FFTWFloat[], FFTWFAllocDeleter> m_fft_in_buffer;
-    std::unique_ptr<FFTWComplex[], FFTWFAllocDeleter> m_fft_out_buffer;
-    std::unique_ptr<FFTWFPlan, FFTWFPlanDeleter> m_fft_plan;
-};
\ No newline at end of file
+    std::unique_ptr<FFTWFloat[], FFTWFAllocDeleter> m_fft_real_buffer;
+    std::unique_ptr<FFTWFloat[], FFTWFAllocDeleter> m_fft_imag_buffer;
+    std::shared_ptr<const FFTPlan> m_fft_plan;
+
+    // Slots are laid out as the batch plan expects, see `FFTPlan`
+    std::shared_ptr<const FFTPlan> m_batch_plan;
+    std::unique_ptr<FFTWFloat[], FFTWFAllocDeleter> m_batch_in_buffer;
+    std::unique_ptr<FFTWFloat[], FFTWFAllocDeleter> m_batch_real_buffer;
+    std::unique_ptr<FFTWFloat[], FFTWFAllocDeleter> m_batch_imag_buffer;
+};
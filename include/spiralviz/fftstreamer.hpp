@@ -3,33 +3,437 @@
 
 #pragma once
 
-#include <spiralviz/audio/recorder.hpp>
+#include <spiralviz/audio/samplesource.hpp>
+#include <spiralviz/dsp/fftplanner.hpp>
+#include <spiralviz/dsp/multiresolution.hpp>
+#include <spiralviz/dsp/resampler.hpp>
+#include <spiralviz/dsp/slidingdft.hpp>
 #include <spiralviz/dsp/windowedfft.hpp>
+#include <spiralviz/util/realtime.hpp>
+#include <spiralviz/util/taskpool.hpp>
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class ChannelMix
+{
+    CHANNEL = 0, // a single channel, as captured
+    MID = 1,     // (L + R) / 2, i.e. what is common to the first two channels
+    SIDE = 2     // (L - R) / 2, i.e. what differs between them
+};
+
+static constexpr const char* get_channel_mix_string(ChannelMix mix)
+{
+    switch (mix)
+    {
+    case ChannelMix::CHANNEL: return "Channel";
+    case ChannelMix::MID: return "Mid (L+R)";
+    case ChannelMix::SIDE: return "Side (L-R)";
+    default: return "???";
+    }
+}
+
+enum class SpectrumEngine
+{
+    LINEAR_FFT = 0,       // one `WindowedFFT` per channel
+    MULTI_RESOLUTION = 1, // one `MultiResolutionSpectrum` per channel
+    SLIDING_DFT = 2       // one `SlidingDFT` per channel
+};
+
+static constexpr const char* get_spectrum_engine_string(SpectrumEngine engine)
+{
+    switch (engine)
+    {
+    case SpectrumEngine::LINEAR_FFT: return "Linear FFT";
+    case SpectrumEngine::MULTI_RESOLUTION: return "Multi-resolution";
+    case SpectrumEngine::SLIDING_DFT: return "Sliding DFT";
+    default: return "???";
+    }
+}
+
+/// Which channel, or mix of channels, `FFTStreamer::update_fft` returns.
+struct ChannelSelection
+{
+    ChannelMix mix = ChannelMix::CHANNEL;
+    std::size_t channel = 0; // only used for `ChannelMix::CHANNEL`
+
+    auto operator<=>(const ChannelSelection&) const = default;
+};
+
+/// What to do with samples that queue up faster than they get displayed, e.g.
+/// when the render loop hitches or when a source delivers in bursts.
+///
+/// In every case, the newest completed hop gets displayed once the backlog
+/// is back within budget.
+enum class BacklogPolicy
+{
+    /// Drops the oldest samples beyond the budget, and feeds the rest to the
+    /// analysis window.
+    DROP_OLDEST = 0,
+
+    /// Once over budget, drops everything but the newest hop, which means the
+    /// window will contain a discontinuity.
+    SKIP_TO_LIVE = 1,
+
+    /// Once over budget, advances at most `max_catchup_rate` times faster
+    /// than real time, until the backlog is down to a hop. Beyond twice the
+    /// budget, the oldest samples get dropped as with `DROP_OLDEST`.
+    TIME_STRETCH = 2,
+
+    /// Never drops anything.
+    UNBOUNDED = 3
+};
+
+static constexpr const char* get_backlog_policy_string(BacklogPolicy policy)
+{
+    switch (policy)
+    {
+    case BacklogPolicy::DROP_OLDEST: return "Drop oldest";
+    case BacklogPolicy::SKIP_TO_LIVE: return "Skip to live";
+    case BacklogPolicy::TIME_STRETCH: return "Time-stretch";
+    case BacklogPolicy::UNBOUNDED: return "Unbounded";
+    default: return "???";
+    }
+}
+
+struct BacklogConfig
+{
+    BacklogPolicy policy = BacklogPolicy::DROP_OLDEST;
+
+    /// Samples queued beyond this when an update starts are over budget. As
+    /// samples keep arriving in between frames, this should cover at least a
+    /// frame and a hop.
+    std::size_t max_backlog_ms = 100;
+
+    /// Fastest analysis speed relative to real time with `TIME_STRETCH`. It
+    /// has to exceed 1 for the backlog to shrink at all, see
+    /// `min_catchup_rate`.
+    float max_catchup_rate = 2.0f;
+
+    static constexpr float min_catchup_rate = 1.1f;
+
+    auto operator<=>(const BacklogConfig&) const = default;
+};
+
+struct BacklogStats
+{
+    std::size_t backlog = 0;      // frames left queued by the last update
+    std::size_t peak_backlog = 0; // frames queued before an update
+    std::uint64_t dropped_samples = 0; // frames dropped by the policy
+    double time_over_budget_s = 0.0;
+};
+
+/// Runs one `WindowedFFT` per channel of a `SampleSource`.
+///
+/// All of the channels share the same FFTW plan and window table. Only the
+/// channels required by the selection are analyzed, unless
+/// `set_analyze_all_channels` is enabled, in which case the per-channel FFTs
+/// run in parallel.
+///
+/// If the analysis rate differs from the rate of the source, every channel
+/// first goes through its own `PolyphaseResampler`.
+///
+/// Analysis starts on whatever plan `FFTPlanner` can provide right away, and
+/// switches to a measured one as soon as it gets built.
+///
+/// With the other engines, every channel also feeds a `SignalSpectrum` of that
+/// engine, which then provides the output instead of the linear FFTs. As
+/// those cannot mix spectra after the fact, mid and side mixes get analyzed
+/// from the mixed samples instead, which the linearity of the DFT makes
+/// equivalent. `layout` tells how to read the output either way.
+///
+/// Analysis is scheduled by the audio clock: `update_fft` advances by whole
+/// hops of samples actually delivered by the source, so the hop size stays
+/// exact whatever the frame rate, and no FFT gets computed on frames where no
+/// hop was completed. When several hops are due at once, only the newest one
+/// gets transformed, unless batch mode is enabled (`set_batch_hops`).
+///
+/// Outputs only cover the bins of `visible_range`, along with a bin of margin
+/// on either side, which also spares the linear engine from deriving the
+/// magnitudes of the others.
 class FFTStreamer
 {
     public:
-    FFTStreamer(FFTHighLevelConfig config = default_hl_config, std::size_t sample_rate = 44100);
-    ~FFTStreamer();
+    FFTStreamer(
+        std::unique_ptr<SampleSource> source,
+        FFTHighLevelConfig config = default_hl_config,
+        ResamplingConfig resampling = {},
+        PlanningConfig planning = {}
+    );
 
-    /// Attempts to pull up to `sample_count` samples from the audio recorder,
-    /// then performs a FFT over the updated input window (keeping past samples
-    /// in the window if `sample_count < N`).
+    /// Pulls every completed hop from the sample source, as allowed by the
+    /// backlog policy, then performs a single FFT over the newest window.
     ///
-    /// The lifetime properties of the returned span are documented in
+    /// Returns an empty span if no hop was completed since the last call,
+    /// otherwise see the other overload.
+    std::span<float> update_fft();
+
+    /// Attempts to pull up to `sample_count` frames from the sample source
+    /// (counted at the source rate),
+    /// then performs a FFT over the updated input window of every channel that
+    /// needs it (keeping past samples in the window if `sample_count < N`).
+    /// The backlog policy does not apply, which suits offline analysis.
+    ///
+    /// Returns the magnitudes of the selected channel or mix, over the bins of
+    /// the visible range as told by `layout`. The lifetime
+    /// properties of the returned span are documented in
     /// `WindowedFFT::consume_samples`. If there were no samples to pull, this
     /// function fails by returning an empty span (0-sized).
     std::span<float> update_fft(std::size_t sample_count);
 
-    SampleQueueRecorder& recorder() { return m_recorder; }
-    const SampleQueueRecorder& recorder() const { return m_recorder; }
+    /// Output of the last successful `update_fft`, or empty if the config
+    /// changed since then.
+    std::span<const float> latest_magnitudes() const { return m_latest; }
+
+    /// Output of every hop transformed by the last successful `update_fft`,
+    /// oldest first, the last one being `latest_magnitudes`. Only ever holds
+    /// more than one spectrum in batch mode.
+    const std::vector<std::span<const float>>& hop_magnitudes() const { return m_hop_magnitudes; }
+
+    /// When the newest sample that went into `latest_magnitudes` was captured,
+    /// if the source keeps track of it. Accounts for the delay of the
+    /// resampling filter.
+    std::optional<CaptureClock::time_point> latest_capture_time() const { return m_latest_capture_time; }
+
+    /// Frames between two consecutive spectra, at the source rate. Must be
+    /// non-zero and should be much smaller than the window.
+    void set_hop_size(std::size_t hop_size) { m_hop_size = hop_size; }
+    std::size_t hop_size() const { return m_hop_size; }
+
+    /// Batch mode: when several hops are due at once, e.g. after a stall, up
+    /// to `max_hops` of the newest ones get a spectrum each rather than only
+    /// the last one. Their FFTs run as a single batched FFTW execution per
+    /// channel. 0 or 1 disables it. Only applies to the linear engine.
+    ///
+    /// A new batch count takes effect once its plan got built in the
+    /// background, batching goes on with the previous one until then.
+    void set_batch_hops(std::size_t max_hops);
+    std::size_t batch_hops() const { return m_batch_hops; }
+
+    /// Takes effect once the window table for `config` is ready, which gets
+    /// built in the background if nobody used it recently, along with the
+    /// plans for a new window size. Until then, the FFTs keep their current
+    /// window, while `hl_config` already returns the new config.
+    void update_from_config(const FFTHighLevelConfig& config);
+    const FFTHighLevelConfig& hl_config() const { return m_hl_config; }
+    const FFTConfig& config() const { return m_channel_ffts.front().config(); }
+
+    /// Whether the FFTs still wait on the window table of `hl_config`.
+    bool is_window_pending() const { return m_window_pending; }
+
+    /// Why the last window size could not be applied, empty if it could.
+    /// `hl_config` then went back to the size currently in use.
+    const std::string& window_error() const { return m_window_error; }
+
+    std::size_t channel_count() const { return m_channel_ffts.size(); }
+
+    /// Switching engines restarts the analysis of the new one from silence.
+    ///
+    /// The multi-resolution engine may first need a plan for its band size,
+    /// which then gets built in the background, and so does a new band size.
+    /// The engine in use keeps going until then, while `engine` and
+    /// `multiresolution_config` already return the new settings.
+    void set_engine(SpectrumEngine engine);
+    SpectrumEngine engine() const { return m_engine; }
+
+    /// Whether the engine settings still wait on a band plan.
+    bool is_engine_pending() const { return m_engine_pending; }
+
+    void set_multiresolution_config(const MultiResolutionConfig& config);
+    const MultiResolutionConfig& multiresolution_config() const { return m_multires_config; }
+
+    void set_sliding_dft_config(const SlidingDFTConfig& config);
+    const SlidingDFTConfig& sliding_dft_config() const { return m_sliding_config; }
+
+    /// Per-channel analysis of the multi-resolution engine, if enabled.
+    const MultiResolutionSpectrum* multiresolution(std::size_t channel = 0) const;
 
-    WindowedFFT& fft() { return m_fft; }
-    const WindowedFFT& fft() const { return m_fft;}
+    /// Per-channel analysis of the sliding DFT engine, if enabled.
+    const SlidingDFT* sliding_dft(std::size_t channel = 0) const;
+
+    /// How the bins of the output of `update_fft` map to frequencies,
+    /// including which slice of the spectrum it covers.
+    SpectrumLayout layout() const;
+
+    /// Frequencies whose bins the outputs cover from the next update on, e.g.
+    /// those that the display shows.
+    void set_visible_range(FrequencyRange range) { m_visible_range = range; }
+    FrequencyRange visible_range() const { return m_visible_range; }
+
+    /// Sample rate the FFTs run at, which determines the frequency of bins.
+    std::size_t analysis_rate() const { return m_analysis_rate; }
+    bool is_resampling() const { return !m_resamplers.empty(); }
+
+    /// Mid and side mixes require at least two channels; invalid selections
+    /// fall back to the first channel.
+    void select_channels(ChannelSelection selection);
+    ChannelSelection selected_channels() const { return m_selection; }
+
+    void set_analyze_all_channels(bool enabled) { m_analyze_all_channels = enabled; }
+    bool analyze_all_channels() const { return m_analyze_all_channels; }
+
+    /// Raises `max_catchup_rate` to `BacklogConfig::min_catchup_rate` if
+    /// needed.
+    void set_backlog_config(const BacklogConfig& config);
+    const BacklogConfig& backlog_config() const { return m_backlog_config; }
+
+    const BacklogStats& backlog_stats() const { return m_backlog_stats; }
+    void reset_backlog_stats() { m_backlog_stats = {}; }
+
+    /// Magnitudes of `channel` as of the last successful `update_fft`. Empty if
+    /// that channel was not analyzed on its own.
+    std::span<const float> channel_magnitudes(std::size_t channel) const;
+
+    /// Applies `schedule` to the threads helping out with the analysis. The
+    /// thread calling `update_fft` is left to the caller.
+    void apply_worker_schedule(const ThreadSchedule& schedule);
+
+    SampleSource& source() { return *m_source; }
+    const SampleSource& source() const { return *m_source; }
+
+    /// Plan currently shared by all the channels.
+    const FFTPlan& plan() const { return *m_plan; }
+
+    /// Plan that got replaced by a better one, if any, to compare both.
+    const FFTPlan* replaced_plan() const { return m_replaced_plan.get(); }
+
+    /// Plan of `batch_hops` transforms shared by all the channels, in batch
+    /// mode.
+    const FFTPlan* batch_plan() const { return m_batch_plan.get(); }
+
+    const FFTPlanner& planner() const { return m_planner; }
+
+    WindowedFFT& fft(std::size_t channel = 0) { return m_channel_ffts[channel]; }
+    const WindowedFFT& fft(std::size_t channel = 0) const { return m_channel_ffts[channel]; }
 
     private:
-    SampleQueueRecorder m_recorder;
-    WindowedFFT m_fft;
+    /// Slice of the spectra that the outputs cover.
+    struct BinSlice
+    {
+        std::size_t first = 0;
+        std::size_t count = 0;
+        std::size_t full_size = 0;
+    };
+
+    /// Slice of a spectrum of `full_size` bins laid out as `layout` that
+    /// covers `m_visible_range`. Never empty.
+    BinSlice visible_bins(const SpectrumLayout& layout, std::size_t full_size) const;
+
+    /// Returns how many frames the next update is due to load, after dropping
+    /// whatever the policy requires.
+    std::size_t apply_backlog_policy();
+
+    /// Switches every channel to the plan built in the background, if ready.
+    void swap_in_upgraded_plan();
+
+    /// Applies `m_hl_config` once its window table, and the plans of its
+    /// window size if it changed, are ready.
+    void swap_in_window_config();
+    void apply_fft_config(const FFTConfig& fft_config);
+
+    /// Threads to split an FFT of `size` over, see `PlanningConfig`.
+    std::size_t fft_thread_count(std::size_t size) const;
+
+    /// Switches the bands of the multi-resolution engine to `plan`.
+    void set_band_plan(std::shared_ptr<const FFTPlan> plan);
+
+    /// Switches to the batch plan for the current window size and batch
+    /// count once the planner has it, or drops it if batch mode or the
+    /// linear engine got disabled.
+    void swap_in_batch_plan();
+
+    /// Switches every channel to the batch plan `plan`, null disabling batch
+    /// mode.
+    void set_batch_plan(std::shared_ptr<const FFTPlan> plan);
+
+    /// Output of the `hop_count` hops staged in the batch slots of the
+    /// channels in `transformed`.
+    std::span<float> transform_hops(const std::vector<std::size_t>& transformed, std::size_t hop_count);
+
+    /// Recreates the analyses of the selected engine from the current
+    /// settings, or drops them with the linear engine.
+    void rebuild_engine_spectra();
+
+    /// Plan for the band size of `m_multires_config`, null while the planner
+    /// thread builds it.
+    std::shared_ptr<const FFTPlan> find_band_plan();
+
+    /// New analysis of a single signal for the selected engine.
+    std::unique_ptr<SignalSpectrum> make_engine_spectrum() const;
+
+    /// Switches the engine spectra to the window config just applied,
+    /// rebuilding them only if it changed what they depend on.
+    void update_engine_windows();
+
+    /// Feeds the mix of the first two channels to the analysis of the
+    /// selected mix.
+    void push_engine_mix(const std::vector<SampleViews>& views);
+
+    /// Output of the selected engine, for the channels in `transformed`.
+    std::span<float> compute_engine_spectra(const std::vector<std::size_t>& transformed);
+
+    std::unique_ptr<SampleSource> m_source;
+    FFTHighLevelConfig m_hl_config;
+    bool m_window_pending = false;
+
+    // Window size of `m_hl_config` the FFTs run with, to go back to when the
+    // plans for a new one fail to build
+    float m_applied_window_ms;
+    std::string m_window_error;
+
+    std::size_t m_analysis_rate;
+    std::vector<PolyphaseResampler> m_resamplers;
+    std::vector<std::vector<float>> m_resampled;
+
+    FFTPlanner m_planner;
+    std::shared_ptr<const FFTPlan> m_plan;
+    std::shared_ptr<const FFTPlan> m_replaced_plan;
+
+    // Plans for a new window size, until `swap_in_window_config` applies it
+    std::shared_ptr<const FFTPlan> m_pending_plan;
+    std::shared_ptr<const FFTPlan> m_pending_batch_plan;
+    std::vector<WindowedFFT> m_channel_ffts;
+    std::vector<std::span<float>> m_channel_magnitudes;
+    std::vector<float> m_mix_magnitudes;
+    std::span<float> m_latest;
+
+    FrequencyRange m_visible_range;
+    BinSlice m_visible_bins;
+
+    std::size_t m_batch_hops = 0;
+    std::shared_ptr<const FFTPlan> m_batch_plan;
+    std::vector<std::vector<float>> m_hop_mix_magnitudes;
+    std::vector<std::span<const float>> m_hop_magnitudes;
+
+    SpectrumEngine m_engine = SpectrumEngine::LINEAR_FFT;
+    MultiResolutionConfig m_multires_config;
+    SlidingDFTConfig m_sliding_config;
+
+    // What `m_engine_spectra` got built with, until a new band plan is ready
+    SpectrumEngine m_active_engine = SpectrumEngine::LINEAR_FFT;
+    MultiResolutionConfig m_active_multires_config;
+    bool m_engine_pending = false;
+    std::shared_ptr<const FFTPlan> m_pending_band_plan;
+    std::shared_ptr<const FFTPlan> m_band_plan;
+    std::vector<std::unique_ptr<SignalSpectrum>> m_engine_spectra;
+    std::unique_ptr<SignalSpectrum> m_engine_mix;
+    std::vector<float> m_mix_left, m_mix_right, m_mix_samples;
+
+    std::optional<CaptureClock::time_point> m_latest_capture_time;
+
+    ChannelSelection m_selection;
+    bool m_analyze_all_channels = false;
+
+    std::size_t m_hop_size = 512;
+
+    BacklogConfig m_backlog_config;
+    BacklogStats m_backlog_stats;
+    std::chrono::steady_clock::time_point m_last_update;
+    bool m_catching_up = false;
 
-    std::vector<float> m_sample_buffer;
-};
\ No newline at end of file
+    TaskPool m_pool;
+};
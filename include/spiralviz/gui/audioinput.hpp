@@ -3,7 +3,14 @@
 
 #pragma once
 
-#include <SFML/Audio.hpp>
+#include <spiralviz/audio/devices.hpp>
+#include <spiralviz/audio/samplesource.hpp>
+
+#include <string>
+
+class AnalysisWorker;
+class CaptureArchiver;
+class SampleQueueRecorder;
 
 struct AudioInputParams
 {
@@ -15,8 +22,10 @@ struct AudioInputParams
 class AudioInputGUI
 {
     public:
-    AudioInputGUI(sf::SoundRecorder* recorder);
+    AudioInputGUI(SampleSource* source, const AnalysisWorker* analysis, AudioDeviceRegistry* devices);
 
+    /// Only touches the source through thread-safe calls and the status of
+    /// `analysis`, so that it never stalls the analysis.
     void show_gui();
 
     AudioInputParams& params() { return m_params; }
@@ -25,6 +34,16 @@ class AudioInputGUI
     private:
     void check_current_device();
 
+    void show_device_gui();
+    void show_device_capabilities_gui(const AudioDeviceCapabilities& capabilities);
+    void show_source_stats_gui();
+    void show_archive_stats_gui(const CaptureArchiver& archiver);
+
     AudioInputParams m_params;
-    sf::SoundRecorder& m_recorder;
+    SampleSource& m_source;
+    const AnalysisWorker& m_analysis;
+    AudioDeviceRegistry& m_devices;
+
+    // null if the input is not a capture device
+    SampleQueueRecorder* m_recorder;
 };
@@ -5,9 +5,12 @@
 
 #include <SFML/Graphics.hpp>
 
-#include <spiralviz/dsp/windowedfft.hpp>
-#include <spiralviz/audio/recorder.hpp>
+#include <spiralviz/analysisworker.hpp>
+#include <spiralviz/fftstreamer.hpp>
 #include <spiralviz/gui/vizutil.hpp>
+#include <spiralviz/util/latencystats.hpp>
+
+#include <string>
 
 struct FFTDebugParams
 {
@@ -20,26 +23,38 @@ class FFTDebugGUI
 {
     public:
     FFTDebugGUI(
-        FFTHighLevelConfig* config,
+        FFTStreamer* streamer,
+        AnalysisWorker* analysis,
         VizParams* viz_params,
-        WindowedFFT* fft,
-        SampleQueueRecorder* recorder) :
-        m_fft_hl_config{*config},
+        LatencyStats* latency) :
+        m_streamer{*streamer},
+        m_analysis{*analysis},
         m_viz_params{*viz_params},
-        m_fft{*fft},
-        m_recorder{*recorder}
+        m_latency{*latency}
     {}
 
+    /// Shows the last status of `analysis`, and posts changes to it.
     void show_params_gui();
-    void show_fft_gui(std::span<const float> fft_data);
+
+    void show_fft_gui(const SpectrumFrame& frame);
 
     FFTDebugParams& params() { return m_params; }
     const FFTDebugParams& params() const { return m_params; }
 
     private:
+    void show_channel_gui(const StreamerStatus& status);
+    void show_multiresolution_gui(const StreamerStatus::MultiResolutionStatus& multires);
+    void show_sliding_dft_gui(const StreamerStatus::SlidingDFTStatus& sdft);
+    void show_latency_gui(const StreamerStatus& status);
+    void show_display_latency_gui();
+    void show_plan_gui(const StreamerStatus& status);
+    void show_realtime_report_gui();
+
     FFTDebugParams m_params;
-    FFTHighLevelConfig& m_fft_hl_config;
+    FFTStreamer& m_streamer;
+    AnalysisWorker& m_analysis;
     VizParams& m_viz_params;
-    WindowedFFT& m_fft;
-    SampleQueueRecorder& m_recorder;
-};
\ No newline at end of file
+    LatencyStats& m_latency;
+
+    std::string m_latency_export_status;
+};
@@ -3,10 +3,14 @@
 
 #pragma once
 
+#include <spiralviz/audio/capturetimeline.hpp>
+#include <spiralviz/dsp/spectrumformat.hpp>
+#include <spiralviz/dsp/spectrumlayout.hpp>
 #include <spiralviz/gui/vizutil.hpp>
 
 #include <SFML/Graphics.hpp>
 
+#include <optional>
 #include <span>
 
 struct VizPaths
@@ -26,7 +30,23 @@ class VizShader
     void render_into(sf::RenderTarget& target, sf::FloatRect target_rect);
     void render_into(sf::RenderTarget& target);
 
-    void update_fft_texture(std::span<const float> fft_data, std::size_t sample_rate);
+    /// `layout` tells how bins map to frequencies, and which slice of the
+    /// spectrum `fft_data` holds, and `capture_time` is when the newest sample
+    /// behind `fft_data` was captured, if known.
+    ///
+    /// The texture keeps the format of `fft_data`, so that the log formats
+    /// upload as 16 or 8-bit normalized texels, which the shader turns back
+    /// into magnitudes.
+    void update_fft_texture(
+        const EncodedSpectrum& fft_data,
+        std::size_t sample_rate,
+        const SpectrumLayout& layout = {},
+        std::optional<CaptureClock::time_point> capture_time = std::nullopt
+    );
+
+    /// Capture time of the spectrum currently in the texture, see
+    /// `update_fft_texture`.
+    std::optional<CaptureClock::time_point> fft_capture_time() const { return m_fft_capture_time; }
 
     VizParams& params() { return m_params; }
     const VizParams& params() const { return m_params; }
@@ -38,10 +58,12 @@ class VizShader
     void reload_uniforms();
 
     sf::Texture m_fft;
+    SpectrumLayout m_fft_layout;
+    SpectrumFormat m_fft_format = SpectrumFormat::FLOAT;
+    LogLevelRange m_fft_log_range;
+    std::optional<CaptureClock::time_point> m_fft_capture_time;
     sf::Texture m_colormap;
 
-    std::size_t m_sample_rate;
-
     sf::Shader m_shader;
 
     VizParams m_params;
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <spiralviz/dsp/spectrumlayout.hpp>
+
 #include <SFML/System.hpp>
 
 // FIXME: float type consistency
@@ -16,6 +18,10 @@ struct VizParams
     float vol_min = 0.0;
     float vol_max = 0.3;
 
+    // Rate of the analyzed signal, which can differ from the capture rate if
+    // it got resampled. Set along with the FFT data.
+    float sample_rate = 44100.0;
+
     bool smooth_fft = true;
 };
 
@@ -38,4 +44,8 @@ struct VizLocationInformation
 sf::Vector2f viz_origin(sf::Vector2f target_resolution);
 VizPointInformation viz_info_at_position(sf::Vector2f screen_pos, sf::Vector2f target_resolution, const VizParams& params);
 VizLocationInformation viz_points_from_cents(double cents, sf::Vector2f target_resolution, const VizParams& params);
-double viz_cents_from_frequency(double frequency);
\ No newline at end of file
+double viz_cents_from_frequency(double frequency);
+
+/// Frequencies shown somewhere on a target of `target_resolution`, from the
+/// innermost turn of the spiral to the one reaching the farthest corner.
+FrequencyRange viz_visible_frequencies(sf::Vector2f target_resolution, const VizParams& params);
\ No newline at end of file
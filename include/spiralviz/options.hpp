@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/filesource.hpp>
+#include <spiralviz/audio/pipesource.hpp>
+#include <spiralviz/audio/recorder.hpp>
+#include <spiralviz/dsp/kernels.hpp>
+#include <spiralviz/dsp/spectrumformat.hpp>
+#include <spiralviz/fftstreamer.hpp>
+#include <spiralviz/util/realtime.hpp>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+/// Command-line options.
+struct Options
+{
+    /// Reads samples from this WAV (or raw PCM) file instead of capturing.
+    std::optional<std::string> input_path;
+    std::optional<RawPCMParams> raw_params;
+    PlaybackPacing pacing = PlaybackPacing::REALTIME;
+
+    /// Streams raw PCM from this FIFO (or "-" for stdin) instead of capturing.
+    std::optional<std::string> pipe_path;
+    std::size_t pipe_block_samples = PipeSourceParams{}.block_samples;
+    std::size_t pipe_read_ahead_blocks = PipeSourceParams{}.read_ahead_blocks;
+
+    std::size_t sample_rate = 44100;
+    std::size_t channel_count = 1; // for capture and raw PCM
+    SampleFormat queue_format = SampleFormat::S16;
+    DeviceSwitchConfig device_switch;
+
+    /// Archives the captured audio to this WAV file.
+    std::optional<std::string> archive_path;
+
+    ResamplingConfig resampling;
+    PlanningConfig planning;
+    FFTHighLevelConfig window = default_hl_config;
+    SpectrumEngine engine = SpectrumEngine::LINEAR_FFT;
+    SpectrumFormat spectrum_format = SpectrumFormat::FLOAT;
+
+    BacklogConfig backlog;
+    std::size_t hop_size = 512;
+    std::size_t batch_hops = 0; // see `FFTStreamer::set_batch_hops`
+
+    RealtimeConfig realtime;
+
+    /// Forces the SIMD kernels to this instruction set, rather than the best
+    /// one supported.
+    std::optional<KernelISA> kernel_isa;
+
+    /// Runs the analysis over the whole input without opening a window, then
+    /// reports timings.
+    bool benchmark = false;
+    std::size_t benchmark_hop = 0; // 0 means the analysis hop size
+
+    /// Compares the kernels of every supported instruction set, then exits.
+    bool kernel_benchmark = false;
+
+    bool show_help = false;
+};
+
+/// Throws `std::runtime_error` on invalid arguments.
+Options parse_options(int argc, char** argv);
+
+void print_usage(const char* program_name);
+
+/// Creates the sample source described by `options`, starting capture if
+/// it is a live one.
+std::unique_ptr<SampleSource> make_sample_source(const Options& options);
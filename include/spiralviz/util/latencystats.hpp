@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/// Rolling window of the most recent latency measurements.
+class LatencyStats
+{
+    public:
+    explicit LatencyStats(std::size_t window_size = 1024);
+
+    void record(std::chrono::steady_clock::duration latency);
+    void clear();
+
+    /// Measurements currently in the window.
+    std::size_t size() const { return m_samples.size(); }
+    bool empty() const { return m_samples.empty(); }
+
+    /// Latency in milliseconds below which `fraction` of the window falls,
+    /// e.g. 0.99 for the 99th percentile. 0 if the window is empty.
+    float percentile_ms(float fraction) const;
+
+    float max_ms() const;
+
+    /// Counts of measurements per bucket of `bucket_ms` milliseconds, starting
+    /// at 0, the last bucket accounting for everything beyond.
+    std::vector<float> histogram(std::size_t bucket_count, float bucket_ms) const;
+
+    /// Writes the window as CSV, oldest first, with the time of every
+    /// measurement relative to the first one since the last `clear`.
+    /// Throws `std::runtime_error` if the file cannot be written.
+    void export_csv(const std::string& path) const;
+
+    private:
+    struct Sample
+    {
+        double recorded_at_s;
+        float latency_ms;
+    };
+
+    std::size_t m_window_size;
+    std::vector<Sample> m_samples;
+    std::size_t m_oldest = 0; // once the window is full, index of the oldest sample
+
+    std::chrono::steady_clock::time_point m_first_record;
+};
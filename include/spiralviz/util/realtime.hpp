@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+enum class SchedulingPolicy
+{
+    DEFAULT = 0, // whatever the thread inherited, usually SCHED_OTHER
+    FIFO = 1,    // SCHED_FIFO
+    ROUND_ROBIN = 2 // SCHED_RR
+};
+
+static constexpr const char* get_scheduling_policy_string(SchedulingPolicy policy)
+{
+    switch (policy)
+    {
+    case SchedulingPolicy::DEFAULT: return "default";
+    case SchedulingPolicy::FIFO: return "SCHED_FIFO";
+    case SchedulingPolicy::ROUND_ROBIN: return "SCHED_RR";
+    default: return "???";
+    }
+}
+
+/// Scheduling settings for a class of threads. The default-constructed value
+/// leaves threads untouched.
+struct ThreadSchedule
+{
+    SchedulingPolicy policy = SchedulingPolicy::DEFAULT;
+
+    /// Real-time priority, clamped to what the policy supports.
+    int priority = 0;
+
+    /// Cores the thread may run on. Empty means any.
+    std::vector<std::size_t> cpus;
+
+    bool is_default() const { return policy == SchedulingPolicy::DEFAULT && cpus.empty(); }
+};
+
+struct RealtimeConfig
+{
+    /// SFML's capture thread, or the pipe reader.
+    ThreadSchedule capture;
+
+    /// The analysis thread and its helpers. In benchmark mode, also the main
+    /// thread.
+    ThreadSchedule analysis;
+
+    /// The main thread, which renders the newest spectrum.
+    ThreadSchedule render;
+
+    /// Locks the memory of the process once everything got allocated, so
+    /// that none of it can be paged out.
+    bool lock_memory = false;
+};
+
+/// Outcome of a single setting, as reported by `realtime_report`.
+struct RealtimeReportEntry
+{
+    std::string thread;
+    std::string setting;
+    bool applied;
+    std::string detail; // reason of the failure, if any
+};
+
+/// Applies `schedule` to the calling thread, as far as permitted. Failures,
+/// e.g. due to missing privileges, are only recorded in the report.
+///
+/// Allocates and locks, so real-time threads should only call this once
+/// before starting their actual work.
+void apply_thread_schedule(const ThreadSchedule& schedule, const std::string& thread_name);
+
+/// Locks all the currently mapped memory of the process, recording the
+/// outcome in the report.
+void lock_process_memory();
+
+/// Every setting applied so far, and whether it took effect.
+std::vector<RealtimeReportEntry> realtime_report();
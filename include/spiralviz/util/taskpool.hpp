@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Minimal fork-join thread pool, used to spread independent analysis work
+/// (e.g. one FFT per channel) across cores.
+class TaskPool
+{
+    public:
+    /// Spawns `worker_count` threads, which help out the thread calling
+    /// `parallel_for`. With no workers, everything runs on the calling thread.
+    explicit TaskPool(std::size_t worker_count = 0);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    /// Calls `task(i)` for every `i` in `[0; count)` and returns once all of
+    /// the calls completed. Must not be called concurrently.
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)>& task);
+
+    /// Calls `task(i)` once on every worker thread, where `i` is the index of
+    /// the worker, and returns once all of the calls completed. Useful to set
+    /// up the workers themselves, e.g. their scheduling.
+    void run_on_workers(const std::function<void(std::size_t)>& task);
+
+    std::size_t worker_count() const { return m_workers.size(); }
+
+    private:
+    void worker_loop(std::size_t worker_index);
+    void run_tasks();
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_lock;
+    std::condition_variable m_job_cv;
+    std::condition_variable m_done_cv;
+
+    const std::function<void(std::size_t)>* m_task = nullptr;
+    const std::function<void(std::size_t)>* m_worker_task = nullptr;
+    std::size_t m_task_count = 0;
+    std::atomic<std::size_t> m_next_task = 0;
+
+    std::uint64_t m_generation = 0;
+    std::size_t m_busy_workers = 0;
+    bool m_stop = false;
+};
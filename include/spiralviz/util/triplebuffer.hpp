@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#pragma once
+
+#include <spiralviz/audio/ringbuffer.hpp>
+
+#include <array>
+#include <atomic>
+
+/// Lock-free handoff of the latest value from one producer thread to one
+/// consumer thread, where only the newest value matters.
+///
+/// Each side owns one of the three slots, and the third one sits in between.
+/// The producer fills its slot then swaps it with the middle one, and the
+/// consumer swaps its slot with the middle one whenever a newer value got
+/// published there. Neither side ever waits on the other, and values the
+/// consumer did not pick up in time are simply overwritten.
+///
+/// Slots get reused, so a producer filling containers in place does not
+/// allocate once they reached their steady size.
+template<class T>
+class TripleBuffer
+{
+    public:
+    TripleBuffer() = default;
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /// Producer: slot to fill before `publish`. Holds whatever value it last
+    /// had, which is not necessarily the last one published.
+    T& write_slot() { return m_slots[m_back]; }
+
+    /// Producer: makes the write slot the latest value.
+    void publish()
+    {
+        m_back = m_middle.exchange(m_back | fresh_flag, std::memory_order_acq_rel) & index_mask;
+    }
+
+    /// Consumer: switches to the latest published value, if there is one the
+    /// consumer did not see yet. Returns whether `read_slot` changed.
+    bool fetch()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & fresh_flag) == 0)
+        {
+            return false;
+        }
+
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    /// Consumer: latest value fetched.
+    const T& read_slot() const { return m_slots[m_front]; }
+
+    private:
+    static constexpr unsigned index_mask = 0b011;
+    static constexpr unsigned fresh_flag = 0b100;
+
+    std::array<T, 3> m_slots{};
+
+    // Producer and consumer only share this, along with the slot it refers to
+    alignas(cache_line_size) std::atomic<unsigned> m_middle = 1;
+
+    alignas(cache_line_size) unsigned m_back = 0; // producer only
+    alignas(cache_line_size) unsigned m_front = 2; // consumer only
+};
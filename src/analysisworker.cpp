@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/analysisworker.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+PlanStatus get_plan_status(const FFTPlan& plan)
+{
+    return {
+        .rigor = plan.rigor(),
+        .from_wisdom = plan.is_from_wisdom(),
+        .planning_time = plan.planning_time(),
+        .mean_execute_us = plan.mean_execute_us(),
+        .batch_count = plan.batch_count(),
+        .thread_count = plan.thread_count()
+    };
+}
+}
+
+AnalysisWorker::~AnalysisWorker()
+{
+    if (m_thread.joinable())
+    {
+        m_stop = true;
+        m_thread.join();
+    }
+}
+
+void AnalysisWorker::start(const ThreadSchedule& schedule)
+{
+    // something to show until the first update
+    fill_status(m_status.write_slot());
+    m_status.publish();
+
+    m_thread = std::thread{[this, schedule] { worker_loop(schedule); }};
+}
+
+void AnalysisWorker::post(std::function<void(FFTStreamer&)> command)
+{
+    if (!m_thread.joinable())
+    {
+        command(m_streamer);
+        return;
+    }
+
+    std::lock_guard lk{m_command_lock};
+    m_commands.push_back(std::move(command));
+}
+
+bool AnalysisWorker::run_commands()
+{
+    {
+        // swapped out so that posting never waits on a command
+        std::lock_guard lk{m_command_lock};
+        std::swap(m_commands, m_running_commands);
+    }
+
+    if (m_running_commands.empty())
+    {
+        return false;
+    }
+
+    for (const auto& command : m_running_commands)
+    {
+        command(m_streamer);
+    }
+
+    m_running_commands.clear();
+    return true;
+}
+
+bool AnalysisWorker::fetch_latest()
+{
+    const std::uint64_t previous = m_frames.read_slot().sequence;
+
+    if (!m_frames.fetch())
+    {
+        return false;
+    }
+
+    m_skipped_frames += m_frames.read_slot().sequence - previous - 1;
+    return true;
+}
+
+void AnalysisWorker::worker_loop(ThreadSchedule schedule)
+{
+    apply_thread_schedule(schedule, "analysis");
+
+    while (!m_stop)
+    {
+        const bool ran_commands = run_commands();
+
+        const std::span<const float> magnitudes = m_streamer.update_fft();
+
+        if (!magnitudes.empty())
+        {
+            fill_frame(m_frames.write_slot(), magnitudes);
+            m_frames.publish();
+        }
+
+        if (ran_commands || !magnitudes.empty())
+        {
+            fill_status(m_status.write_slot());
+            m_status.publish();
+        }
+
+        // `update_fft` consumed every completed hop, so the next one is a
+        // whole hop away. Polls a few times per hop meanwhile, so that it
+        // gets analyzed soon after it completes.
+        const auto idle_time = std::chrono::microseconds(
+            250'000 * m_streamer.hop_size() / m_streamer.source().sample_rate()
+        );
+
+        std::this_thread::sleep_for(std::max(idle_time, std::chrono::microseconds(500)));
+    }
+}
+
+void AnalysisWorker::fill_frame(SpectrumFrame& frame, std::span<const float> magnitudes)
+{
+    // encoding reuses the storage of the slot
+    frame.magnitudes.encode(magnitudes, m_format, m_log_range);
+
+    frame.channel_magnitudes.resize(m_streamer.analyze_all_channels() ? m_streamer.channel_count() : 0);
+    for (std::size_t i = 0; i < frame.channel_magnitudes.size(); ++i)
+    {
+        frame.channel_magnitudes[i].encode(m_streamer.channel_magnitudes(i), m_format, m_log_range);
+    }
+
+    frame.layout = m_streamer.layout();
+    frame.sample_rate = m_streamer.analysis_rate();
+    frame.capture_time = m_streamer.latest_capture_time();
+    frame.sequence = m_published.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void AnalysisWorker::fill_status(StreamerStatus& status)
+{
+    status.hl_config = m_streamer.hl_config();
+    status.config = m_streamer.config();
+    status.window_pending = m_streamer.is_window_pending();
+    status.window_error = m_streamer.window_error();
+
+    status.engine = m_streamer.engine();
+    status.engine_pending = m_streamer.is_engine_pending();
+
+    if (const MultiResolutionSpectrum* multires = m_streamer.multiresolution())
+    {
+        status.multiresolution = StreamerStatus::MultiResolutionStatus{multires->config(), multires->bands()};
+    }
+    else
+    {
+        status.multiresolution.reset();
+    }
+
+    if (const SlidingDFT* sdft = m_streamer.sliding_dft())
+    {
+        status.sliding_dft = StreamerStatus::SlidingDFTStatus{sdft->config(), sdft->window_size(), sdft->tracked_bin_count()};
+    }
+    else
+    {
+        status.sliding_dft.reset();
+    }
+
+    const SampleSource& source = m_streamer.source();
+    status.source_rate = source.sample_rate();
+    status.analysis_rate = m_streamer.analysis_rate();
+    status.resampling = m_streamer.is_resampling();
+
+    status.channel_count = m_streamer.channel_count();
+    status.selected_channels = m_streamer.selected_channels();
+    status.analyze_all_channels = m_streamer.analyze_all_channels();
+
+    status.hop_size = m_streamer.hop_size();
+    status.batch_hops = m_streamer.batch_hops();
+    status.backlog_config = m_streamer.backlog_config();
+    status.backlog_stats = m_streamer.backlog_stats();
+
+    status.plan = get_plan_status(m_streamer.plan());
+
+    if (const FFTPlan* replaced = m_streamer.replaced_plan())
+    {
+        status.replaced_plan = get_plan_status(*replaced);
+    }
+    else
+    {
+        status.replaced_plan.reset();
+    }
+
+    if (const FFTPlan* batch = m_streamer.batch_plan())
+    {
+        status.batch_plan = get_plan_status(*batch);
+    }
+    else
+    {
+        status.batch_plan.reset();
+    }
+
+    status.queued_samples = source.available();
+    status.dropped_samples = source.dropped_samples();
+    status.overwritten_samples = source.overwritten_samples();
+
+    status.output_format = m_format;
+    status.log_level_range = m_log_range;
+}
@@ -18,27 +18,46 @@
 #include <stdexcept>
 #include <GL/gl.h>
 
-App::App() :
+App::App(const Options& options) :
     m_window{
         sf::VideoMode{1280, 720},
         "spiralviz",
         sf::Style::Default,
         sf::ContextSettings{0, 0, 8} // 8x MSAA
     },
+    m_streamer{make_sample_source(options), options.window, options.resampling, options.planning},
+    m_analysis{&m_streamer},
+    m_devices{
+        std::chrono::seconds{5},
+        [recorder = dynamic_cast<SampleQueueRecorder*>(&m_streamer.source())] {
+            return recorder != nullptr ? recorder->device() : std::string{};
+        }
+    },
     m_viz{viz_paths_defaults},
     m_note_render{
         &m_viz.params()
     },
     m_fft_gui{
-        &m_hl_config,
+        &m_streamer,
+        &m_analysis,
         &m_viz.params(),
-        &m_streamer.fft(),
-        &m_streamer.recorder()
+        &m_latency
     },
     m_audio_input_gui(
-        &m_streamer.recorder()
+        &m_streamer.source(),
+        &m_analysis,
+        &m_devices
     )
 {
+    m_streamer.set_backlog_config(options.backlog);
+    m_streamer.set_hop_size(options.hop_size);
+    m_streamer.set_batch_hops(options.batch_hops);
+    m_streamer.set_engine(options.engine);
+    m_analysis.set_output_format(options.spectrum_format);
+
+    apply_thread_schedule(options.realtime.render, "render");
+    m_streamer.apply_worker_schedule(options.realtime.analysis);
+
     m_window.setFramerateLimit(240);
     if (!ImGui::SFML::Init(m_window, false))
     {
@@ -46,6 +65,15 @@ App::App() :
     }
 
     imgui_apply_theme();
+
+    // the streamer is only accessed through the analysis from here on
+    m_analysis.start(options.realtime.analysis);
+
+    // last, so that everything allocated at startup gets locked
+    if (options.realtime.lock_memory)
+    {
+        lock_process_memory();
+    }
 }
 
 void App::show_until_closed()
@@ -65,7 +93,7 @@ void App::show_until_closed()
 
         show_main_bar_gui();
 
-        update_fft(dt);
+        update_fft();
 
         {
             // imgui stuff -- note that this actually gets pushed on the screen
@@ -73,6 +101,7 @@ void App::show_until_closed()
             // ImGui::ShowDemoWindow();
             m_note_render.show_controls_gui();
             m_fft_gui.show_params_gui();
+
             m_audio_input_gui.show_gui();
         }
 
@@ -84,6 +113,7 @@ void App::show_until_closed()
         ImGui::SFML::Render(m_window);
 
         m_window.display();
+        record_display_latency();
     }
 }
 
@@ -218,20 +248,55 @@ void App::handle_event(const sf::Event& ev)
     }
 }
 
-void App::update_fft(sf::Time dt)
+void App::update_fft()
 {
-    m_samples_dt += double(dt.asMicroseconds()) / samples_per_us(m_streamer.recorder().getSampleRate());
-    std::size_t samples_to_load = std::floor(m_samples_dt);
-    m_samples_dt -= samples_to_load;
+    // only the bins the spiral can show get computed and uploaded
+    const sf::Vector2u window_size = m_window.getSize();
+    const FrequencyRange visible_range = viz_visible_frequencies(
+        {float(window_size.x), float(window_size.y)},
+        m_viz.params()
+    );
+
+    if (visible_range != m_visible_range)
+    {
+        m_analysis.post([visible_range](FFTStreamer& streamer) { streamer.set_visible_range(visible_range); });
+        m_visible_range = visible_range;
+    }
+
+    // read by the GUIs
+    m_analysis.fetch_status();
+
+    if (m_analysis.fetch_latest())
+    {
+        const SpectrumFrame& frame = m_analysis.latest();
+
+        m_viz.update_fft_texture(
+            frame.magnitudes,
+            frame.sample_rate,
+            frame.layout,
+            frame.capture_time
+        );
+        m_fft_texture_displayed = false;
+    }
+
+    // keep showing the latest spectrum on frames where no hop was completed
+    m_fft_gui.show_fft_gui(m_analysis.latest());
+}
+
+void App::record_display_latency()
+{
+    if (m_fft_texture_displayed)
+    {
+        return;
+    }
 
-    auto fft_data = m_streamer.update_fft(samples_to_load);
+    m_fft_texture_displayed = true;
 
-    if (!fft_data.empty())
+    // display() returns once the frame was handed over to the driver, which
+    // is as close to the screen as we can tell without querying the GPU
+    if (const auto capture_time = m_viz.fft_capture_time())
     {
-        // TODO: it's kinda ugly that we only show the window here, we probably
-        // should just store the FFT data somewhere...
-        m_fft_gui.show_fft_gui(fft_data);
-        m_viz.update_fft_texture(fft_data, m_streamer.recorder().getSampleRate());
+        m_latency.record(CaptureClock::now() - *capture_time);
     }
 }
 
@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/audio/archiver.hpp>
+
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+// Much shorter than the time it takes to fill a write block at any sensible
+// sample rate, and short enough for the writer to notice a stop request.
+constexpr int poll_interval_ms = 20;
+
+// The header is padded so that sample data starts on a page boundary.
+constexpr std::size_t page_size = 4096;
+constexpr std::size_t data_offset = page_size;
+constexpr std::size_t fmt_chunk_size = 16;
+constexpr std::size_t junk_chunk_offset = 12 + 8 + fmt_chunk_size;
+constexpr std::size_t data_chunk_offset = data_offset - 8;
+
+template<class T>
+void write_le(std::byte* target, T value)
+{
+    std::memcpy(target, &value, sizeof(T));
+}
+
+std::string segment_path(const std::string& path, std::size_t index)
+{
+    if (index == 0)
+    {
+        return path;
+    }
+
+    std::filesystem::path ret{path};
+    const auto extension = ret.extension();
+    ret.replace_filename(ret.stem().string() + "-" + std::to_string(index));
+    ret += extension;
+    return ret.string();
+}
+
+bool write_fully(int fd, const void* data, std::size_t size, off_t offset)
+{
+    const char* bytes = static_cast<const char*>(data);
+
+    while (size > 0)
+    {
+        const ssize_t written = ::pwrite(fd, bytes, size, offset);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+
+    return true;
+}
+}
+
+void CaptureArchiver::AlignedDeleter::operator()(std::int16_t* ptr) const
+{
+    std::free(ptr);
+}
+
+CaptureArchiver::CaptureArchiver(ArchiveParams params) :
+    m_params{std::move(params)},
+    m_frame_bytes{m_params.channel_count * sizeof(std::int16_t)},
+    m_ring{m_params.sample_rate * m_params.channel_count * m_params.buffer_ms / 1000}
+{
+    if constexpr (std::endian::native != std::endian::little)
+    {
+        throw std::runtime_error("Archiving is only supported on little-endian hosts");
+    }
+
+    m_params.write_block_bytes = std::max(
+        (m_params.write_block_bytes + page_size - 1) / page_size * page_size,
+        page_size
+    );
+
+    // segments must end on a write block so that every write but the last
+    // stays aligned, and on a frame so that no file ends mid-frame
+    const std::uint64_t max_data_bytes = std::numeric_limits<std::uint32_t>::max() - (data_offset - 8);
+    const std::uint64_t segment_unit = std::lcm(std::uint64_t(m_params.write_block_bytes), std::uint64_t(m_frame_bytes));
+    m_segment_limit = max_data_bytes / segment_unit * segment_unit;
+
+    if (m_segment_limit == 0)
+    {
+        throw std::runtime_error("Archive write block size is too large");
+    }
+
+    m_block.reset(static_cast<std::int16_t*>(std::aligned_alloc(page_size, m_params.write_block_bytes)));
+
+    if (m_block == nullptr)
+    {
+        throw std::runtime_error("Failed to allocate the archive write buffer");
+    }
+
+    open_segment();
+
+    m_writer = std::thread{[this] { writer_loop(); }};
+}
+
+CaptureArchiver::~CaptureArchiver()
+{
+    m_stop_requested.store(true, std::memory_order_relaxed);
+    m_writer.join();
+
+    close_segment();
+}
+
+void CaptureArchiver::push(std::span<const std::int16_t> interleaved)
+{
+    // blocks are all or nothing, so that gaps in the archive can be told
+    // apart from dropped blocks
+    if (interleaved.size() > m_ring.capacity() - m_ring.size())
+    {
+        m_dropped_blocks.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    m_ring.push(interleaved);
+
+    // only ever written from here, so no need for a compare-exchange
+    const std::size_t queued_bytes = m_ring.size() * sizeof(std::int16_t);
+    if (queued_bytes > m_high_water_mark.load(std::memory_order_relaxed))
+    {
+        m_high_water_mark.store(queued_bytes, std::memory_order_relaxed);
+    }
+}
+
+double CaptureArchiver::write_throughput() const
+{
+    const std::uint64_t write_ns = m_write_ns.load(std::memory_order_relaxed);
+    return write_ns != 0 ? bytes_written() * 1.0e9 / write_ns : 0.0;
+}
+
+void CaptureArchiver::writer_loop()
+{
+    while (!m_stop_requested.load(std::memory_order_relaxed))
+    {
+        drain(false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(poll_interval_ms));
+    }
+
+    // blocks may still have been pushed in since the last drain
+    drain(true);
+}
+
+void CaptureArchiver::drain(bool flush)
+{
+    const std::size_t block_samples = m_params.write_block_bytes / sizeof(std::int16_t);
+
+    for (;;)
+    {
+        if (failed())
+        {
+            // keep the ring moving so that stats stay meaningful
+            m_ring.clear();
+            return;
+        }
+
+        const auto views = m_ring.peek(block_samples - m_block_fill);
+
+        if (views.empty())
+        {
+            break;
+        }
+
+        std::int16_t* target = m_block.get() + m_block_fill;
+        target = std::copy(views.first.begin(), views.first.end(), target);
+        std::copy(views.second.begin(), views.second.end(), target);
+
+        m_block_fill += views.size();
+        m_ring.pop(views.size());
+
+        if (m_block_fill == block_samples)
+        {
+            write_block(m_params.write_block_bytes);
+            m_block_fill = 0;
+        }
+    }
+
+    if (flush && m_block_fill != 0)
+    {
+        write_block(m_block_fill * sizeof(std::int16_t));
+        m_block_fill = 0;
+    }
+}
+
+void CaptureArchiver::write_block(std::size_t bytes)
+{
+    if (m_segment_data_bytes + bytes > m_segment_limit)
+    {
+        try
+        {
+            close_segment();
+            open_segment();
+        }
+        catch (const std::runtime_error&)
+        {
+            m_failed.store(true, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    if (!write_fully(m_fd, m_block.get(), bytes, data_offset + m_segment_data_bytes))
+    {
+        m_failed.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    m_segment_data_bytes += bytes;
+    update_header();
+
+    const auto write_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    m_write_ns.fetch_add(write_ns.count(), std::memory_order_relaxed);
+    m_bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void CaptureArchiver::open_segment()
+{
+    const std::string path = segment_path(m_params.path, segment_count());
+
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (m_fd < 0)
+    {
+        throw std::runtime_error("Failed to create " + path + ": " + std::strerror(errno));
+    }
+
+    const auto channels = std::uint16_t(m_params.channel_count);
+    const auto sample_rate = std::uint32_t(m_params.sample_rate);
+
+    std::byte header[data_offset] = {};
+    std::memcpy(header, "RIFF", 4);
+    std::memcpy(header + 8, "WAVE", 4);
+    std::memcpy(header + 12, "fmt ", 4);
+    write_le<std::uint32_t>(header + 16, fmt_chunk_size);
+    write_le<std::uint16_t>(header + 20, 1); // PCM
+    write_le<std::uint16_t>(header + 22, channels);
+    write_le<std::uint32_t>(header + 24, sample_rate);
+    write_le<std::uint32_t>(header + 28, sample_rate * std::uint32_t(m_frame_bytes));
+    write_le<std::uint16_t>(header + 32, std::uint16_t(m_frame_bytes));
+    write_le<std::uint16_t>(header + 34, 16);
+    std::memcpy(header + junk_chunk_offset, "JUNK", 4);
+    write_le<std::uint32_t>(header + junk_chunk_offset + 4, data_chunk_offset - junk_chunk_offset - 8);
+    std::memcpy(header + data_chunk_offset, "data", 4);
+
+    m_segment_data_bytes = 0;
+
+    if (!write_fully(m_fd, header, sizeof(header), 0))
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        throw std::runtime_error("Failed to write to " + path + ": " + std::strerror(errno));
+    }
+
+    update_header();
+    m_segment_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CaptureArchiver::close_segment()
+{
+    if (m_fd >= 0)
+    {
+        // the header is already up to date
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void CaptureArchiver::update_header()
+{
+    std::byte riff_size[4], data_size[4];
+    write_le<std::uint32_t>(riff_size, std::uint32_t(data_offset - 8 + m_segment_data_bytes));
+    write_le<std::uint32_t>(data_size, std::uint32_t(m_segment_data_bytes));
+
+    // failing to write these does not lose any audio, which can still be
+    // recovered from the file
+    write_fully(m_fd, riff_size, sizeof(riff_size), 4);
+    write_fully(m_fd, data_size, sizeof(data_size), data_chunk_offset + 4);
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/audio/capturetimeline.hpp>
+
+CaptureTimeline::CaptureTimeline(std::size_t max_blocks) :
+    m_stamps{max_blocks}
+{}
+
+void CaptureTimeline::stamp(std::size_t frame_count, CaptureClock::time_point captured_at)
+{
+    m_stamped_frames += frame_count;
+
+    const BlockStamp stamp{.end_frame = m_stamped_frames, .captured_at = captured_at};
+    m_stamps.push(std::span{&stamp, 1});
+}
+
+void CaptureTimeline::advance(std::size_t frame_count)
+{
+    if (frame_count == 0)
+    {
+        return;
+    }
+
+    m_consumed_frames += frame_count;
+
+    // forget about blocks that were entirely consumed, except for the newest
+    for (auto views = m_stamps.peek(1); !views.empty(); views = m_stamps.peek(1))
+    {
+        const BlockStamp& oldest = views.first.front();
+
+        if (oldest.end_frame >= m_consumed_frames)
+        {
+            // the newest consumed frame is within this block, which was
+            // captured up to its last frame at `captured_at`
+            m_last_consumed_time = oldest.captured_at - frames_duration(oldest.end_frame - m_consumed_frames);
+            return;
+        }
+
+        m_last_stamp = oldest;
+        m_stamps.pop(1);
+    }
+
+    // the block was consumed before its stamp became visible, or the stamp
+    // was dropped: extrapolate from the last known block
+    if (m_last_stamp)
+    {
+        m_last_consumed_time = m_last_stamp->captured_at + frames_duration(m_consumed_frames - m_last_stamp->end_frame);
+    }
+}
+
+CaptureClock::duration CaptureTimeline::frames_duration(std::uint64_t frame_count) const
+{
+    if (m_sample_rate == 0)
+    {
+        return {};
+    }
+
+    return std::chrono::duration_cast<CaptureClock::duration>(
+        std::chrono::duration<double>(double(frame_count) / m_sample_rate)
+    );
+}
@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/audio/devices.hpp>
+
+#include <SFML/Audio.hpp>
+
+#include <algorithm>
+#include <array>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#if defined(SPIRALVIZ_HAS_OPENAL)
+#include <al.h>
+#include <alc.h>
+#endif
+
+namespace
+{
+// Short enough for the monitor to notice a stop request quickly.
+constexpr int poll_interval_ms = 100;
+
+// Where ALSA creates and removes device nodes on hotplug.
+constexpr const char* device_node_path = "/dev/snd";
+
+#if defined(SPIRALVIZ_HAS_OPENAL)
+constexpr std::array<std::size_t, 7> probed_sample_rates = {
+    22050, 44100, 48000, 88200, 96000, 176400, 192000
+};
+
+bool can_open_capture(const std::string& name, std::size_t sample_rate, ALenum format)
+{
+    ALCdevice* device = alcCaptureOpenDevice(
+        name.c_str(),
+        ALCuint(sample_rate),
+        format,
+        ALCsizei(sample_rate / 10)
+    );
+
+    if (device == nullptr)
+    {
+        return false;
+    }
+
+    alcCaptureCloseDevice(device);
+    return true;
+}
+#endif
+
+AudioDeviceCapabilities probe_capabilities([[maybe_unused]] const std::string& name)
+{
+    AudioDeviceCapabilities ret;
+
+#if defined(SPIRALVIZ_HAS_OPENAL)
+    ret.probed = true;
+
+    for (std::size_t sample_rate : probed_sample_rates)
+    {
+        if (can_open_capture(name, sample_rate, AL_FORMAT_MONO16))
+        {
+            ret.sample_rates.push_back(sample_rate);
+            ret.max_channels = std::max<std::size_t>(ret.max_channels, 1);
+
+            // same limit as sf::SoundRecorder
+            if (ret.max_channels < 2 && can_open_capture(name, sample_rate, AL_FORMAT_STEREO16))
+            {
+                ret.max_channels = 2;
+            }
+        }
+    }
+
+    if (ret.sample_rates.empty())
+    {
+        // most likely busy, e.g. held exclusively by another program, rather
+        // than unable to capture at all
+        return {};
+    }
+#endif
+
+    return ret;
+}
+}
+
+bool AudioDeviceCapabilities::supports(std::size_t sample_rate, std::size_t channel_count) const
+{
+    if (!probed)
+    {
+        // give it a try, nothing is known either way
+        return true;
+    }
+
+    return channel_count <= max_channels
+        && std::find(sample_rates.begin(), sample_rates.end(), sample_rate) != sample_rates.end();
+}
+
+const AudioDeviceInfo* AudioDeviceSnapshot::find(std::string_view name) const
+{
+    const auto it = std::find_if(devices.begin(), devices.end(), [&](const AudioDeviceInfo& device) {
+        return device.name == name;
+    });
+
+    return it != devices.end() ? &*it : nullptr;
+}
+
+AudioDeviceRegistry::AudioDeviceRegistry(
+    std::chrono::milliseconds refresh_interval,
+    std::function<std::string()> active_device
+) :
+    m_refresh_interval{refresh_interval},
+    m_active_device{std::move(active_device)},
+    m_snapshot{std::make_shared<const AudioDeviceSnapshot>()}
+{
+    // hotplug detection is optional: the periodic refresh still applies
+    m_inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify_fd >= 0 && ::inotify_add_watch(m_inotify_fd, device_node_path, IN_CREATE | IN_DELETE) < 0)
+    {
+        ::close(m_inotify_fd);
+        m_inotify_fd = -1;
+    }
+
+    m_monitor = std::thread{[this] { monitor_loop(); }};
+}
+
+AudioDeviceRegistry::~AudioDeviceRegistry()
+{
+    m_stop_requested.store(true, std::memory_order_relaxed);
+    m_monitor.join();
+
+    if (m_inotify_fd >= 0)
+    {
+        ::close(m_inotify_fd);
+    }
+}
+
+bool AudioDeviceRegistry::can_probe_capabilities()
+{
+#if defined(SPIRALVIZ_HAS_OPENAL)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AudioDeviceRegistry::monitor_loop()
+{
+    auto last_refresh = std::chrono::steady_clock::now();
+
+    while (!m_stop_requested.load(std::memory_order_relaxed))
+    {
+        const bool hotplugged = drain_hotplug_events();
+
+        if (hotplugged)
+        {
+            m_capability_cache.clear();
+        }
+        const bool timed_out = std::chrono::steady_clock::now() - last_refresh >= m_refresh_interval;
+
+        if (m_refresh_requested.exchange(false, std::memory_order_relaxed) || hotplugged || timed_out)
+        {
+            refresh();
+            last_refresh = std::chrono::steady_clock::now();
+        }
+
+        if (m_inotify_fd >= 0)
+        {
+            pollfd pfd{.fd = m_inotify_fd, .events = POLLIN, .revents = 0};
+            ::poll(&pfd, 1, poll_interval_ms);
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(poll_interval_ms));
+        }
+    }
+}
+
+bool AudioDeviceRegistry::drain_hotplug_events()
+{
+    if (m_inotify_fd < 0)
+    {
+        return false;
+    }
+
+    bool any_event = false;
+    alignas(inotify_event) char buffer[4096];
+
+    while (::read(m_inotify_fd, buffer, sizeof(buffer)) > 0)
+    {
+        any_event = true;
+    }
+
+    if (any_event)
+    {
+        // the backend may not have picked up the new device yet by the time
+        // its node appears
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    return any_event;
+}
+
+void AudioDeviceRegistry::refresh()
+{
+    const auto previous = snapshot();
+
+    auto next = std::make_shared<AudioDeviceSnapshot>();
+    next->refreshed_at = std::chrono::steady_clock::now();
+
+    const std::string default_device = sf::SoundRecorder::getDefaultDevice();
+    const std::string active_device = m_active_device ? m_active_device() : std::string{};
+
+    for (std::string& name : sf::SoundRecorder::getAvailableDevices())
+    {
+        AudioDeviceCapabilities capabilities;
+
+        if (const auto cached = m_capability_cache.find(name); cached != m_capability_cache.end())
+        {
+            capabilities = cached->second;
+        }
+        else if (name != active_device)
+        {
+            capabilities = probe_capabilities(name);
+
+            // busy devices get probed again on the next refresh
+            if (capabilities.probed)
+            {
+                m_capability_cache.emplace(name, capabilities);
+            }
+        }
+
+        const bool is_default = name == default_device;
+        next->devices.push_back({
+            .name = std::move(name),
+            .is_default = is_default,
+            .capabilities = std::move(capabilities)
+        });
+    }
+
+    const bool changed = next->devices.size() != previous->devices.size()
+        || !std::equal(
+            next->devices.begin(), next->devices.end(),
+            previous->devices.begin(),
+            [](const AudioDeviceInfo& a, const AudioDeviceInfo& b) {
+                // a device gets probed late if it was in use
+                return a.name == b.name
+                    && a.is_default == b.is_default
+                    && a.capabilities.probed == b.capabilities.probed;
+            }
+        );
+
+    next->generation = previous->generation + (changed ? 1 : 0);
+
+    m_snapshot.store(std::move(next), std::memory_order_release);
+}
@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/audio/filesource.hpp>
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) < 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat " + path + ": " + std::strerror(errno));
+    }
+
+    m_size = file_stat.st_size;
+
+    if (m_size > 0)
+    {
+        void* mapping = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapping == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to map " + path + ": " + std::strerror(errno));
+        }
+
+        // we read front to back, let the kernel read ahead aggressively
+        ::madvise(mapping, m_size, MADV_SEQUENTIAL);
+
+        m_data = static_cast<const std::byte*>(mapping);
+    }
+
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr)
+    {
+        ::munmap(const_cast<std::byte*>(m_data), m_size);
+    }
+}
+
+namespace
+{
+template<class T>
+T read_le(std::span<const std::byte> bytes, std::size_t offset)
+{
+    if (offset + sizeof(T) > bytes.size())
+    {
+        throw std::runtime_error("Unexpected end of WAV file");
+    }
+
+    T ret;
+    std::memcpy(&ret, bytes.data() + offset, sizeof(T));
+    return ret;
+}
+
+bool has_fourcc(std::span<const std::byte> bytes, std::size_t offset, const char* fourcc)
+{
+    return offset + 4 <= bytes.size() && std::memcmp(bytes.data() + offset, fourcc, 4) == 0;
+}
+
+constexpr std::uint16_t wav_format_pcm = 0x0001;
+constexpr std::uint16_t wav_format_ieee_float = 0x0003;
+constexpr std::uint16_t wav_format_extensible = 0xFFFE;
+}
+
+FileSampleSource::FileSampleSource(
+    const std::string& path,
+    PlaybackPacing pacing,
+    std::optional<RawPCMParams> raw_params) :
+    m_file{path},
+    m_pacing{pacing}
+{
+    if constexpr (std::endian::native != std::endian::little)
+    {
+        throw std::runtime_error("File playback is only supported on little-endian hosts");
+    }
+
+    if (raw_params)
+    {
+        m_sample_rate = raw_params->sample_rate;
+        use_data(m_file.bytes(), raw_params->format, raw_params->channel_count);
+    }
+    else
+    {
+        parse_wav();
+    }
+}
+
+void FileSampleSource::parse_wav()
+{
+    const auto bytes = m_file.bytes();
+
+    if (!has_fourcc(bytes, 0, "RIFF") || !has_fourcc(bytes, 8, "WAVE"))
+    {
+        throw std::runtime_error("Not a RIFF/WAVE file");
+    }
+
+    std::optional<SampleFormat> format;
+    std::size_t channel_count = 0;
+
+    for (std::size_t offset = 12; offset + 8 <= bytes.size();)
+    {
+        const auto chunk_size = read_le<std::uint32_t>(bytes, offset + 4);
+        const std::size_t chunk_start = offset + 8;
+
+        if (has_fourcc(bytes, offset, "fmt "))
+        {
+            std::uint16_t tag = read_le<std::uint16_t>(bytes, chunk_start);
+            const auto channels = read_le<std::uint16_t>(bytes, chunk_start + 2);
+            const auto sample_rate = read_le<std::uint32_t>(bytes, chunk_start + 4);
+            const auto bits_per_sample = read_le<std::uint16_t>(bytes, chunk_start + 14);
+
+            if (tag == wav_format_extensible)
+            {
+                // the actual format tag is the start of the subformat GUID
+                tag = read_le<std::uint16_t>(bytes, chunk_start + 24);
+            }
+
+            if (channels == 0)
+            {
+                throw std::runtime_error("WAV file has no channels");
+            }
+
+            if (tag == wav_format_pcm && bits_per_sample == 16)
+            {
+                format = SampleFormat::S16;
+            }
+            else if (tag == wav_format_ieee_float && bits_per_sample == 32)
+            {
+                format = SampleFormat::F32;
+            }
+            else
+            {
+                throw std::runtime_error("Only 16-bit PCM and 32-bit float WAV files are supported");
+            }
+
+            m_sample_rate = sample_rate;
+            channel_count = channels;
+        }
+        else if (has_fourcc(bytes, offset, "data"))
+        {
+            if (!format)
+            {
+                throw std::runtime_error("WAV data chunk found before the fmt chunk");
+            }
+
+            const std::size_t data_size = std::min<std::size_t>(chunk_size, bytes.size() - chunk_start);
+            use_data(bytes.subspan(chunk_start, data_size), *format, channel_count);
+            return;
+        }
+
+        // chunks are padded to an even size
+        offset = chunk_start + chunk_size + (chunk_size & 1);
+    }
+
+    throw std::runtime_error("WAV file has no data chunk");
+}
+
+void FileSampleSource::use_data(std::span<const std::byte> data, SampleFormat format, std::size_t channel_count)
+{
+    const std::size_t sample_size = sample_format_size(format);
+    const std::size_t frame_count = data.size() / (sample_size * channel_count);
+
+    const auto set_channels = [&](const auto* samples) {
+        m_channels.clear();
+        for (std::size_t channel = 0; channel < channel_count; ++channel)
+        {
+            m_channels.push_back(SampleSpan::interleaved(samples + channel, frame_count, channel_count));
+        }
+    };
+
+    if (reinterpret_cast<std::uintptr_t>(data.data()) % sample_size != 0)
+    {
+        // can't point a span at it; this is the one case where we pay for a
+        // copy, as floats are what we'd use anyway
+        m_realigned.resize(frame_count * channel_count);
+        for (std::size_t i = 0; i < m_realigned.size(); ++i)
+        {
+            if (format == SampleFormat::S16)
+            {
+                std::int16_t sample;
+                std::memcpy(&sample, data.data() + i * sample_size, sample_size);
+                m_realigned[i] = s16_to_f32(sample);
+            }
+            else
+            {
+                std::memcpy(&m_realigned[i], data.data() + i * sample_size, sample_size);
+            }
+        }
+
+        set_channels(m_realigned.data());
+        return;
+    }
+
+    if (format == SampleFormat::S16)
+    {
+        set_channels(reinterpret_cast<const std::int16_t*>(data.data()));
+    }
+    else
+    {
+        set_channels(reinterpret_cast<const float*>(data.data()));
+    }
+}
+
+std::size_t FileSampleSource::arrived_samples() const
+{
+    if (m_pacing == PlaybackPacing::AS_FAST_AS_POSSIBLE)
+    {
+        return total_samples();
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+
+    if (!m_start_time)
+    {
+        m_start_time = now;
+    }
+
+    const auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - *m_start_time).count();
+    const std::size_t arrived = std::uint64_t(elapsed_us) * m_sample_rate / 1'000'000;
+
+    return std::min(arrived, total_samples());
+}
+
+SampleViews FileSampleSource::peek(std::size_t channel, std::size_t max_count)
+{
+    const std::size_t count = std::min(max_count, available());
+    return {m_channels[channel].subspan(m_cursor, count), {}};
+}
+
+std::size_t FileSampleSource::consume(std::size_t count)
+{
+    count = std::min(count, available());
+    m_cursor += count;
+    return count;
+}
+
+std::size_t FileSampleSource::discard(std::size_t count)
+{
+    count = consume(count);
+    m_overwritten += count;
+    return count;
+}
+
+std::size_t FileSampleSource::available() const
+{
+    return arrived_samples() - m_cursor;
+}
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/audio/pipesource.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace
+{
+// Short enough for the reader to notice a stop request quickly.
+constexpr int poll_interval_ms = 50;
+}
+
+PipeSampleSource::PipeSampleSource(PipeSourceParams params) :
+    m_params{std::move(params)},
+    m_queue{m_params.pcm.format, m_params.pcm.channel_count, m_params.block_samples * m_params.read_ahead_blocks},
+    m_is_stdin{m_params.path == "-"},
+    m_staging(m_params.block_samples * m_params.pcm.channel_count * sample_format_size(m_params.pcm.format))
+{
+    m_timeline.set_sample_rate(m_params.pcm.sample_rate);
+    open_input();
+    m_reader = std::thread{[this] { reader_loop(); }};
+}
+
+PipeSampleSource::~PipeSampleSource()
+{
+    {
+        // under the lock so that the reader cannot miss it between checking
+        // for queue space and going to sleep
+        std::lock_guard lk{m_space_mutex};
+        m_stop_requested.store(true, std::memory_order_relaxed);
+    }
+    m_space_cv.notify_one();
+    m_reader.join();
+
+    if (m_fd >= 0 && !m_is_stdin)
+    {
+        ::close(m_fd);
+    }
+}
+
+void PipeSampleSource::open_input()
+{
+    if (m_is_stdin)
+    {
+        m_fd = STDIN_FILENO;
+    }
+    else
+    {
+        if (m_fd >= 0)
+        {
+            ::close(m_fd);
+        }
+
+        // non-blocking so that opening a FIFO does not wait for a writer
+        m_fd = ::open(m_params.path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+        if (m_fd < 0)
+        {
+            throw std::runtime_error("Failed to open " + m_params.path + ": " + std::strerror(errno));
+        }
+    }
+
+    // the standard input is left blocking: its file description is shared
+    // with the parent shell, and reads only happen once poll reports data
+}
+
+void PipeSampleSource::reader_loop()
+{
+    apply_thread_schedule(m_params.reader_schedule, "pipe reader");
+
+    while (!m_stop_requested.load(std::memory_order_relaxed))
+    {
+        // don't read more than we can queue: leaving data in the pipe lets
+        // the writer know it should slow down
+        if (m_queue.free_space() < m_params.block_samples)
+        {
+            m_queue_full.fetch_add(1, std::memory_order_relaxed);
+
+            std::unique_lock lk{m_space_mutex};
+            m_space_cv.wait(lk, [&] {
+                return m_stop_requested.load(std::memory_order_relaxed)
+                    || m_queue.free_space() >= m_params.block_samples;
+            });
+            continue;
+        }
+
+        pollfd pfd{.fd = m_fd, .events = POLLIN, .revents = 0};
+        const int poll_result = ::poll(&pfd, 1, poll_interval_ms);
+
+        if (poll_result == 0)
+        {
+            m_stalls.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (poll_result < 0)
+        {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+
+        const std::size_t wanted = m_staging.size() - m_partial_bytes;
+        const ssize_t read_bytes = ::read(m_fd, m_staging.data() + m_partial_bytes, wanted);
+
+        if (read_bytes > 0)
+        {
+            if (std::size_t(read_bytes) < wanted)
+            {
+                m_short_reads.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            push_staged(m_partial_bytes + read_bytes);
+            continue;
+        }
+
+        if (read_bytes < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            continue;
+        }
+
+        // EOF or error: the writer went away
+        if (m_is_stdin || read_bytes < 0)
+        {
+            break;
+        }
+
+        // drop any incomplete frame, the next writer starts from scratch
+        m_partial_bytes = 0;
+
+        try
+        {
+            open_input();
+        }
+        catch (const std::runtime_error&)
+        {
+            break;
+        }
+
+        // avoid spinning if the FIFO keeps reporting a hangup
+        std::this_thread::sleep_for(std::chrono::milliseconds(poll_interval_ms));
+    }
+
+    m_end_of_stream.store(true, std::memory_order_release);
+}
+
+void PipeSampleSource::push_staged(std::size_t staged_bytes)
+{
+    const std::size_t sample_size = sample_format_size(m_queue.format());
+    const std::size_t frame_size = sample_size * m_queue.channel_count();
+    const std::size_t frame_count = staged_bytes / frame_size;
+    const std::size_t sample_count = frame_count * m_queue.channel_count();
+    const auto received_at = CaptureClock::now();
+
+    // the staging buffer comes from a std::vector<std::byte>, whose storage is
+    // suitably aligned for any fundamental type
+    std::size_t pushed = 0;
+    if (m_queue.format() == SampleFormat::S16)
+    {
+        pushed = m_queue.push_interleaved(std::span{reinterpret_cast<const std::int16_t*>(m_staging.data()), sample_count});
+    }
+    else
+    {
+        pushed = m_queue.push_interleaved(std::span{reinterpret_cast<const float*>(m_staging.data()), sample_count});
+    }
+
+    // the writer may have buffered for a while, so this is only an upper bound
+    // of how recent the samples are
+    m_timeline.stamp(pushed, received_at);
+
+    m_partial_bytes = staged_bytes - frame_count * frame_size;
+    std::memmove(m_staging.data(), m_staging.data() + frame_count * frame_size, m_partial_bytes);
+}
+
+void PipeSampleSource::notify_space()
+{
+    // taking the lock orders this with the reader's check of the free space,
+    // so the wakeup cannot be lost
+    {
+        std::lock_guard lk{m_space_mutex};
+    }
+    m_space_cv.notify_one();
+}
+
+SampleViews PipeSampleSource::peek(std::size_t channel, std::size_t max_count)
+{
+    return m_queue.peek(channel, max_count);
+}
+
+std::size_t PipeSampleSource::consume(std::size_t count)
+{
+    count = m_queue.pop(count);
+    m_timeline.advance(count);
+    notify_space();
+    return count;
+}
+
+std::size_t PipeSampleSource::discard(std::size_t count)
+{
+    count = m_queue.discard(count);
+    m_timeline.advance(count);
+    notify_space();
+    return count;
+}
+
+std::size_t PipeSampleSource::available() const
+{
+    return m_queue.size();
+}
+
+bool PipeSampleSource::exhausted() const
+{
+    return m_end_of_stream.load(std::memory_order_acquire) && m_queue.size() == 0;
+}
@@ -2,54 +2,480 @@
 // Copyright (C) 2023 sdelang
 #include <spiralviz/audio/recorder.hpp>
 
-SampleQueueRecorder::SampleQueueRecorder()
+#include <spiralviz/dsp/util.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+
+namespace
+{
+/// Copies `out.size()` samples starting at `offset` within `views`, as floats.
+void copy_view_range(const SampleViews& views, std::size_t offset, std::span<float> out)
 {
+    // the range may straddle both views
+    const std::size_t first_size = views.first.size();
+    std::size_t done = 0;
+
+    if (offset < first_size)
+    {
+        done = std::min(out.size(), first_size - offset);
+        copy_samples(views.first.subspan(offset, done), out.first(done));
+    }
+
+    if (done < out.size())
+    {
+        copy_samples(views.second.subspan(offset + done - first_size, out.size() - done), out.subspan(done));
+    }
+}
+}
+
+CaptureStream::CaptureStream(SampleFormat queue_format, std::size_t channel_count, std::size_t queue_capacity) :
+    m_queue{queue_format, channel_count, queue_capacity}
+{
+    setChannelCount(channel_count);
+
     // bleh, should just use portaudio for a callback-based method
     setProcessingInterval(sf::milliseconds(1));
 }
 
-bool SampleQueueRecorder::onProcessSamples(const sf::Int16* samples, std::size_t sampleCount)
+CaptureStream::~CaptureStream()
+{
+    // SFML requires derived recorders to stop the capture thread themselves
+    stop();
+}
+
+bool CaptureStream::onStart()
 {
-    std::lock_guard lk{m_stream_lock};
-    
-    const auto old_size = m_sample_stream.size();
-    m_sample_stream.resize(old_size + sampleCount);
+    // called before every capture thread gets launched, restarts included
+    m_schedule_applied = false;
+    m_stopped.store(false, std::memory_order_relaxed);
+    return true;
+}
 
-    for (std::size_t i = 0; i < sampleCount; ++i)
+void CaptureStream::onStop()
+{
+    // SFML calls this once the capture thread processed its last block
+    m_stopped.store(true, std::memory_order_release);
+}
+
+bool CaptureStream::onProcessSamples(const sf::Int16* samples, std::size_t sampleCount)
+{
+    const auto captured_at = CaptureClock::now();
+
+    if (!m_schedule_applied)
+    {
+        // SFML spawns the capture thread itself, so this is the earliest point
+        // where it can be reached
+        apply_thread_schedule(m_schedule, "capture");
+        m_schedule_applied = true;
+    }
+
+    // sampleCount accounts for all channels
+    const std::span<const std::int16_t> block{samples, sampleCount};
+    m_timeline.stamp(m_queue.push_interleaved(block), captured_at);
+
+    if (CaptureArchiver* archiver = m_archiver.load(std::memory_order_acquire))
     {
-        m_sample_stream[old_size + i] = samples[i] / 32768.0f;
+        archiver->push(block);
     }
 
     return true;
 }
 
-void SampleQueueRecorder::onStop()
+SampleQueueRecorder::SampleQueueRecorder(SampleFormat queue_format, std::size_t channel_count, std::size_t queue_capacity) :
+    m_format{queue_format},
+    m_channel_count{channel_count},
+    m_queue_capacity{queue_capacity},
+    m_active{make_stream()},
+    m_crossfade_f32(channel_count),
+    m_crossfade_s16(channel_count)
+{
+    m_device = m_active->getDevice();
+}
+
+SampleQueueRecorder::~SampleQueueRecorder()
+{
+    if (!m_opener.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lk{m_switch_lock};
+        m_stop_opener = true;
+    }
+
+    m_switch_cv.notify_one();
+    m_opener.join();
+}
+
+std::unique_ptr<CaptureStream> SampleQueueRecorder::make_stream() const
+{
+    auto stream = std::make_unique<CaptureStream>(m_format, m_channel_count, m_queue_capacity);
+    stream->set_schedule(m_capture_schedule);
+    return stream;
+}
+
+void SampleQueueRecorder::set_capture_schedule(const ThreadSchedule& schedule)
 {
-    std::lock_guard lk{m_stream_lock};
-    m_sample_stream.clear();
+    m_capture_schedule = schedule;
+    m_active->set_schedule(schedule);
 }
 
-std::size_t SampleQueueRecorder::consume_n_oldest(std::vector<float>& target, std::size_t desired)
+void SampleQueueRecorder::set_archiver(std::unique_ptr<CaptureArchiver> archiver)
 {
-    std::lock_guard lk{m_stream_lock};
+    m_archiver = std::move(archiver);
+    m_active->set_archiver(m_archiver.get());
+}
 
-    std::size_t target_new_size = std::min(desired, m_sample_stream.size());
-    target.assign(m_sample_stream.begin(), m_sample_stream.begin() + target_new_size);
-    m_sample_stream.erase(m_sample_stream.begin(), m_sample_stream.begin() + target_new_size);
-    return target_new_size;
+bool SampleQueueRecorder::start(std::size_t sample_rate)
+{
+    m_sample_rate = sample_rate;
+    m_active->timeline().set_sample_rate(sample_rate);
+    m_capturing = m_active.get();
+    return m_active->start(sample_rate);
 }
 
-std::size_t SampleQueueRecorder::num_available_samples() const
+void SampleQueueRecorder::switch_device(const std::string& device)
 {
-    std::lock_guard lk{m_stream_lock};
-    return m_sample_stream.size();
+    {
+        std::lock_guard lk{m_switch_lock};
+
+        m_open_request = device;
+        m_failed_device.clear();
+        m_switching.store(true, std::memory_order_release);
+
+        if (!m_opener.joinable())
+        {
+            m_opener = std::thread{[this] { opener_loop(); }};
+        }
+    }
+
+    m_switch_cv.notify_one();
 }
 
-void SampleQueueRecorder::discard_n_oldest(std::size_t count)
+std::string SampleQueueRecorder::failed_device() const
 {
-    std::lock_guard lk{m_stream_lock};
-    m_sample_stream.erase(
-        m_sample_stream.begin(),
-        m_sample_stream.begin() + std::min(count, m_sample_stream.size())
-    );
-}
\ No newline at end of file
+    std::lock_guard lk{m_switch_lock};
+    return m_failed_device;
+}
+
+std::string SampleQueueRecorder::device() const
+{
+    std::lock_guard lk{m_switch_lock};
+    return m_device;
+}
+
+void SampleQueueRecorder::opener_loop()
+{
+    for (;;)
+    {
+        std::string device;
+        CaptureStream* previous = nullptr;
+
+        {
+            std::unique_lock lk{m_switch_lock};
+            m_switch_cv.wait(lk, [&] { return m_stop_opener || m_open_request.has_value(); });
+
+            if (m_stop_opener)
+            {
+                return;
+            }
+
+            device = std::move(*m_open_request);
+            m_open_request.reset();
+            m_opening = true;
+            previous = m_capturing;
+        }
+
+        // SFML only allows a single capture at a time. Stopping joins the
+        // capture thread, while the consumer can keep reading what it queued.
+        if (previous != nullptr)
+        {
+            previous->stop();
+        }
+
+        // OpenAL opens the device synchronously, out of the lock so that the
+        // consumer and `switch_device` never wait on it
+        auto stream = make_stream();
+        stream->timeline().set_sample_rate(m_sample_rate);
+        const bool started = stream->setDevice(device) && stream->start(m_sample_rate);
+
+        if (!started && previous != nullptr)
+        {
+            // still owned by whoever held it, as only newer streams get
+            // destroyed
+            previous->start(m_sample_rate);
+        }
+
+        std::unique_ptr<CaptureStream> superseded;
+
+        {
+            std::lock_guard lk{m_switch_lock};
+            m_opening = false;
+
+            if (started)
+            {
+                // the previous stream, if it was not taken yet
+                superseded = std::move(m_opened);
+                m_opened = std::move(stream);
+                m_capturing = m_opened.get();
+                m_switch_changed.store(true, std::memory_order_release);
+            }
+            else
+            {
+                m_failed_device = device;
+            }
+
+            update_switching();
+        }
+    }
+}
+
+void SampleQueueRecorder::update_switching()
+{
+    const bool switching = m_open_request.has_value() || m_opening || m_opened != nullptr || m_cutover_pending;
+    m_switching.store(switching, std::memory_order_release);
+}
+
+void SampleQueueRecorder::update_switch()
+{
+    if (m_switch_changed.exchange(false, std::memory_order_acq_rel))
+    {
+        // stopped by the opener, see `m_switch_lock`
+        std::unique_ptr<CaptureStream> superseded;
+
+        {
+            std::lock_guard lk{m_switch_lock};
+
+            if (m_opened != nullptr)
+            {
+                superseded = std::move(m_pending);
+                m_pending = std::move(m_opened);
+                m_cutover_pending = true;
+            }
+        }
+    }
+
+    if (m_pending == nullptr || m_draining != nullptr)
+    {
+        return;
+    }
+
+    const std::size_t crossfade = ms_to_samples(m_switch_config.crossfade_ms, m_sample_rate);
+    const std::size_t warmup = ms_to_samples(m_switch_config.warmup_ms, m_sample_rate);
+
+    const std::size_t new_size = m_pending->queue().size();
+
+    if (new_size == 0 || new_size < std::max(crossfade, warmup))
+    {
+        return;
+    }
+
+    // the archiver takes blocks from a single capture thread, so the old one
+    // must be done pushing before the new one may. The opener stopped it
+    // before starting the new one, this only makes sure.
+    if (!m_active->is_stopped())
+    {
+        return;
+    }
+
+    m_active->set_archiver(nullptr);
+    m_pending->set_archiver(m_archiver.get());
+
+    // the old device stopped before the new one started, so the crossfade
+    // bridges the newest frames of both devices, older frames of the new
+    // device being dropped while it settles
+
+    const std::size_t settle_size = new_size - std::min(crossfade, new_size);
+    const std::size_t old_size = m_active->queue().size();
+    const std::size_t fade_size = std::min({crossfade, old_size, new_size - settle_size});
+
+    m_pending->queue().discard(settle_size);
+    m_pending->timeline().advance(settle_size);
+
+    std::vector<float> old_tail(fade_size), new_head(fade_size);
+
+    for (std::size_t channel = 0; channel < m_channel_count; ++channel)
+    {
+        copy_view_range(m_active->queue().peek(channel), old_size - fade_size, old_tail);
+        copy_view_range(m_pending->queue().peek(channel), 0, new_head);
+
+        auto& fade_f32 = m_crossfade_f32[channel];
+        fade_f32.resize(fade_size);
+
+        for (std::size_t i = 0; i < fade_size; ++i)
+        {
+            // equal-power, as both devices are unlikely to be correlated
+            const float t = (float(i) + 0.5f) / float(fade_size);
+            const float angle = t * std::numbers::pi_v<float> * 0.5f;
+            fade_f32[i] = old_tail[i] * std::cos(angle) + new_head[i] * std::sin(angle);
+        }
+
+        if (m_format == SampleFormat::S16)
+        {
+            auto& fade_s16 = m_crossfade_s16[channel];
+            fade_s16.resize(fade_size);
+            std::transform(fade_f32.begin(), fade_f32.end(), fade_s16.begin(), f32_to_s16);
+        }
+    }
+
+    m_pending->queue().pop(fade_size);
+    m_pending->timeline().advance(fade_size);
+
+    m_draining = std::move(m_active);
+    m_draining_remaining = old_size - fade_size;
+    m_active = std::move(m_pending);
+
+    {
+        std::lock_guard lk{m_switch_lock};
+        m_device = m_active->getDevice();
+        m_cutover_pending = false;
+        update_switching();
+    }
+
+    m_crossfade_offset = 0;
+    m_crossfade_size = fade_size;
+
+    if (m_draining_remaining == 0)
+    {
+        finish_draining();
+    }
+}
+
+void SampleQueueRecorder::finish_draining()
+{
+    m_retired_dropped += m_draining->queue().dropped_count();
+    m_retired_overwritten += m_draining->queue().overwritten_count();
+
+    // stopped by the opener before the cut-over
+    m_draining.reset();
+}
+
+SampleViews SampleQueueRecorder::peek(std::size_t channel, std::size_t max_count)
+{
+    // only for the first channel, so that all channels get peeked from the
+    // same segment
+    if (channel == 0)
+    {
+        update_switch();
+    }
+
+    if (m_draining != nullptr)
+    {
+        return m_draining->queue().peek(channel, std::min(max_count, m_draining_remaining));
+    }
+
+    if (m_crossfade_offset < m_crossfade_size)
+    {
+        const std::size_t count = std::min(max_count, m_crossfade_size - m_crossfade_offset);
+
+        SampleViews views;
+        if (m_format == SampleFormat::S16)
+        {
+            views.first = std::span<const std::int16_t>{m_crossfade_s16[channel]}.subspan(m_crossfade_offset, count);
+        }
+        else
+        {
+            views.first = std::span<const float>{m_crossfade_f32[channel]}.subspan(m_crossfade_offset, count);
+        }
+        return views;
+    }
+
+    return m_active->queue().peek(channel, max_count);
+}
+
+std::size_t SampleQueueRecorder::release(std::size_t count, bool discard)
+{
+    std::size_t released = 0;
+
+    const auto release_from = [&](CaptureStream& stream, std::size_t frames) {
+        auto& queue = stream.queue();
+        const std::size_t done = discard ? queue.discard(frames) : queue.pop(frames);
+
+        stream.timeline().advance(done);
+        m_last_capture_time = stream.timeline().last_consumed_time();
+        return done;
+    };
+
+    if (m_draining != nullptr)
+    {
+        const std::size_t done = release_from(*m_draining, std::min(count, m_draining_remaining));
+
+        m_draining_remaining -= done;
+        released += done;
+        count -= done;
+
+        if (m_draining_remaining != 0)
+        {
+            return released;
+        }
+
+        finish_draining();
+    }
+
+    if (m_crossfade_offset < m_crossfade_size)
+    {
+        const std::size_t n = std::min(count, m_crossfade_size - m_crossfade_offset);
+
+        m_crossfade_offset += n;
+        released += n;
+        count -= n;
+
+        // the crossfade ends with the newest frames the new device had
+        // captured at the time of the cut-over
+        if (const auto cutover_time = m_active->timeline().last_consumed_time())
+        {
+            const std::size_t frames_left = m_crossfade_size - m_crossfade_offset;
+            m_last_capture_time = *cutover_time - std::chrono::duration_cast<CaptureClock::duration>(
+                std::chrono::duration<double>(double(frames_left) / m_sample_rate)
+            );
+        }
+
+        if (m_crossfade_offset < m_crossfade_size)
+        {
+            return released;
+        }
+    }
+
+    if (count != 0)
+    {
+        released += release_from(*m_active, count);
+    }
+
+    return released;
+}
+
+std::size_t SampleQueueRecorder::consume(std::size_t count)
+{
+    return release(count, false);
+}
+
+std::size_t SampleQueueRecorder::discard(std::size_t count)
+{
+    update_switch();
+    return release(count, true);
+}
+
+std::size_t SampleQueueRecorder::available() const
+{
+    return m_draining_remaining
+        + (m_crossfade_size - m_crossfade_offset)
+        + m_active->queue().size();
+}
+
+std::uint64_t SampleQueueRecorder::dropped_samples() const
+{
+    return m_retired_dropped
+        + m_active->queue().dropped_count()
+        + (m_draining != nullptr ? m_draining->queue().dropped_count() : 0);
+}
+
+std::uint64_t SampleQueueRecorder::overwritten_samples() const
+{
+    return m_retired_overwritten
+        + m_active->queue().overwritten_count()
+        + (m_draining != nullptr ? m_draining->queue().overwritten_count() : 0);
+}
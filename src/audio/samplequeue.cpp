@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/audio/samplequeue.hpp>
+
+SampleQueue::SampleQueue(SampleFormat format, std::size_t capacity) :
+    m_format{format},
+    m_ring{[&]() -> decltype(m_ring) {
+        if (format == SampleFormat::S16)
+        {
+            return decltype(m_ring){std::in_place_index<1>, capacity};
+        }
+        return decltype(m_ring){std::in_place_index<0>, capacity};
+    }()}
+{}
+
+std::size_t SampleQueue::push(SampleSpan samples)
+{
+    return std::visit([&](auto& ring) {
+        const auto views = ring.prepare_write(samples.size());
+        copy_samples(samples.first(views.first.size()), views.first);
+        copy_samples(samples.subspan(views.first.size(), views.second.size()), views.second);
+        ring.commit_write(views.size());
+        return views.size();
+    }, m_ring);
+}
+
+std::size_t SampleQueue::free_space() const
+{
+    return capacity() - size();
+}
+
+SampleViews SampleQueue::peek(std::size_t max_count) const
+{
+    return std::visit([&](const auto& ring) -> SampleViews {
+        const auto views = ring.peek(max_count);
+        return {views.first, views.second};
+    }, m_ring);
+}
+
+std::size_t SampleQueue::pop(std::size_t count)
+{
+    return std::visit([&](auto& ring) { return ring.pop(count); }, m_ring);
+}
+
+std::size_t SampleQueue::discard(std::size_t count)
+{
+    return std::visit([&](auto& ring) { return ring.discard(count); }, m_ring);
+}
+
+void SampleQueue::clear()
+{
+    std::visit([&](auto& ring) { ring.clear(); }, m_ring);
+}
+
+std::size_t SampleQueue::size() const
+{
+    return std::visit([&](const auto& ring) { return ring.size(); }, m_ring);
+}
+
+std::size_t SampleQueue::capacity() const
+{
+    return std::visit([&](const auto& ring) { return ring.capacity(); }, m_ring);
+}
+
+std::uint64_t SampleQueue::total_written() const
+{
+    return std::visit([&](const auto& ring) { return ring.total_written(); }, m_ring);
+}
+
+std::uint64_t SampleQueue::dropped_count() const
+{
+    return std::visit([&](const auto& ring) { return ring.dropped_count(); }, m_ring);
+}
+
+std::uint64_t SampleQueue::overwritten_count() const
+{
+    return std::visit([&](const auto& ring) { return ring.overwritten_count(); }, m_ring);
+}
+
+MultiChannelQueue::MultiChannelQueue(SampleFormat format, std::size_t channel_count, std::size_t capacity)
+{
+    assert(channel_count > 0);
+
+    for (std::size_t i = 0; i < channel_count; ++i)
+    {
+        m_channels.push_back(std::make_unique<SampleQueue>(format, capacity));
+    }
+}
+
+template<class T>
+std::size_t MultiChannelQueue::push_frames(std::span<const T> interleaved)
+{
+    const std::size_t frame_count = interleaved.size() / channel_count();
+    const std::size_t pushed = std::min(frame_count, free_space());
+
+    for (std::size_t channel = 0; channel < channel_count(); ++channel)
+    {
+        m_channels[channel]->push(SampleSpan::interleaved(interleaved.data() + channel, pushed, channel_count()));
+    }
+
+    if (pushed < frame_count)
+    {
+        m_dropped.fetch_add(frame_count - pushed, std::memory_order_relaxed);
+    }
+
+    return pushed;
+}
+
+std::size_t MultiChannelQueue::push_interleaved(std::span<const std::int16_t> interleaved)
+{
+    return push_frames(interleaved);
+}
+
+std::size_t MultiChannelQueue::push_interleaved(std::span<const float> interleaved)
+{
+    return push_frames(interleaved);
+}
+
+SampleViews MultiChannelQueue::peek(std::size_t channel, std::size_t max_count) const
+{
+    // other channels might be lagging behind if the producer is mid-push
+    return m_channels[channel]->peek(std::min(max_count, size()));
+}
+
+std::size_t MultiChannelQueue::pop(std::size_t count)
+{
+    count = std::min(count, size());
+
+    for (auto& channel : m_channels)
+    {
+        channel->pop(count);
+    }
+
+    return count;
+}
+
+std::size_t MultiChannelQueue::discard(std::size_t count)
+{
+    count = std::min(count, size());
+
+    for (auto& channel : m_channels)
+    {
+        channel->discard(count);
+    }
+
+    return count;
+}
+
+void MultiChannelQueue::clear()
+{
+    pop(size());
+}
+
+std::size_t MultiChannelQueue::size() const
+{
+    std::size_t ret = std::numeric_limits<std::size_t>::max();
+
+    for (const auto& channel : m_channels)
+    {
+        ret = std::min(ret, channel->size());
+    }
+
+    return ret;
+}
+
+std::size_t MultiChannelQueue::free_space() const
+{
+    std::size_t ret = std::numeric_limits<std::size_t>::max();
+
+    for (const auto& channel : m_channels)
+    {
+        ret = std::min(ret, channel->free_space());
+    }
+
+    return ret;
+}
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/audio/samples.hpp>
+
+namespace
+{
+template<class To, class From>
+To convert_sample(From sample)
+{
+    if constexpr (std::is_same_v<To, From>)
+    {
+        return sample;
+    }
+    else if constexpr (std::is_same_v<To, float>)
+    {
+        return s16_to_f32(sample);
+    }
+    else
+    {
+        return f32_to_s16(sample);
+    }
+}
+
+template<class From, class To>
+void copy_converted(SampleSpan source, std::span<To> target)
+{
+    assert(source.size() == target.size());
+
+    const From* samples = static_cast<const From*>(source.data());
+
+    if (source.contiguous())
+    {
+        std::transform(samples, samples + source.size(), target.begin(), convert_sample<To, From>);
+        return;
+    }
+
+    for (std::size_t i = 0; i < target.size(); ++i)
+    {
+        target[i] = convert_sample<To, From>(samples[i * source.stride()]);
+    }
+}
+
+template<class To>
+void copy_any(SampleSpan source, std::span<To> target)
+{
+    if (source.format() == SampleFormat::S16)
+    {
+        copy_converted<std::int16_t>(source, target);
+    }
+    else
+    {
+        copy_converted<float>(source, target);
+    }
+}
+}
+
+void copy_samples(SampleSpan source, std::span<float> target)
+{
+    copy_any(source, target);
+}
+
+void copy_samples(SampleSpan source, std::span<std::int16_t> target)
+{
+    copy_any(source, target);
+}
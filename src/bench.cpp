@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/bench.hpp>
+
+#include <spiralviz/dsp/kernels.hpp>
+#include <spiralviz/dsp/windowfuncs.hpp>
+#include <spiralviz/fftstreamer.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+/// Average wall time of `fn` in microseconds, over enough runs to smooth out
+/// the timer resolution.
+template<class Func>
+double time_us(Func&& fn)
+{
+    using clock = std::chrono::steady_clock;
+
+    // warms up the caches
+    fn();
+
+    std::size_t runs = 0;
+    const auto start = clock::now();
+    clock::duration elapsed{};
+
+    do
+    {
+        fn();
+        ++runs;
+        elapsed = clock::now() - start;
+    } while (runs < 10 || elapsed < std::chrono::milliseconds(100));
+
+    return std::chrono::duration<double, std::micro>(elapsed).count() / runs;
+}
+}
+
+int run_benchmark(const Options& options)
+{
+    Options bench_options = options;
+    bench_options.pacing = PlaybackPacing::AS_FAST_AS_POSSIBLE;
+
+    FFTStreamer streamer{make_sample_source(bench_options), options.window, options.resampling, options.planning};
+    streamer.set_analyze_all_channels(true);
+    streamer.set_engine(options.engine);
+
+    // the main thread drives the analysis here
+    apply_thread_schedule(options.realtime.analysis, "analysis");
+    streamer.apply_worker_schedule(options.realtime.analysis);
+
+    if (options.realtime.lock_memory)
+    {
+        lock_process_memory();
+    }
+
+    const std::size_t sample_rate = streamer.source().sample_rate();
+    const std::size_t hop = options.benchmark_hop != 0 ? options.benchmark_hop : options.hop_size;
+
+    // in batch mode, every update catches up on a whole batch of hops, as
+    // after a stall. Timings are still given per hop
+    const std::size_t hops_per_update = std::max<std::size_t>(options.batch_hops, 1);
+    const std::size_t step = hop * hops_per_update;
+    streamer.set_hop_size(hop);
+    streamer.set_batch_hops(options.batch_hops);
+
+    using clock = std::chrono::steady_clock;
+
+    std::size_t hop_count = 0;
+    std::size_t spectrum_count = 0;
+    std::size_t sample_count = 0;
+    clock::duration worst_hop{};
+
+    const auto start = clock::now();
+
+    while (!streamer.source().exhausted())
+    {
+        sample_count += std::min(step, streamer.source().available());
+
+        const auto hop_start = clock::now();
+        if (!streamer.update_fft(step).empty())
+        {
+            spectrum_count += streamer.hop_magnitudes().size();
+        }
+        worst_hop = std::max<clock::duration>(worst_hop, (clock::now() - hop_start) / hops_per_update);
+
+        hop_count += hops_per_update;
+    }
+
+    const double elapsed_s = std::chrono::duration<double>(clock::now() - start).count();
+    const double audio_s = double(sample_count) / sample_rate;
+
+    std::printf(
+        "%zu hops of %zu samples (N=%zu at %zu Hz, %zu channels) over %.1fs of audio\n"
+        "total:    %.3fs (%.1fx real time)\n"
+        "per hop:  %.1fus average, %.1fus worst\n",
+        hop_count,
+        hop,
+        streamer.config().window_size_samples,
+        streamer.analysis_rate(),
+        streamer.channel_count(),
+        audio_s,
+        elapsed_s,
+        audio_s / elapsed_s,
+        elapsed_s * 1.0e6 / std::max<std::size_t>(hop_count, 1),
+        std::chrono::duration<double, std::micro>(worst_hop).count()
+    );
+
+    if (const MultiResolutionSpectrum* multires = streamer.multiresolution())
+    {
+        std::printf(
+            "engine:   %zu bands of N=%zu, %.2f FFTs per hop and channel\n",
+            multires->bands().size(),
+            multires->config().band_window_size,
+            double(multires->transform_count()) / std::max<std::size_t>(hop_count, 1)
+        );
+    }
+
+    if (const SlidingDFT* sdft = streamer.sliding_dft())
+    {
+        std::printf(
+            "engine:   sliding DFT of %zu bins over N=%zu\n",
+            sdft->tracked_bin_count(),
+            sdft->window_size()
+        );
+    }
+
+    const FFTPlan& plan = streamer.plan();
+    std::printf(
+        "plan:     %s (%s, %.1fms to plan), %.1fus per FFT, up to %zu threads\n",
+        get_plan_rigor_string(plan.rigor()),
+        plan.is_from_wisdom() ? "wisdom" : "fresh",
+        std::chrono::duration<double, std::milli>(plan.planning_time()).count(),
+        plan.mean_execute_us(),
+        plan.thread_count()
+    );
+
+    if (const FFTPlan* replaced = streamer.replaced_plan())
+    {
+        std::printf(
+            "replaced: %s plan, %.1fus per FFT\n",
+            get_plan_rigor_string(replaced->rigor()),
+            replaced->mean_execute_us()
+        );
+    }
+
+    if (const FFTPlan* batch = streamer.batch_plan())
+    {
+        std::printf(
+            "batches:  %zu spectra in updates of %zu hops; %s plan, %.1fus per batch of %zu FFTs\n",
+            spectrum_count,
+            hops_per_update,
+            get_plan_rigor_string(batch->rigor()),
+            batch->mean_execute_us(),
+            batch->batch_count()
+        );
+    }
+
+    for (const RealtimeReportEntry& entry : realtime_report())
+    {
+        std::printf(
+            "%s: %s %s%s%s\n",
+            entry.thread.c_str(),
+            entry.setting.c_str(),
+            entry.applied ? "applied" : "failed",
+            entry.detail.empty() ? "" : ", ",
+            entry.detail.c_str()
+        );
+    }
+
+    return 0;
+}
+
+int run_kernel_benchmark(const Options& options)
+{
+    const KernelISA default_isa = active_kernel_isa();
+    const std::size_t hop = options.benchmark_hop != 0 ? options.benchmark_hop : options.hop_size;
+
+    // loads wisdom, so that plans match those of the actual analysis
+    const FFTPlanner planner{options.planning};
+
+    std::printf(
+        "%s input, hops of %zu samples, default kernels: %s\n"
+        "%8s  %-8s %12s %12s %12s %12s\n",
+        options.queue_format == SampleFormat::S16 ? "S16" : "F32",
+        hop,
+        get_kernel_isa_string(default_isa),
+        "N", "kernels", "window (us)", "magn. (us)", "log16 (us)", "hop (us)"
+    );
+
+    std::minstd_rand rng;
+    std::uniform_int_distribution<int> noise{-32768, 32767};
+
+    for (std::size_t size = 4096; size <= 131072; size *= 2)
+    {
+        auto window = std::make_shared<std::vector<float>>(size);
+        populate_blackman_harris_factors(*window, default_hl_config.symmetry_skew_factor);
+
+        // built right away at the configured rigor, where the planner would
+        // hand out an estimated plan until the measured one is ready
+        const auto plan = std::make_shared<const FFTPlan>(size, options.planning.rigor);
+
+        // white noise, so that nothing takes a shortcut on silence
+        std::vector<std::int16_t> samples_s16(size);
+        std::vector<float> samples_f32(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            samples_s16[i] = std::int16_t(noise(rng));
+            samples_f32[i] = samples_s16[i] * s16_sample_scale;
+        }
+
+        const SampleSpan hop_samples = options.queue_format == SampleFormat::S16
+            ? SampleSpan{std::span<const std::int16_t>{samples_s16}.first(std::min(hop, size))}
+            : SampleSpan{std::span<const float>{samples_f32}.first(std::min(hop, size))};
+
+        std::vector<float> windowed(size);
+        std::vector<float> magnitudes(size / 2 - 1);
+        std::vector<std::uint16_t> levels(magnitudes.size());
+
+        for (KernelISA isa : {KernelISA::SCALAR, KernelISA::SSE2, KernelISA::AVX2, KernelISA::AVX512})
+        {
+            if (!is_kernel_isa_supported(isa))
+            {
+                continue;
+            }
+
+            set_kernel_isa(isa);
+
+            const double window_us = time_us([&] {
+                if (options.queue_format == SampleFormat::S16)
+                {
+                    window_multiply_s16(windowed, *window, samples_s16, s16_sample_scale);
+                }
+                else
+                {
+                    window_multiply(windowed, *window, samples_f32);
+                }
+            });
+
+            // the windowed noise stands in for a spectrum
+            const SplitComplexSpan spectrum{
+                .real = std::span<const float>{windowed}.first(magnitudes.size()),
+                .imag = std::span<const float>{windowed}.last(magnitudes.size())
+            };
+
+            const double magnitudes_us = time_us([&] {
+                complex_magnitudes(magnitudes, spectrum, 1.0f);
+            });
+
+            // as encoded by `EncodedSpectrum`, the scale does not matter
+            const double log16_us = time_us([&] {
+                quantize_log2(levels, magnitudes, 1000.0f, 32768.0f);
+            });
+
+            WindowedFFT fft{FFTConfig{.window_size_samples = size, .window_factors = window}, options.queue_format, plan};
+
+            const double hop_us = time_us([&] {
+                fft.push_samples(hop_samples);
+                fft.compute();
+            });
+
+            std::printf(
+                "%8zu  %-8s %12.2f %12.2f %12.2f %12.2f\n",
+                size,
+                get_kernel_isa_string(isa),
+                window_us,
+                magnitudes_us,
+                log16_us,
+                hop_us
+            );
+        }
+    }
+
+    std::printf("log16: magnitudes to 16-bit dB levels\n");
+    std::printf("hop: push, window, %s FFT and magnitudes\n", get_plan_rigor_string(options.planning.rigor));
+
+    set_kernel_isa(default_isa);
+
+    // the sliding DFT costs as much per sample as the bins it tracks, the FFT
+    // as much per hop as the window size takes: short hops favor the former
+    constexpr std::size_t sdft_rate = 48000;
+    const SlidingDFTConfig sdft_config;
+
+    std::printf(
+        "\nsliding DFT vs FFT at %zu Hz, %s window, per hop\n"
+        "%8s %8s %8s %12s %12s\n",
+        sdft_rate,
+        get_window_type_string(default_hl_config.type),
+        "N", "hop", "bins", "sdft (us)", "fft (us)"
+    );
+
+    for (std::size_t size = 4096; size <= 131072; size *= 2)
+    {
+        auto window = std::make_shared<std::vector<float>>(size);
+        populate_blackman_harris_factors(*window, default_hl_config.symmetry_skew_factor);
+
+        const auto plan = std::make_shared<const FFTPlan>(size, options.planning.rigor);
+        WindowedFFT fft{FFTConfig{.window_size_samples = size, .window_factors = window}, SampleFormat::F32, plan};
+        SlidingDFT sdft{sdft_rate, size, default_hl_config.type, sdft_config};
+
+        std::vector<float> samples(2048);
+        for (float& sample : samples)
+        {
+            sample = noise(rng) * s16_sample_scale;
+        }
+
+        for (std::size_t sdft_hop : {32, 128, 512, 2048})
+        {
+            const SampleSpan hop_samples{std::span<const float>{samples}.first(sdft_hop)};
+
+            const double sdft_us = time_us([&] {
+                sdft.push_samples(hop_samples);
+                sdft.compute(sdft_hop);
+            });
+
+            const double fft_us = time_us([&] {
+                fft.push_samples(hop_samples);
+                fft.compute();
+            });
+
+            std::printf(
+                "%8zu %8zu %8zu %12.2f %12.2f%s\n",
+                size,
+                sdft_hop,
+                sdft.tracked_bin_count(),
+                sdft_us,
+                fft_us,
+                sdft_us < fft_us ? "  sdft" : ""
+            );
+        }
+    }
+
+    std::printf(
+        "sdft: %.1f - %.1f Hz at %.0f cents per bin, marked where faster\n",
+        sdft_config.min_frequency,
+        sdft_config.max_frequency,
+        sdft_config.cents_per_bin
+    );
+
+    return 0;
+}
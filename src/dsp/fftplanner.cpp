@@ -0,0 +1,459 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/dsp/fftplanner.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+
+namespace
+{
+/// Identifies the CPU model and features, which is what wisdom depends on.
+std::string cpu_key()
+{
+    std::ifstream cpuinfo{"/proc/cpuinfo"};
+    std::string line, model, flags;
+
+    while ((model.empty() || flags.empty()) && std::getline(cpuinfo, line))
+    {
+        if (model.empty() && line.starts_with("model name"))
+        {
+            model = line;
+        }
+        else if (flags.empty() && line.starts_with("flags"))
+        {
+            flags = line;
+        }
+    }
+
+    // FNV-1a, as std::hash is not guaranteed to be stable across builds
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (char c : model + flags)
+    {
+        hash ^= std::uint8_t(c);
+        hash *= 0x100000001b3;
+    }
+
+    char ret[17];
+    std::snprintf(ret, sizeof(ret), "%016llx", static_cast<unsigned long long>(hash));
+    return ret;
+}
+
+std::string default_wisdom_path()
+{
+    const char* cache_home = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+
+    std::filesystem::path dir;
+    if (cache_home != nullptr && *cache_home != '\0')
+    {
+        dir = cache_home;
+    }
+    else if (home != nullptr && *home != '\0')
+    {
+        dir = std::filesystem::path{home} / ".cache";
+    }
+    else
+    {
+        dir = std::filesystem::temp_directory_path();
+    }
+
+    return (dir / "spiralviz" / ("fftwf-wisdom-" + cpu_key())).string();
+}
+
+/// Thread count the plan will actually get, see `FFTPlan`, so that upgrades
+/// are found under the same parameters as the plans they replace.
+std::size_t usable_thread_count(std::size_t thread_count)
+{
+    return fftw_has_threads() ? std::max<std::size_t>(thread_count, 1) : 1;
+}
+}
+
+FFTPlanner::FFTPlanner(PlanningConfig config) :
+    m_config{std::move(config)}
+{
+    // the threads library must be set up before planning anything
+    fftw_has_threads();
+
+    if (m_config.use_wisdom)
+    {
+        m_wisdom_path = m_config.wisdom_path.empty() ? default_wisdom_path() : m_config.wisdom_path;
+
+        std::lock_guard lk{fftw_planner_mutex()};
+        m_wisdom_loaded = fftwf_import_wisdom_from_filename(m_wisdom_path.c_str()) != 0;
+    }
+
+    m_thread = std::thread{[this] { planner_loop(); }};
+}
+
+FFTPlanner::~FFTPlanner()
+{
+    {
+        std::lock_guard lk{m_lock};
+        m_stop = true;
+    }
+
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+std::shared_ptr<const FFTPlan> FFTPlanner::plan(std::size_t size, std::size_t batch_count, std::size_t thread_count)
+{
+    thread_count = usable_thread_count(thread_count);
+
+    if (m_config.rigor == PlanRigor::ESTIMATE)
+    {
+        return std::make_shared<const FFTPlan>(size, PlanRigor::ESTIMATE, batch_count, thread_count);
+    }
+
+    if (auto plan = FFTPlan::from_wisdom(size, m_config.rigor, batch_count, thread_count))
+    {
+        return plan;
+    }
+
+    {
+        const PlanShape shape{size, batch_count, thread_count};
+
+        std::lock_guard lk{m_lock};
+        if (std::find(m_queued_shapes.begin(), m_queued_shapes.end(), shape) == m_queued_shapes.end())
+        {
+            m_queued_shapes.push_back(shape);
+        }
+    }
+
+    m_cv.notify_one();
+
+    // may still have to wait for the background thread to be done with the
+    // FFTW planner, if it is measuring another size
+    return std::make_shared<const FFTPlan>(size, PlanRigor::ESTIMATE, batch_count, thread_count);
+}
+
+std::shared_ptr<const FFTPlan> FFTPlanner::take_upgrade(
+    std::size_t size,
+    std::size_t batch_count,
+    std::size_t thread_count)
+{
+    const PlanShape shape{size, batch_count, usable_thread_count(thread_count)};
+
+    std::lock_guard lk{m_lock};
+
+    const auto it = m_upgrades.find(shape);
+    if (it == m_upgrades.end())
+    {
+        return nullptr;
+    }
+
+    auto ret = std::move(it->second);
+    m_upgrades.erase(it);
+    std::erase_if(m_slot_upgrades, [&](const auto& owned) { return owned.second == shape; });
+    return ret;
+}
+
+std::shared_ptr<const FFTPlan> FFTPlanner::take_upgrade(const FFTPlan& current)
+{
+    return take_upgrade(current.size(), current.batch_count(), current.thread_count());
+}
+
+std::shared_ptr<const FFTPlan> FFTPlanner::request(
+    PlanSlot slot,
+    std::size_t size,
+    std::size_t batch_count,
+    std::size_t thread_count)
+{
+    const PlanShape shape{size, batch_count, usable_thread_count(thread_count)};
+    const RequestKey key{slot, shape};
+    const auto superseded = [&](const RequestKey& other) {
+        return other.first == slot && other != key;
+    };
+
+    std::shared_ptr<const FFTPlan> ret;
+
+    {
+        std::lock_guard lk{m_lock};
+
+        if (const auto it = m_upgrades.find(shape); it != m_upgrades.end())
+        {
+            ret = std::move(it->second);
+            m_upgrades.erase(it);
+            own_upgrade(slot, shape, ret->rigor());
+            return ret;
+        }
+
+        if (const auto it = m_requested.find(key); it != m_requested.end())
+        {
+            ret = std::move(it->second);
+            m_requested.erase(it);
+            own_upgrade(slot, shape, ret->rigor());
+        }
+        else if (const auto it = m_failed.find(key); it != m_failed.end())
+        {
+            const std::string error = std::move(it->second);
+            m_failed.erase(it);
+            throw std::runtime_error{error};
+        }
+        else if (std::find(m_requested_shapes.begin(), m_requested_shapes.end(), key) == m_requested_shapes.end())
+        {
+            std::erase_if(m_requested_shapes, superseded);
+            std::erase_if(m_failed, [&](const auto& failure) { return superseded(failure.first); });
+
+            for (auto it = m_requested.begin(); it != m_requested.end();)
+            {
+                if (!superseded(it->first))
+                {
+                    ++it;
+                    continue;
+                }
+
+                m_retired.push_back(std::move(it->second));
+                it = m_requested.erase(it);
+            }
+
+            // the plan in use may still get its upgrade, see `keep_upgrading`
+            drop_upgrade(slot);
+
+            m_requested_shapes.push_back(key);
+        }
+    }
+
+    m_cv.notify_one();
+    return ret;
+}
+
+void FFTPlanner::keep_upgrading(PlanSlot slot, const FFTPlan& plan)
+{
+    {
+        std::lock_guard lk{m_lock};
+        own_upgrade(slot, PlanShape{plan.size(), plan.batch_count(), plan.thread_count()}, plan.rigor());
+    }
+
+    m_cv.notify_one();
+}
+
+void FFTPlanner::own_upgrade(PlanSlot slot, const PlanShape& shape, PlanRigor rigor)
+{
+    if (const auto it = m_slot_upgrades.find(slot); it != m_slot_upgrades.end() && it->second != shape)
+    {
+        drop_upgrade(slot);
+    }
+
+    if (rigor == m_config.rigor)
+    {
+        m_slot_upgrades.erase(slot);
+        return;
+    }
+
+    m_slot_upgrades[slot] = shape;
+
+    if (m_building == shape)
+    {
+        m_building_dropped = false;
+        return;
+    }
+
+    const bool queued = std::find(m_queued_shapes.begin(), m_queued_shapes.end(), shape) != m_queued_shapes.end();
+    if (!queued && !m_upgrades.contains(shape))
+    {
+        m_queued_shapes.push_back(shape);
+    }
+}
+
+void FFTPlanner::drop_upgrade(PlanSlot slot)
+{
+    const auto it = m_slot_upgrades.find(slot);
+    if (it == m_slot_upgrades.end())
+    {
+        return;
+    }
+
+    const PlanShape shape = it->second;
+    m_slot_upgrades.erase(it);
+
+    // e.g. two slots got handed plans of the same shape
+    const bool still_wanted = std::any_of(m_slot_upgrades.begin(), m_slot_upgrades.end(), [&](const auto& owned) {
+        return owned.second == shape;
+    });
+
+    if (still_wanted)
+    {
+        return;
+    }
+
+    std::erase(m_queued_shapes, shape);
+
+    if (const auto upgrade = m_upgrades.find(shape); upgrade != m_upgrades.end())
+    {
+        m_retired.push_back(std::move(upgrade->second));
+        m_upgrades.erase(upgrade);
+    }
+
+    // can't be interrupted, but won't be kept either
+    if (m_building == shape)
+    {
+        m_building_dropped = true;
+    }
+}
+
+std::shared_ptr<const FFTPlan> FFTPlanner::build_requested(const PlanShape& shape)
+{
+    const auto [size, batch_count, thread_count] = shape;
+
+    if (m_config.rigor != PlanRigor::ESTIMATE)
+    {
+        if (auto plan = FFTPlan::from_wisdom(size, m_config.rigor, batch_count, thread_count))
+        {
+            return plan;
+        }
+    }
+
+    return std::make_shared<const FFTPlan>(size, PlanRigor::ESTIMATE, batch_count, thread_count);
+}
+
+void FFTPlanner::retire(std::shared_ptr<const FFTPlan> plan)
+{
+    if (plan == nullptr)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lk{m_lock};
+        m_retired.push_back(std::move(plan));
+    }
+
+    m_cv.notify_one();
+}
+
+bool FFTPlanner::is_planning() const
+{
+    std::lock_guard lk{m_lock};
+    return m_planning || !m_queued_shapes.empty() || !m_requested_shapes.empty();
+}
+
+void FFTPlanner::planner_loop()
+{
+    for (;;)
+    {
+        std::vector<std::shared_ptr<const FFTPlan>> releasing;
+        std::optional<RequestKey> requested;
+        std::optional<PlanShape> shape;
+
+        {
+            std::unique_lock lk{m_lock};
+            m_cv.wait(lk, [&] {
+                return m_stop || !m_requested_shapes.empty() || !m_queued_shapes.empty() || !m_retired.empty();
+            });
+
+            if (m_stop)
+            {
+                return;
+            }
+
+            releasing.swap(m_retired);
+
+            if (!m_requested_shapes.empty())
+            {
+                requested = m_requested_shapes.front();
+                m_requested_shapes.erase(m_requested_shapes.begin());
+                m_planning = true;
+            }
+            else if (!m_queued_shapes.empty())
+            {
+                shape = m_queued_shapes.front();
+                m_queued_shapes.erase(m_queued_shapes.begin());
+                m_building = shape;
+                m_building_dropped = false;
+                m_planning = true;
+            }
+        }
+
+        // destroys the plans nobody else holds anymore, out of the lock
+        releasing.clear();
+
+        if (requested)
+        {
+            std::shared_ptr<const FFTPlan> plan;
+            std::string error;
+
+            try
+            {
+                plan = build_requested(requested->second);
+            }
+            catch (const std::runtime_error& e)
+            {
+                error = e.what();
+            }
+
+            std::lock_guard lk{m_lock};
+
+            // dropped if another request superseded it while building
+            const auto superseded = [&](const RequestKey& other) {
+                return other.first == requested->first && other != *requested;
+            };
+            const bool is_superseded = std::any_of(m_requested_shapes.begin(), m_requested_shapes.end(), superseded);
+
+            if (is_superseded)
+            {
+                if (plan != nullptr)
+                {
+                    m_retired.push_back(std::move(plan));
+                }
+            }
+            else if (plan != nullptr)
+            {
+                m_requested[*requested] = std::move(plan);
+            }
+            else
+            {
+                // reported by the next `request` for it
+                m_failed[*requested] = std::move(error);
+            }
+
+            m_planning = false;
+            continue;
+        }
+
+        if (!shape)
+        {
+            continue;
+        }
+
+        std::shared_ptr<const FFTPlan> plan;
+
+        try
+        {
+            const auto [size, batch_count, thread_count] = *shape;
+            plan = std::make_shared<const FFTPlan>(size, m_config.rigor, batch_count, thread_count);
+        }
+        catch (const std::runtime_error&)
+        {
+            // keep going with the ESTIMATE plan
+        }
+
+        if (plan != nullptr && !plan->is_from_wisdom() && m_config.use_wisdom)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(std::filesystem::path{m_wisdom_path}.parent_path(), error);
+
+            std::lock_guard lk{fftw_planner_mutex()};
+            fftwf_export_wisdom_to_filename(m_wisdom_path.c_str());
+        }
+
+        std::lock_guard lk{m_lock};
+        if (plan != nullptr && m_building_dropped)
+        {
+            m_retired.push_back(std::move(plan));
+        }
+        else if (plan != nullptr)
+        {
+            m_upgrades[*shape] = std::move(plan);
+        }
+        m_building.reset();
+        m_planning = false;
+    }
+}
@@ -0,0 +1,823 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/dsp/kernels.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// AVX2 and AVX-512 kernels get compiled for their target regardless of the
+// build flags, and are only called if the CPU supports them
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SPIRALVIZ_HAS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace
+{
+struct KernelTable
+{
+    KernelISA isa;
+    void (*window_multiply)(float* out, const float* window, const float* in, std::size_t n);
+    void (*window_multiply_s16)(float* out, const float* window, const std::int16_t* in, float scale, std::size_t n);
+    float (*dot_product)(const float* a, const float* b, std::size_t n);
+    void (*complex_magnitudes)(float* out, const float* real, const float* imag, float scale, std::size_t n);
+    void (*complex_mix_magnitudes)(
+        float* out,
+        const float* a_real, const float* a_imag,
+        const float* b_real, const float* b_imag,
+        float a_weight, float b_weight, float scale,
+        std::size_t n
+    );
+    void (*quantize_log2_u16)(std::uint16_t* out, const float* in, float scale, float offset, std::size_t n);
+    void (*quantize_log2_u8)(std::uint8_t* out, const float* in, float scale, float offset, std::size_t n);
+};
+
+// The SIMD versions of `quantize_log2` take log2(x) as the exponent of x plus
+// log2 of its mantissa m, brought within [sqrt(1/2), sqrt(2)) by moving a
+// factor of 2 to the exponent. Then with t = (m - 1) / (m + 1), which stays
+// within +/-0.172, log2(m) = 2/ln(2) * (t + t^3/3 + t^5/5 + t^7/7 + ...), and
+// these four terms are within 1e-7 of it.
+constexpr float log2_series[] = {
+    2.0f / std::numbers::ln2_v<float>,
+    2.0f / (3.0f * std::numbers::ln2_v<float>),
+    2.0f / (5.0f * std::numbers::ln2_v<float>),
+    2.0f / (7.0f * std::numbers::ln2_v<float>)
+};
+
+constexpr std::int32_t float_exponent_bias = 127;
+constexpr std::int32_t float_mantissa_mask = 0x007fffff;
+constexpr std::int32_t float_one_bits = 0x3f800000;
+
+// The scalar versions also handle the tails of the SIMD ones, from `i` on.
+namespace scalar
+{
+void window_multiply(float* out, const float* window, const float* in, std::size_t n, std::size_t i = 0)
+{
+    for (; i < n; ++i)
+    {
+        out[i] = window[i] * in[i];
+    }
+}
+
+void window_multiply_s16(float* out, const float* window, const std::int16_t* in, float scale, std::size_t n, std::size_t i = 0)
+{
+    for (; i < n; ++i)
+    {
+        out[i] = window[i] * (in[i] * scale);
+    }
+}
+
+float dot_product(const float* a, const float* b, std::size_t n, std::size_t i = 0, float sum = 0.0f)
+{
+    for (; i < n; ++i)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void complex_magnitudes(float* out, const float* real, const float* imag, float scale, std::size_t n, std::size_t i = 0)
+{
+    for (; i < n; ++i)
+    {
+        out[i] = std::sqrt(real[i]*real[i] + imag[i]*imag[i]) * scale;
+    }
+}
+
+void complex_mix_magnitudes(
+    float* out,
+    const float* a_real, const float* a_imag,
+    const float* b_real, const float* b_imag,
+    float a_weight, float b_weight, float scale,
+    std::size_t n, std::size_t i = 0)
+{
+    for (; i < n; ++i)
+    {
+        const float real = a_weight * a_real[i] + b_weight * b_real[i];
+        const float imag = a_weight * a_imag[i] + b_weight * b_imag[i];
+        out[i] = std::sqrt(real*real + imag*imag) * scale;
+    }
+}
+
+template<class T>
+void quantize_log2(T* out, const float* in, float scale, float offset, std::size_t n, std::size_t i = 0)
+{
+    const float max_code = float(std::numeric_limits<T>::max());
+
+    for (; i < n; ++i)
+    {
+        // silence is -inf, which gets clamped to 0 like anything too quiet
+        out[i] = T(std::lrint(std::clamp(std::log2(in[i]) * scale + offset, 0.0f, max_code)));
+    }
+}
+
+constexpr KernelTable table{
+    .isa = KernelISA::SCALAR,
+    .window_multiply = [](float* out, const float* window, const float* in, std::size_t n) {
+        window_multiply(out, window, in, n);
+    },
+    .window_multiply_s16 = [](float* out, const float* window, const std::int16_t* in, float scale, std::size_t n) {
+        window_multiply_s16(out, window, in, scale, n);
+    },
+    .dot_product = [](const float* a, const float* b, std::size_t n) {
+        return dot_product(a, b, n);
+    },
+    .complex_magnitudes = [](float* out, const float* real, const float* imag, float scale, std::size_t n) {
+        complex_magnitudes(out, real, imag, scale, n);
+    },
+    .complex_mix_magnitudes = [](
+        float* out,
+        const float* a_real, const float* a_imag,
+        const float* b_real, const float* b_imag,
+        float a_weight, float b_weight, float scale,
+        std::size_t n) {
+        complex_mix_magnitudes(out, a_real, a_imag, b_real, b_imag, a_weight, b_weight, scale, n);
+    },
+    .quantize_log2_u16 = [](std::uint16_t* out, const float* in, float scale, float offset, std::size_t n) {
+        quantize_log2(out, in, scale, offset, n);
+    },
+    .quantize_log2_u8 = [](std::uint8_t* out, const float* in, float scale, float offset, std::size_t n) {
+        quantize_log2(out, in, scale, offset, n);
+    }
+};
+}
+
+#if defined(__SSE2__)
+namespace sse2
+{
+void window_multiply(float* out, const float* window, const float* in, std::size_t n)
+{
+    std::size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(&out[i], _mm_mul_ps(_mm_loadu_ps(&window[i]), _mm_loadu_ps(&in[i])));
+    }
+
+    scalar::window_multiply(out, window, in, n, i);
+}
+
+void window_multiply_s16(float* out, const float* window, const std::int16_t* in, float scale, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m128 scale_vec = _mm_set1_ps(scale);
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[i]));
+
+        // sign-extend to 32-bit by interleaving each sample into the upper half
+        // of a 32-bit lane, then shifting it back down arithmetically
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+        const __m128 lo_f = _mm_mul_ps(_mm_cvtepi32_ps(lo), scale_vec);
+        const __m128 hi_f = _mm_mul_ps(_mm_cvtepi32_ps(hi), scale_vec);
+
+        _mm_storeu_ps(&out[i], _mm_mul_ps(_mm_loadu_ps(&window[i]), lo_f));
+        _mm_storeu_ps(&out[i + 4], _mm_mul_ps(_mm_loadu_ps(&window[i + 4]), hi_f));
+    }
+
+    scalar::window_multiply_s16(out, window, in, scale, n, i);
+}
+
+float dot_product(const float* a, const float* b, std::size_t n)
+{
+    std::size_t i = 0;
+
+    // two accumulators to hide some of the addition latency
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i])));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&a[i + 4]), _mm_loadu_ps(&b[i + 4])));
+    }
+
+    // horizontal sum
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 0x55));
+
+    return scalar::dot_product(a, b, n, i, _mm_cvtss_f32(acc));
+}
+
+void complex_magnitudes(float* out, const float* real, const float* imag, float scale, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m128 scale_vec = _mm_set1_ps(scale);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 re = _mm_loadu_ps(&real[i]);
+        const __m128 im = _mm_loadu_ps(&imag[i]);
+        const __m128 sq = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+        _mm_storeu_ps(&out[i], _mm_mul_ps(_mm_sqrt_ps(sq), scale_vec));
+    }
+
+    scalar::complex_magnitudes(out, real, imag, scale, n, i);
+}
+
+void complex_mix_magnitudes(
+    float* out,
+    const float* a_real, const float* a_imag,
+    const float* b_real, const float* b_imag,
+    float a_weight, float b_weight, float scale,
+    std::size_t n)
+{
+    std::size_t i = 0;
+    const __m128 a_w = _mm_set1_ps(a_weight);
+    const __m128 b_w = _mm_set1_ps(b_weight);
+    const __m128 scale_vec = _mm_set1_ps(scale);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 re = _mm_add_ps(_mm_mul_ps(a_w, _mm_loadu_ps(&a_real[i])), _mm_mul_ps(b_w, _mm_loadu_ps(&b_real[i])));
+        const __m128 im = _mm_add_ps(_mm_mul_ps(a_w, _mm_loadu_ps(&a_imag[i])), _mm_mul_ps(b_w, _mm_loadu_ps(&b_imag[i])));
+        const __m128 sq = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+        _mm_storeu_ps(&out[i], _mm_mul_ps(_mm_sqrt_ps(sq), scale_vec));
+    }
+
+    scalar::complex_mix_magnitudes(out, a_real, a_imag, b_real, b_imag, a_weight, b_weight, scale, n, i);
+}
+
+/// Codes of `quantize_log2` for 4 values, as 32-bit integers.
+__m128i quantize_log2_codes(__m128 x, __m128 scale, __m128 offset, __m128 max_code)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i bits = _mm_castps_si128(x);
+
+    __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(float_exponent_bias));
+    __m128 mantissa = _mm_castsi128_ps(_mm_or_si128(
+        _mm_and_si128(bits, _mm_set1_epi32(float_mantissa_mask)),
+        _mm_set1_epi32(float_one_bits)
+    ));
+
+    // halve the mantissas above sqrt(2); the mask is -1 where it applies
+    const __m128 above = _mm_cmpgt_ps(mantissa, _mm_set1_ps(std::numbers::sqrt2_v<float>));
+    mantissa = _mm_sub_ps(mantissa, _mm_and_ps(above, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f))));
+    exponent = _mm_sub_epi32(exponent, _mm_castps_si128(above));
+
+    const __m128 t = _mm_div_ps(_mm_sub_ps(mantissa, one), _mm_add_ps(mantissa, one));
+    const __m128 t2 = _mm_mul_ps(t, t);
+
+    __m128 series = _mm_set1_ps(log2_series[3]);
+    series = _mm_add_ps(_mm_mul_ps(series, t2), _mm_set1_ps(log2_series[2]));
+    series = _mm_add_ps(_mm_mul_ps(series, t2), _mm_set1_ps(log2_series[1]));
+    series = _mm_add_ps(_mm_mul_ps(series, t2), _mm_set1_ps(log2_series[0]));
+
+    const __m128 log2 = _mm_add_ps(_mm_cvtepi32_ps(exponent), _mm_mul_ps(series, t));
+    const __m128 code = _mm_add_ps(_mm_mul_ps(log2, scale), offset);
+
+    return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(code, _mm_setzero_ps()), max_code));
+}
+
+void quantize_log2_u16(std::uint16_t* out, const float* in, float scale, float offset, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m128 scale_vec = _mm_set1_ps(scale);
+    const __m128 offset_vec = _mm_set1_ps(offset);
+    const __m128 max_code = _mm_set1_ps(65535.0f);
+
+    // SSE2 can only pack with signed saturation, so the codes get shifted to
+    // the signed range, then back once packed
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i unbias = _mm_set1_epi16(std::int16_t(0x8000));
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i lo = _mm_sub_epi32(quantize_log2_codes(_mm_loadu_ps(&in[i]), scale_vec, offset_vec, max_code), bias);
+        const __m128i hi = _mm_sub_epi32(quantize_log2_codes(_mm_loadu_ps(&in[i + 4]), scale_vec, offset_vec, max_code), bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), _mm_xor_si128(_mm_packs_epi32(lo, hi), unbias));
+    }
+
+    scalar::quantize_log2(out, in, scale, offset, n, i);
+}
+
+void quantize_log2_u8(std::uint8_t* out, const float* in, float scale, float offset, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m128 scale_vec = _mm_set1_ps(scale);
+    const __m128 offset_vec = _mm_set1_ps(offset);
+    const __m128 max_code = _mm_set1_ps(255.0f);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i codes[4];
+        for (std::size_t j = 0; j < 4; ++j)
+        {
+            codes[j] = quantize_log2_codes(_mm_loadu_ps(&in[i + 4 * j]), scale_vec, offset_vec, max_code);
+        }
+
+        const __m128i lo = _mm_packs_epi32(codes[0], codes[1]);
+        const __m128i hi = _mm_packs_epi32(codes[2], codes[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), _mm_packus_epi16(lo, hi));
+    }
+
+    scalar::quantize_log2(out, in, scale, offset, n, i);
+}
+
+constexpr KernelTable table{
+    .isa = KernelISA::SSE2,
+    .window_multiply = window_multiply,
+    .window_multiply_s16 = window_multiply_s16,
+    .dot_product = dot_product,
+    .complex_magnitudes = complex_magnitudes,
+    .complex_mix_magnitudes = complex_mix_magnitudes,
+    .quantize_log2_u16 = quantize_log2_u16,
+    .quantize_log2_u8 = quantize_log2_u8
+};
+}
+#endif
+
+#if defined(SPIRALVIZ_HAS_X86_DISPATCH)
+namespace avx2
+{
+#define SPIRALVIZ_AVX2 __attribute__((target("avx2,fma")))
+
+SPIRALVIZ_AVX2 void window_multiply(float* out, const float* window, const float* in, std::size_t n)
+{
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_loadu_ps(&window[i]), _mm256_loadu_ps(&in[i])));
+    }
+
+    scalar::window_multiply(out, window, in, n, i);
+}
+
+SPIRALVIZ_AVX2 void window_multiply_s16(float* out, const float* window, const std::int16_t* in, float scale, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[i]));
+        const __m256 x_f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x)), scale_vec);
+        _mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_loadu_ps(&window[i]), x_f));
+    }
+
+    scalar::window_multiply_s16(out, window, in, scale, n, i);
+}
+
+SPIRALVIZ_AVX2 float dot_product(const float* a, const float* b, std::size_t n)
+{
+    std::size_t i = 0;
+
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i]), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i + 8]), _mm256_loadu_ps(&b[i + 8]), acc1);
+    }
+
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+
+    return scalar::dot_product(a, b, n, i, _mm_cvtss_f32(sum));
+}
+
+SPIRALVIZ_AVX2 void complex_magnitudes(float* out, const float* real, const float* imag, float scale, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 re = _mm256_loadu_ps(&real[i]);
+        const __m256 im = _mm256_loadu_ps(&imag[i]);
+        const __m256 sq = _mm256_fmadd_ps(re, re, _mm256_mul_ps(im, im));
+        _mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_sqrt_ps(sq), scale_vec));
+    }
+
+    scalar::complex_magnitudes(out, real, imag, scale, n, i);
+}
+
+SPIRALVIZ_AVX2 void complex_mix_magnitudes(
+    float* out,
+    const float* a_real, const float* a_imag,
+    const float* b_real, const float* b_imag,
+    float a_weight, float b_weight, float scale,
+    std::size_t n)
+{
+    std::size_t i = 0;
+    const __m256 a_w = _mm256_set1_ps(a_weight);
+    const __m256 b_w = _mm256_set1_ps(b_weight);
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 re = _mm256_fmadd_ps(a_w, _mm256_loadu_ps(&a_real[i]), _mm256_mul_ps(b_w, _mm256_loadu_ps(&b_real[i])));
+        const __m256 im = _mm256_fmadd_ps(a_w, _mm256_loadu_ps(&a_imag[i]), _mm256_mul_ps(b_w, _mm256_loadu_ps(&b_imag[i])));
+        const __m256 sq = _mm256_fmadd_ps(re, re, _mm256_mul_ps(im, im));
+        _mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_sqrt_ps(sq), scale_vec));
+    }
+
+    scalar::complex_mix_magnitudes(out, a_real, a_imag, b_real, b_imag, a_weight, b_weight, scale, n, i);
+}
+
+/// Codes of `quantize_log2` for 8 values, packed to 16-bit.
+SPIRALVIZ_AVX2 __m128i quantize_log2_codes(__m256 x, __m256 scale, __m256 offset, __m256 max_code)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i bits = _mm256_castps_si256(x);
+
+    __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(float_exponent_bias));
+    __m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi32(float_mantissa_mask)),
+        _mm256_set1_epi32(float_one_bits)
+    ));
+
+    const __m256 above = _mm256_cmp_ps(mantissa, _mm256_set1_ps(std::numbers::sqrt2_v<float>), _CMP_GT_OQ);
+    mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, _mm256_set1_ps(0.5f)), above);
+    exponent = _mm256_sub_epi32(exponent, _mm256_castps_si256(above));
+
+    const __m256 t = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+    const __m256 t2 = _mm256_mul_ps(t, t);
+
+    __m256 series = _mm256_set1_ps(log2_series[3]);
+    series = _mm256_fmadd_ps(series, t2, _mm256_set1_ps(log2_series[2]));
+    series = _mm256_fmadd_ps(series, t2, _mm256_set1_ps(log2_series[1]));
+    series = _mm256_fmadd_ps(series, t2, _mm256_set1_ps(log2_series[0]));
+
+    const __m256 log2 = _mm256_fmadd_ps(series, t, _mm256_cvtepi32_ps(exponent));
+    const __m256 code = _mm256_fmadd_ps(log2, scale, offset);
+
+    const __m256i codes = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(code, _mm256_setzero_ps()), max_code));
+    return _mm_packus_epi32(_mm256_castsi256_si128(codes), _mm256_extracti128_si256(codes, 1));
+}
+
+SPIRALVIZ_AVX2 void quantize_log2_u16(std::uint16_t* out, const float* in, float scale, float offset, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+    const __m256 offset_vec = _mm256_set1_ps(offset);
+    const __m256 max_code = _mm256_set1_ps(65535.0f);
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i codes = quantize_log2_codes(_mm256_loadu_ps(&in[i]), scale_vec, offset_vec, max_code);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), codes);
+    }
+
+    scalar::quantize_log2(out, in, scale, offset, n, i);
+}
+
+SPIRALVIZ_AVX2 void quantize_log2_u8(std::uint8_t* out, const float* in, float scale, float offset, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+    const __m256 offset_vec = _mm256_set1_ps(offset);
+    const __m256 max_code = _mm256_set1_ps(255.0f);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i lo = quantize_log2_codes(_mm256_loadu_ps(&in[i]), scale_vec, offset_vec, max_code);
+        const __m128i hi = quantize_log2_codes(_mm256_loadu_ps(&in[i + 8]), scale_vec, offset_vec, max_code);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), _mm_packus_epi16(lo, hi));
+    }
+
+    scalar::quantize_log2(out, in, scale, offset, n, i);
+}
+
+#undef SPIRALVIZ_AVX2
+
+constexpr KernelTable table{
+    .isa = KernelISA::AVX2,
+    .window_multiply = window_multiply,
+    .window_multiply_s16 = window_multiply_s16,
+    .dot_product = dot_product,
+    .complex_magnitudes = complex_magnitudes,
+    .complex_mix_magnitudes = complex_mix_magnitudes,
+    .quantize_log2_u16 = quantize_log2_u16,
+    .quantize_log2_u8 = quantize_log2_u8
+};
+}
+
+namespace avx512
+{
+#define SPIRALVIZ_AVX512 __attribute__((target("avx512f")))
+
+SPIRALVIZ_AVX512 void window_multiply(float* out, const float* window, const float* in, std::size_t n)
+{
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        _mm512_storeu_ps(&out[i], _mm512_mul_ps(_mm512_loadu_ps(&window[i]), _mm512_loadu_ps(&in[i])));
+    }
+
+    scalar::window_multiply(out, window, in, n, i);
+}
+
+SPIRALVIZ_AVX512 void window_multiply_s16(float* out, const float* window, const std::int16_t* in, float scale, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m512 scale_vec = _mm512_set1_ps(scale);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&in[i]));
+        const __m512 x_f = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(x)), scale_vec);
+        _mm512_storeu_ps(&out[i], _mm512_mul_ps(_mm512_loadu_ps(&window[i]), x_f));
+    }
+
+    scalar::window_multiply_s16(out, window, in, scale, n, i);
+}
+
+SPIRALVIZ_AVX512 float dot_product(const float* a, const float* b, std::size_t n)
+{
+    std::size_t i = 0;
+
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    for (; i + 32 <= n; i += 32)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(&a[i]), _mm512_loadu_ps(&b[i]), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(&a[i + 16]), _mm512_loadu_ps(&b[i + 16]), acc1);
+    }
+
+    return scalar::dot_product(a, b, n, i, _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1)));
+}
+
+SPIRALVIZ_AVX512 void complex_magnitudes(float* out, const float* real, const float* imag, float scale, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m512 scale_vec = _mm512_set1_ps(scale);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 re = _mm512_loadu_ps(&real[i]);
+        const __m512 im = _mm512_loadu_ps(&imag[i]);
+        const __m512 sq = _mm512_fmadd_ps(re, re, _mm512_mul_ps(im, im));
+        _mm512_storeu_ps(&out[i], _mm512_mul_ps(_mm512_sqrt_ps(sq), scale_vec));
+    }
+
+    scalar::complex_magnitudes(out, real, imag, scale, n, i);
+}
+
+SPIRALVIZ_AVX512 void complex_mix_magnitudes(
+    float* out,
+    const float* a_real, const float* a_imag,
+    const float* b_real, const float* b_imag,
+    float a_weight, float b_weight, float scale,
+    std::size_t n)
+{
+    std::size_t i = 0;
+    const __m512 a_w = _mm512_set1_ps(a_weight);
+    const __m512 b_w = _mm512_set1_ps(b_weight);
+    const __m512 scale_vec = _mm512_set1_ps(scale);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 re = _mm512_fmadd_ps(a_w, _mm512_loadu_ps(&a_real[i]), _mm512_mul_ps(b_w, _mm512_loadu_ps(&b_real[i])));
+        const __m512 im = _mm512_fmadd_ps(a_w, _mm512_loadu_ps(&a_imag[i]), _mm512_mul_ps(b_w, _mm512_loadu_ps(&b_imag[i])));
+        const __m512 sq = _mm512_fmadd_ps(re, re, _mm512_mul_ps(im, im));
+        _mm512_storeu_ps(&out[i], _mm512_mul_ps(_mm512_sqrt_ps(sq), scale_vec));
+    }
+
+    scalar::complex_mix_magnitudes(out, a_real, a_imag, b_real, b_imag, a_weight, b_weight, scale, n, i);
+}
+
+/// Codes of `quantize_log2` for 16 values, as 32-bit integers.
+SPIRALVIZ_AVX512 __m512i quantize_log2_codes(__m512 x, __m512 scale, __m512 offset, __m512 max_code)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512i bits = _mm512_castps_si512(x);
+
+    __m512i exponent = _mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(float_exponent_bias));
+    __m512 mantissa = _mm512_castsi512_ps(_mm512_or_si512(
+        _mm512_and_si512(bits, _mm512_set1_epi32(float_mantissa_mask)),
+        _mm512_set1_epi32(float_one_bits)
+    ));
+
+    const __mmask16 above = _mm512_cmp_ps_mask(mantissa, _mm512_set1_ps(std::numbers::sqrt2_v<float>), _CMP_GT_OQ);
+    mantissa = _mm512_mask_mul_ps(mantissa, above, mantissa, _mm512_set1_ps(0.5f));
+    exponent = _mm512_mask_add_epi32(exponent, above, exponent, _mm512_set1_epi32(1));
+
+    const __m512 t = _mm512_div_ps(_mm512_sub_ps(mantissa, one), _mm512_add_ps(mantissa, one));
+    const __m512 t2 = _mm512_mul_ps(t, t);
+
+    __m512 series = _mm512_set1_ps(log2_series[3]);
+    series = _mm512_fmadd_ps(series, t2, _mm512_set1_ps(log2_series[2]));
+    series = _mm512_fmadd_ps(series, t2, _mm512_set1_ps(log2_series[1]));
+    series = _mm512_fmadd_ps(series, t2, _mm512_set1_ps(log2_series[0]));
+
+    const __m512 log2 = _mm512_fmadd_ps(series, t, _mm512_cvtepi32_ps(exponent));
+    const __m512 code = _mm512_fmadd_ps(log2, scale, offset);
+
+    return _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(code, _mm512_setzero_ps()), max_code));
+}
+
+SPIRALVIZ_AVX512 void quantize_log2_u16(std::uint16_t* out, const float* in, float scale, float offset, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m512 scale_vec = _mm512_set1_ps(scale);
+    const __m512 offset_vec = _mm512_set1_ps(offset);
+    const __m512 max_code = _mm512_set1_ps(65535.0f);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512i codes = quantize_log2_codes(_mm512_loadu_ps(&in[i]), scale_vec, offset_vec, max_code);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[i]), _mm512_cvtusepi32_epi16(codes));
+    }
+
+    scalar::quantize_log2(out, in, scale, offset, n, i);
+}
+
+SPIRALVIZ_AVX512 void quantize_log2_u8(std::uint8_t* out, const float* in, float scale, float offset, std::size_t n)
+{
+    std::size_t i = 0;
+    const __m512 scale_vec = _mm512_set1_ps(scale);
+    const __m512 offset_vec = _mm512_set1_ps(offset);
+    const __m512 max_code = _mm512_set1_ps(255.0f);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512i codes = quantize_log2_codes(_mm512_loadu_ps(&in[i]), scale_vec, offset_vec, max_code);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), _mm512_cvtusepi32_epi8(codes));
+    }
+
+    scalar::quantize_log2(out, in, scale, offset, n, i);
+}
+
+#undef SPIRALVIZ_AVX512
+
+constexpr KernelTable table{
+    .isa = KernelISA::AVX512,
+    .window_multiply = window_multiply,
+    .window_multiply_s16 = window_multiply_s16,
+    .dot_product = dot_product,
+    .complex_magnitudes = complex_magnitudes,
+    .complex_mix_magnitudes = complex_mix_magnitudes,
+    .quantize_log2_u16 = quantize_log2_u16,
+    .quantize_log2_u8 = quantize_log2_u8
+};
+}
+#endif
+
+const KernelTable* find_table(KernelISA isa)
+{
+    switch (isa)
+    {
+    case KernelISA::SCALAR:
+        return &scalar::table;
+#if defined(__SSE2__)
+    case KernelISA::SSE2:
+        return &sse2::table;
+#endif
+#if defined(SPIRALVIZ_HAS_X86_DISPATCH)
+    case KernelISA::AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? &avx2::table : nullptr;
+    case KernelISA::AVX512:
+        return __builtin_cpu_supports("avx512f") ? &avx512::table : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+std::atomic<const KernelTable*>& active_table()
+{
+    static std::atomic<const KernelTable*> table{find_table(best_kernel_isa())};
+    return table;
+}
+
+const KernelTable& kernels()
+{
+    return *active_table().load(std::memory_order_relaxed);
+}
+}
+
+bool is_kernel_isa_supported(KernelISA isa)
+{
+    return find_table(isa) != nullptr;
+}
+
+KernelISA best_kernel_isa()
+{
+    for (KernelISA isa : {KernelISA::AVX512, KernelISA::AVX2, KernelISA::SSE2})
+    {
+        if (is_kernel_isa_supported(isa))
+        {
+            return isa;
+        }
+    }
+
+    return KernelISA::SCALAR;
+}
+
+KernelISA active_kernel_isa()
+{
+    return kernels().isa;
+}
+
+void set_kernel_isa(KernelISA isa)
+{
+    const KernelTable* table = find_table(isa);
+
+    if (table == nullptr)
+    {
+        throw std::runtime_error(std::string(get_kernel_isa_string(isa)) + " kernels are not supported on this CPU");
+    }
+
+    active_table().store(table, std::memory_order_relaxed);
+}
+
+void window_multiply(
+    std::span<float> out,
+    std::span<const float> window,
+    std::span<const float> in)
+{
+    assert(out.size() == window.size() && out.size() == in.size());
+    kernels().window_multiply(out.data(), window.data(), in.data(), out.size());
+}
+
+void window_multiply_s16(
+    std::span<float> out,
+    std::span<const float> window,
+    std::span<const std::int16_t> in,
+    float scale)
+{
+    assert(out.size() == window.size() && out.size() == in.size());
+    kernels().window_multiply_s16(out.data(), window.data(), in.data(), scale, out.size());
+}
+
+float dot_product(
+    std::span<const float> a,
+    std::span<const float> b)
+{
+    assert(a.size() == b.size());
+    return kernels().dot_product(a.data(), b.data(), a.size());
+}
+
+void complex_magnitudes(
+    std::span<float> out,
+    SplitComplexSpan in,
+    float scale)
+{
+    assert(out.size() == in.real.size() && out.size() == in.imag.size());
+
+    // each lane reads then writes the same index, so writing over `in.real`
+    // is fine at any vector width
+    kernels().complex_magnitudes(out.data(), in.real.data(), in.imag.data(), scale, out.size());
+}
+
+void complex_mix_magnitudes(
+    std::span<float> out,
+    SplitComplexSpan a,
+    SplitComplexSpan b,
+    float a_weight,
+    float b_weight,
+    float scale)
+{
+    assert(out.size() == a.size() && out.size() == b.size());
+    assert(a.real.size() == a.imag.size() && b.real.size() == b.imag.size());
+
+    kernels().complex_mix_magnitudes(
+        out.data(),
+        a.real.data(), a.imag.data(),
+        b.real.data(), b.imag.data(),
+        a_weight, b_weight, scale,
+        out.size()
+    );
+}
+
+void quantize_log2(
+    std::span<std::uint16_t> out,
+    std::span<const float> in,
+    float scale,
+    float offset)
+{
+    assert(out.size() == in.size());
+    kernels().quantize_log2_u16(out.data(), in.data(), scale, offset, out.size());
+}
+
+void quantize_log2(
+    std::span<std::uint8_t> out,
+    std::span<const float> in,
+    float scale,
+    float offset)
+{
+    assert(out.size() == in.size());
+    kernels().quantize_log2_u8(out.data(), in.data(), scale, offset, out.size());
+}
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/dsp/multiresolution.hpp>
+
+#include <spiralviz/dsp/util.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Every band but the top one gets filtered down to this fraction of its
+// Nyquist frequency by the decimator in front of it, see `PolyphaseResampler`
+constexpr double decimator_passband = 0.8;
+
+constexpr float decimator_stopband_db = 80.0f;
+
+constexpr std::size_t max_band_count = 16;
+}
+
+MultiResolutionSpectrum::MultiResolutionSpectrum(
+    std::size_t sample_rate,
+    const FFTHighLevelConfig& window_config,
+    const MultiResolutionConfig& config,
+    std::shared_ptr<const FFTPlan> plan,
+    std::size_t level_reference_size) :
+    m_config{config}
+{
+    const std::size_t window_size = m_config.band_window_size;
+    const double max_window_s = m_config.max_window_ms / 1000.0;
+
+    // halve the rate for as long as windows stay within the latency bound
+    std::size_t band_count = 1;
+    while (band_count < max_band_count
+        && double(window_size << band_count) / sample_rate <= max_window_s)
+    {
+        ++band_count;
+    }
+
+    const FFTConfig fft_config{
+        .window_size_samples = window_size,
+        .window_factors = window_config.make_window_factors(window_size)
+    };
+
+    double filter_delay_s = 0.0;
+
+    for (std::size_t b = 0; b < band_count; ++b)
+    {
+        const double rate = double(sample_rate) / double(std::size_t(1) << b);
+        const bool is_top = b == 0;
+        const bool is_bottom = b + 1 == band_count;
+
+        // each band covers the top octave of what its decimator lets through,
+        // so the next band takes over well before the transition band
+        m_bands.push_back({
+            .sample_rate = rate,
+            .low_frequency = is_bottom ? 0.0 : decimator_passband * rate / 4.0,
+            .high_frequency = is_top ? rate / 2.0 : decimator_passband * rate / 2.0,
+            .filter_delay_s = filter_delay_s
+        });
+
+        m_band_ffts.emplace_back(fft_config, SampleFormat::F32, plan);
+
+        if (!is_bottom)
+        {
+            // only the ratio matters to the resampler
+            m_decimators.emplace_back(2, 1, decimator_stopband_db);
+            filter_delay_s += 0.5 * m_decimators.back().taps_per_phase() / rate;
+        }
+    }
+
+    m_decimated.resize(m_decimators.size());
+    m_pending.assign(band_count, 0);
+    m_band_magnitudes.assign(band_count, std::vector<float>(m_band_ffts.front().output_size()));
+    m_band_ready.assign(band_count, false);
+
+    set_level_reference(level_reference_size);
+    build_layout(sample_rate);
+}
+
+void MultiResolutionSpectrum::set_window(const FFTHighLevelConfig& window_config, std::size_t level_reference_size)
+{
+    const FFTConfig fft_config{
+        .window_size_samples = m_config.band_window_size,
+        .window_factors = window_config.make_window_factors(m_config.band_window_size)
+    };
+
+    for (auto& fft : m_band_ffts)
+    {
+        fft.update_from_config(fft_config);
+    }
+
+    set_level_reference(level_reference_size);
+}
+
+void MultiResolutionSpectrum::set_level_reference(std::size_t level_reference_size)
+{
+    // tones peak proportionally to the square root of the FFT size with the
+    // magnitude scale of `WindowedFFT`
+    const double reference_bins = double(level_reference_size / 2 - 1);
+    m_level_gain = float(std::sqrt(reference_bins / m_band_ffts.front().output_size()));
+}
+
+void MultiResolutionSpectrum::build_layout(std::size_t sample_rate)
+{
+    m_layout = {
+        .scale = SpectrumScale::CENTS,
+        .min_frequency = m_config.min_frequency,
+        .cents_per_bin = m_config.cents_per_bin
+    };
+
+    const double nyquist = sample_rate / 2.0;
+    const double octaves = std::log2(nyquist / m_config.min_frequency);
+    const std::size_t bin_count = octaves > 0.0
+        ? std::size_t(octaves * cents_per_octave / m_config.cents_per_bin)
+        : 0;
+
+    const double window_size = double(m_config.band_window_size);
+    const std::uint32_t band_bins = std::uint32_t(m_band_ffts.front().output_size());
+
+    // the output bin spans half a step on either side of its center
+    const double half_step = std::exp2(m_config.cents_per_bin / (2.0 * cents_per_octave));
+
+    m_bin_sources.clear();
+    m_bin_sources.reserve(bin_count);
+
+    for (std::size_t i = 0; i < bin_count; ++i)
+    {
+        const double frequency = m_config.min_frequency * std::exp2(i * m_config.cents_per_bin / cents_per_octave);
+
+        std::uint32_t band = 0;
+        while (frequency < m_bands[band].low_frequency)
+        {
+            ++band;
+        }
+
+        const double bins_per_hz = window_size / m_bands[band].sample_rate;
+        const double low_bin = frequency / half_step * bins_per_hz;
+        const double high_bin = frequency * half_step * bins_per_hz;
+
+        BinSource source{.band = band};
+
+        if (std::floor(high_bin) >= std::ceil(low_bin))
+        {
+            source.first = std::min(std::uint32_t(std::ceil(low_bin)), band_bins - 1);
+            source.last = std::min(std::uint32_t(std::floor(high_bin)), band_bins - 1);
+            source.interpolate = false;
+        }
+        else
+        {
+            const double center_bin = frequency * bins_per_hz;
+            source.first = std::min(std::uint32_t(center_bin), band_bins - 2);
+            source.fraction = float(std::clamp(center_bin - source.first, 0.0, 1.0));
+            source.interpolate = true;
+        }
+
+        m_bin_sources.push_back(source);
+    }
+
+    m_output.assign(bin_count, 0.0f);
+}
+
+void MultiResolutionSpectrum::push_samples(SampleSpan samples)
+{
+    m_band_ffts[0].push_samples(samples);
+    m_pending[0] += samples.size();
+
+    // each decimator feeds off the output of the previous one
+    for (std::size_t d = 0; d < m_decimators.size(); ++d)
+    {
+        const SampleSpan input = d == 0 ? samples : SampleSpan{std::span<const float>{m_decimated[d - 1]}};
+
+        m_decimated[d].clear();
+        m_decimators[d].process(input, m_decimated[d]);
+
+        m_band_ffts[d + 1].push_samples(std::span<const float>{m_decimated[d]});
+        m_pending[d + 1] += m_decimated[d].size();
+    }
+}
+
+std::span<float> MultiResolutionSpectrum::compute(std::size_t hop)
+{
+    for (std::size_t b = 0; b < m_band_ffts.size(); ++b)
+    {
+        if (m_band_ready[b] && m_pending[b] < std::max<std::size_t>(hop, 1))
+        {
+            continue;
+        }
+
+        const std::span<const float> magnitudes = m_band_ffts[b].compute();
+        std::copy(magnitudes.begin(), magnitudes.end(), m_band_magnitudes[b].begin());
+
+        m_pending[b] = 0;
+        m_band_ready[b] = true;
+        ++m_transform_count;
+    }
+
+    for (std::size_t i = 0; i < m_bin_sources.size(); ++i)
+    {
+        const BinSource& source = m_bin_sources[i];
+        const std::vector<float>& magnitudes = m_band_magnitudes[source.band];
+
+        float value;
+
+        if (source.interpolate)
+        {
+            const float low = magnitudes[source.first];
+            const float high = magnitudes[source.first + 1];
+            value = low + (high - low) * source.fraction;
+        }
+        else
+        {
+            value = *std::max_element(
+                magnitudes.begin() + source.first,
+                magnitudes.begin() + source.last + 1
+            );
+        }
+
+        m_output[i] = value * m_level_gain;
+    }
+
+    return m_output;
+}
+
+void MultiResolutionSpectrum::set_plan(std::shared_ptr<const FFTPlan> plan)
+{
+    for (auto& fft : m_band_ffts)
+    {
+        fft.set_plan(plan);
+    }
+}
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/dsp/resampler.hpp>
+
+#include <spiralviz/dsp/kernels.hpp>
+
+#include <cmath>
+#include <numbers>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+// Phases are stored for every output position, so the numerator of the ratio
+// directly determines the size of the filter bank.
+constexpr std::size_t max_upsampling_factor = 1024;
+
+double bessel_i0(double x)
+{
+    // power series, converges quickly for the range of beta we use
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 64; ++k)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+
+        if (term < sum * 1.0e-12)
+        {
+            break;
+        }
+    }
+
+    return sum;
+}
+
+double kaiser_beta(double stopband_db)
+{
+    if (stopband_db > 50.0)
+    {
+        return 0.1102 * (stopband_db - 8.7);
+    }
+
+    if (stopband_db > 21.0)
+    {
+        return 0.5842 * std::pow(stopband_db - 21.0, 0.4) + 0.07886 * (stopband_db - 21.0);
+    }
+
+    return 0.0;
+}
+
+double sinc(double x)
+{
+    return x == 0.0 ? 1.0 : std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+}
+}
+
+PolyphaseResampler::PolyphaseResampler(std::size_t input_rate, std::size_t output_rate, float stopband_db) :
+    m_input_rate{input_rate},
+    m_output_rate{output_rate}
+{
+    const std::size_t divisor = std::gcd(input_rate, output_rate);
+    m_up = output_rate / divisor;
+    m_down = input_rate / divisor;
+
+    if (m_up > max_upsampling_factor)
+    {
+        throw std::runtime_error(
+            "Cannot resample from " + std::to_string(input_rate) + " Hz to " + std::to_string(output_rate)
+            + " Hz: the ratio does not reduce to a small enough fraction"
+        );
+    }
+
+    // the filter runs at the upsampled rate, and must cut off at the lowest
+    // of both Nyquist frequencies. the transition band spans the top 20% below
+    // it, which keeps everything the spiral can show well within the passband
+    const double upsampled_rate = double(input_rate) * m_up;
+    const double nyquist = 0.5 * std::min(input_rate, output_rate);
+    const double cutoff = 0.9 * nyquist / upsampled_rate;
+    const double transition = 0.2 * nyquist / upsampled_rate;
+
+    // Kaiser's estimates of the window's shape and length for a given stopband
+    // attenuation and transition width
+    const double beta = kaiser_beta(stopband_db);
+    const std::size_t filter_size = std::size_t(std::ceil((stopband_db - 7.95) / (14.36 * transition))) + 1;
+
+    // pad every phase to a multiple of 4 taps for the SIMD dot product; the
+    // padding coefficients are zero
+    m_taps_per_phase = (filter_size + m_up - 1) / m_up;
+    m_taps_per_phase = (m_taps_per_phase + 3) / 4 * 4;
+
+    std::vector<double> prototype(m_taps_per_phase * m_up, 0.0);
+    const double center = double(filter_size - 1) / 2.0;
+    const double i0_beta = bessel_i0(beta);
+    double gain = 0.0;
+
+    for (std::size_t k = 0; k < filter_size; ++k)
+    {
+        const double x = filter_size > 1 ? (2.0 * k) / double(filter_size - 1) - 1.0 : 0.0;
+        const double window = bessel_i0(beta * std::sqrt(std::max(0.0, 1.0 - x * x))) / i0_beta;
+
+        prototype[k] = 2.0 * cutoff * sinc(2.0 * cutoff * (double(k) - center)) * window;
+        gain += prototype[k];
+    }
+
+    // each phase only sees one in L of the coefficients, so the whole filter
+    // needs a gain of L for the output to keep the level of the input
+    const double normalization = double(m_up) / gain;
+
+    m_coeffs.resize(m_taps_per_phase * m_up);
+    for (std::size_t phase = 0; phase < m_up; ++phase)
+    {
+        for (std::size_t t = 0; t < m_taps_per_phase; ++t)
+        {
+            const std::size_t k = phase + (m_taps_per_phase - 1 - t) * m_up;
+            m_coeffs[phase * m_taps_per_phase + t] = float(prototype[k] * normalization);
+        }
+    }
+
+    reset();
+}
+
+std::size_t PolyphaseResampler::process(SampleSpan input, std::vector<float>& output)
+{
+    const std::size_t kept = m_history.size();
+    m_history.resize(kept + input.size());
+    copy_samples(input, std::span{m_history}.subspan(kept));
+
+    const std::size_t output_start = output.size();
+
+    for (std::size_t newest = m_time / m_up; newest < m_history.size(); newest = m_time / m_up)
+    {
+        const std::size_t phase = m_time % m_up;
+
+        output.push_back(dot_product(
+            std::span{m_coeffs}.subspan(phase * m_taps_per_phase, m_taps_per_phase),
+            std::span{m_history}.subspan(newest + 1 - m_taps_per_phase, m_taps_per_phase)
+        ));
+
+        m_time += m_down;
+    }
+
+    // only keep what the next outputs may still need
+    const std::size_t history_size = m_taps_per_phase - 1;
+    const std::size_t consumed = m_history.size() - history_size;
+    std::copy(m_history.begin() + consumed, m_history.end(), m_history.begin());
+    m_history.resize(history_size);
+    m_time -= consumed * m_up;
+
+    return output.size() - output_start;
+}
+
+void PolyphaseResampler::reset()
+{
+    m_history.assign(m_taps_per_phase - 1, 0.0f);
+    m_time = (m_taps_per_phase - 1) * m_up;
+}
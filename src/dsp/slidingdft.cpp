@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/dsp/slidingdft.hpp>
+
+#include <spiralviz/dsp/util.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+constexpr std::size_t conversion_chunk_size = 4096;
+}
+
+SlidingDFT::SlidingDFT(
+    std::size_t sample_rate,
+    std::size_t window_size,
+    WindowType window_type,
+    const SlidingDFTConfig& config) :
+    m_config{config},
+    m_window_size{window_size},
+    m_window_type{window_type},
+    m_cos_table(window_size),
+    m_sin_table(window_size),
+    m_history(window_size, 0.0f),
+    m_damping{config.damping},
+    m_leaving_gain{float(std::pow(double(config.damping), double(window_size)))},
+    m_magnitude_scale{1.0f / std::sqrt(float(window_size / 2 - 1))}
+{
+    if (window_size < 16 || (window_size & (window_size - 1)) != 0)
+    {
+        throw std::runtime_error("Sliding DFT window size must be a power of two, got " + std::to_string(window_size));
+    }
+
+    for (std::size_t i = 0; i < window_size; ++i)
+    {
+        const double angle = 2.0 * std::numbers::pi * double(i) / double(window_size);
+        m_cos_table[i] = float(std::cos(angle));
+        m_sin_table[i] = float(std::sin(angle));
+    }
+
+    // a window of sum_d (-1)^d a_d cos(2 pi d m / N) transforms into a_0 at
+    // the center bin and (-1)^d a_d / 2 at d bins on either side, see
+    // windowfuncs.cpp for the coefficients
+    switch (window_type)
+    {
+    case WindowType::HAMMING:
+    {
+        m_window_kernel = {0.54f, -0.46f / 2.0f};
+        m_window_taps = 1;
+        break;
+    }
+    case WindowType::BLACKMAN_HARRIS:
+    {
+        m_window_kernel = {0.35875f, -0.48829f / 2.0f, 0.14128f / 2.0f, -0.01168f / 2.0f};
+        m_window_taps = 3;
+        break;
+    }
+    case WindowType::RECTANGLE:
+    default:
+    {
+        m_window_kernel = {1.0f};
+        m_window_taps = 0;
+        break;
+    }
+    }
+
+    build_layout(sample_rate);
+}
+
+void SlidingDFT::build_layout(std::size_t sample_rate)
+{
+    m_layout = {
+        .scale = SpectrumScale::CENTS,
+        .min_frequency = m_config.min_frequency,
+        .cents_per_bin = m_config.cents_per_bin
+    };
+
+    const double max_frequency = std::min(double(m_config.max_frequency), sample_rate / 2.0);
+    const double octaves = std::log2(max_frequency / m_config.min_frequency);
+    const std::size_t bin_count = octaves > 0.0
+        ? std::size_t(octaves * cents_per_octave / m_config.cents_per_bin) + 1
+        : 0;
+
+    const double bins_per_hz = double(m_window_size) / sample_rate;
+    const double half_step = std::exp2(m_config.cents_per_bin / (2.0 * cents_per_octave));
+
+    // every windowed bin needs the tracked bins `m_window_taps` around it
+    const std::size_t lowest_bin = m_window_taps;
+    const std::size_t highest_bin = m_window_size / 2 - m_window_taps;
+    const auto clamp_bin = [&](double bin) {
+        return std::clamp(std::size_t(std::max(bin, 0.0)), lowest_bin, highest_bin);
+    };
+
+    // first pass in absolute DFT bins
+    std::vector<BinSource> sources;
+    sources.reserve(bin_count);
+
+    std::vector<std::size_t> windowed;
+    windowed.reserve(bin_count + 1);
+
+    for (std::size_t i = 0; i < bin_count; ++i)
+    {
+        const double frequency = m_config.min_frequency * std::exp2(i * m_config.cents_per_bin / cents_per_octave);
+        const double center_bin = frequency * bins_per_hz;
+        const double low_bin = center_bin / half_step;
+        const double high_bin = center_bin * half_step;
+
+        BinSource source;
+
+        if (std::floor(high_bin) >= std::ceil(low_bin))
+        {
+            source.first = std::uint32_t(clamp_bin(std::round(center_bin)));
+            source.interpolate = false;
+            windowed.push_back(source.first);
+        }
+        else
+        {
+            source.first = std::uint32_t(std::min(clamp_bin(center_bin), highest_bin - 1));
+            source.fraction = float(std::clamp(center_bin - source.first, 0.0, 1.0));
+            source.interpolate = true;
+            windowed.push_back(source.first);
+            windowed.push_back(source.first + 1);
+        }
+
+        sources.push_back(source);
+    }
+
+    if (windowed.empty())
+    {
+        windowed.push_back(lowest_bin);
+    }
+
+    std::sort(windowed.begin(), windowed.end());
+    windowed.erase(std::unique(windowed.begin(), windowed.end()), windowed.end());
+
+    // the bins of an interpolation are consecutive, and so stay in `windowed`
+    for (BinSource& source : sources)
+    {
+        source.first = std::uint32_t(std::lower_bound(windowed.begin(), windowed.end(), source.first) - windowed.begin());
+    }
+
+    m_bin_sources = std::move(sources);
+
+    // merges the taps around each windowed bin into runs
+    m_tracked_runs.clear();
+    m_windowed_positions.clear();
+    m_windowed_positions.reserve(windowed.size());
+
+    std::size_t tracked_count = 0;
+
+    for (std::size_t bin : windowed)
+    {
+        const std::size_t first = bin - m_window_taps;
+        const std::size_t end = bin + m_window_taps + 1;
+
+        if (!m_tracked_runs.empty() && m_tracked_runs.back().first + m_tracked_runs.back().count >= first)
+        {
+            BinRun& run = m_tracked_runs.back();
+            const std::size_t grown = end - run.first;
+            tracked_count += grown - run.count;
+            run.count = grown;
+        }
+        else
+        {
+            m_tracked_runs.push_back({.first = first, .count = end - first});
+            tracked_count += end - first;
+        }
+
+        m_windowed_positions.push_back(tracked_count - m_window_taps - 1);
+    }
+
+    m_sum_real.assign(tracked_count, 0.0f);
+    m_sum_imag.assign(tracked_count, 0.0f);
+    m_rotated_real.assign(tracked_count, 0.0f);
+    m_rotated_imag.assign(tracked_count, 0.0f);
+    m_magnitudes.assign(windowed.size(), 0.0f);
+    m_output.assign(bin_count, 0.0f);
+}
+
+void SlidingDFT::push_samples(SampleSpan samples)
+{
+    // converted a chunk at a time, as samples may be strided or S16
+    for (std::size_t offset = 0; offset < samples.size(); offset += conversion_chunk_size)
+    {
+        const std::size_t count = std::min(conversion_chunk_size, samples.size() - offset);
+        m_samples.resize(count);
+        copy_samples(samples.subspan(offset, count), m_samples);
+
+        for (float sample : m_samples)
+        {
+            push_sample(sample);
+        }
+    }
+}
+
+void SlidingDFT::push_sample(float sample)
+{
+    const float leaving = m_history[m_position];
+    m_history[m_position] = sample;
+
+    // the sample leaving the window was modulated by the same factor N
+    // samples ago, so both share the modulation
+    const float delta = sample - m_leaving_gain * leaving;
+
+    // bin k gets modulated by exp(-2 pi i k n / N), which advances by n
+    // table entries from one bin to the next
+    const std::size_t mask = m_window_size - 1;
+    const std::size_t step = m_position;
+    std::size_t b = 0;
+
+    for (const BinRun& run : m_tracked_runs)
+    {
+        std::size_t index = (run.first * step) & mask;
+
+        for (const std::size_t end = b + run.count; b < end; ++b)
+        {
+            m_sum_real[b] = m_damping * m_sum_real[b] + delta * m_cos_table[index];
+            m_sum_imag[b] = m_damping * m_sum_imag[b] - delta * m_sin_table[index];
+            index = (index + step) & mask;
+        }
+    }
+
+    m_position = (m_position + 1) & mask;
+}
+
+std::span<float> SlidingDFT::compute([[maybe_unused]] std::size_t hop)
+{
+    // the sums are in the phase of the absolute sample index, while a DFT
+    // over the window starts at its oldest sample: rotate bin k by
+    // exp(2 pi i k (n + 1) / N), where n + 1 is the next sample index
+    const std::size_t mask = m_window_size - 1;
+    const std::size_t step = m_position;
+    std::size_t b = 0;
+
+    for (const BinRun& run : m_tracked_runs)
+    {
+        std::size_t index = (run.first * step) & mask;
+
+        for (const std::size_t end = b + run.count; b < end; ++b)
+        {
+            const float c = m_cos_table[index];
+            const float s = m_sin_table[index];
+            m_rotated_real[b] = m_sum_real[b] * c - m_sum_imag[b] * s;
+            m_rotated_imag[b] = m_sum_real[b] * s + m_sum_imag[b] * c;
+            index = (index + step) & mask;
+        }
+    }
+
+    // the taps around a windowed bin are always in its run
+    for (std::size_t w = 0; w < m_magnitudes.size(); ++w)
+    {
+        const std::size_t center = m_windowed_positions[w];
+
+        float real = m_window_kernel[0] * m_rotated_real[center];
+        float imag = m_window_kernel[0] * m_rotated_imag[center];
+
+        for (std::size_t d = 1; d <= m_window_taps; ++d)
+        {
+            real += m_window_kernel[d] * (m_rotated_real[center - d] + m_rotated_real[center + d]);
+            imag += m_window_kernel[d] * (m_rotated_imag[center - d] + m_rotated_imag[center + d]);
+        }
+
+        m_magnitudes[w] = std::sqrt(real * real + imag * imag) * m_magnitude_scale;
+    }
+
+    for (std::size_t i = 0; i < m_bin_sources.size(); ++i)
+    {
+        const BinSource& source = m_bin_sources[i];
+
+        if (source.interpolate)
+        {
+            const float low = m_magnitudes[source.first];
+            const float high = m_magnitudes[source.first + 1];
+            m_output[i] = low + (high - low) * source.fraction;
+        }
+        else
+        {
+            m_output[i] = m_magnitudes[source.first];
+        }
+    }
+
+    return m_output;
+}
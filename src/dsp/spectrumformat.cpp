@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/dsp/spectrumformat.hpp>
+
+#include <spiralviz/dsp/kernels.hpp>
+
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// 20 * log10(2), i.e. dB per octave of magnitude
+constexpr float db_per_log2 = 6.0205999f;
+}
+
+void EncodedSpectrum::encode(std::span<const float> magnitudes, SpectrumFormat new_format, const LogLevelRange& new_range)
+{
+    format = new_format;
+    range = new_range;
+
+    linear.clear();
+    log_u16.clear();
+    log_u8.clear();
+
+    if (format == SpectrumFormat::FLOAT)
+    {
+        linear.assign(magnitudes.begin(), magnitudes.end());
+        return;
+    }
+
+    // code = (20 * log10(m) - min_db) / (max_db - min_db) * max_code
+    const float codes_per_db = float(max_code()) / (range.max_db - range.min_db);
+    const float scale = db_per_log2 * codes_per_db;
+    const float offset = -range.min_db * codes_per_db;
+
+    if (format == SpectrumFormat::LOG_U16)
+    {
+        log_u16.resize(magnitudes.size());
+        quantize_log2(log_u16, magnitudes, scale, offset);
+    }
+    else
+    {
+        log_u8.resize(magnitudes.size());
+        quantize_log2(log_u8, magnitudes, scale, offset);
+    }
+}
+
+std::size_t EncodedSpectrum::size() const
+{
+    switch (format)
+    {
+    case SpectrumFormat::LOG_U16: return log_u16.size();
+    case SpectrumFormat::LOG_U8: return log_u8.size();
+    default: return linear.size();
+    }
+}
+
+float EncodedSpectrum::magnitude(std::size_t i) const
+{
+    if (format == SpectrumFormat::FLOAT)
+    {
+        return linear[i];
+    }
+
+    const std::uint32_t code = format == SpectrumFormat::LOG_U16 ? log_u16[i] : log_u8[i];
+
+    // the lowest code also stands for anything quieter, down to silence
+    if (code == 0)
+    {
+        return 0.0f;
+    }
+
+    const float db = range.min_db + (range.max_db - range.min_db) * float(code) / float(max_code());
+    return std::exp2(db / db_per_log2);
+}
+
+std::uint32_t EncodedSpectrum::max_code() const
+{
+    return format == SpectrumFormat::LOG_U8
+        ? std::numeric_limits<std::uint8_t>::max()
+        : std::numeric_limits<std::uint16_t>::max();
+}
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/dsp/windowcache.hpp>
+
+#include <spiralviz/dsp/windowfuncs.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+std::vector<float> build_window_table(const WindowTableKey& key)
+{
+    std::vector<float> table(key.size);
+
+    switch (key.type)
+    {
+        case WindowType::HAMMING: {
+            populate_hamming_factors(table, key.symmetry_skew_factor);
+            break;
+        }
+        case WindowType::BLACKMAN_HARRIS: {
+            populate_blackman_harris_factors(table, key.symmetry_skew_factor);
+            break;
+        }
+        case WindowType::RECTANGLE: {
+            populate_rectangle_factors(table);
+            break;
+        }
+        default:
+        assert(false && "unsupported window type");
+    }
+
+    return table;
+}
+
+WindowTableCache& WindowTableCache::shared()
+{
+    static WindowTableCache cache;
+    return cache;
+}
+
+WindowTableCache::~WindowTableCache()
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lk{m_lock};
+        m_stop = true;
+    }
+
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+WindowTableCache::Table WindowTableCache::get(const WindowTableKey& key)
+{
+    {
+        std::lock_guard lk{m_lock};
+        for (const auto& [table_key, table] : m_tables)
+        {
+            if (table_key == key)
+            {
+                return table;
+            }
+        }
+    }
+
+    // out of the lock, so that requests of other tables do not wait
+    auto table = std::make_shared<const std::vector<float>>(build_window_table(key));
+    insert(key, table);
+    return table;
+}
+
+WindowTableCache::Table WindowTableCache::request(const WindowTableKey& key)
+{
+    {
+        std::lock_guard lk{m_lock};
+        for (const auto& [table_key, table] : m_tables)
+        {
+            if (table_key == key)
+            {
+                return table;
+            }
+        }
+
+        // e.g. the skew slider got dragged on before the previous step got
+        // built, which nobody waits on anymore
+        const auto superseded = std::find_if(m_queued_keys.begin(), m_queued_keys.end(), [&](const auto& queued) {
+            return queued.type == key.type && queued.size == key.size;
+        });
+
+        if (superseded != m_queued_keys.end())
+        {
+            *superseded = key;
+        }
+        else
+        {
+            m_queued_keys.push_back(key);
+        }
+
+        if (!m_thread.joinable())
+        {
+            m_thread = std::thread{[this] { builder_loop(); }};
+        }
+    }
+
+    m_cv.notify_one();
+    return nullptr;
+}
+
+void WindowTableCache::insert(const WindowTableKey& key, Table table)
+{
+    std::lock_guard lk{m_lock};
+
+    const auto existing = std::find_if(m_tables.begin(), m_tables.end(), [&](const auto& entry) {
+        return entry.first == key;
+    });
+
+    if (existing != m_tables.end())
+    {
+        // built twice concurrently, both are identical
+        return;
+    }
+
+    m_tables.emplace_back(key, std::move(table));
+
+    const auto is_unused = [](const auto& entry) { return entry.second.use_count() == 1; };
+
+    // the newest table is kept even if its requester did not pick it up yet
+    while (std::size_t(std::count_if(m_tables.begin(), m_tables.end() - 1, is_unused)) > max_unused_tables)
+    {
+        m_tables.erase(std::find_if(m_tables.begin(), m_tables.end() - 1, is_unused));
+    }
+}
+
+void WindowTableCache::builder_loop()
+{
+    for (;;)
+    {
+        WindowTableKey key;
+
+        {
+            std::unique_lock lk{m_lock};
+            m_cv.wait(lk, [&] { return m_stop || !m_queued_keys.empty(); });
+
+            if (m_stop)
+            {
+                return;
+            }
+
+            key = m_queued_keys.front();
+            m_queued_keys.erase(m_queued_keys.begin());
+        }
+
+        insert(key, std::make_shared<const std::vector<float>>(build_window_table(key)));
+    }
+}
@@ -6,123 +6,479 @@
 #include <algorithm>
 #include <cmath>
 #include <fftw3.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
 
-#include <spiralviz/dsp/windowfuncs.hpp>
+#include <spiralviz/dsp/kernels.hpp>
+#include <spiralviz/dsp/windowcache.hpp>
 
-FFTConfig FFTHighLevelConfig::as_fft_config([[maybe_unused]] std::size_t sample_rate) const
+namespace
 {
-    FFTConfig ret {
-        .window_size_samples = /*ms_to_samples(window_size_ms, sample_rate)*/ 32768
-    };
+constexpr std::size_t min_window_size = 1024;
+constexpr std::size_t max_window_size = std::size_t(1) << 20;
+
+/// Size closest to `ideal` on a log scale, among the even sizes made of
+/// factors of 2, 3 and 5 only.
+std::size_t fft_friendly_size(double ideal)
+{
+    std::size_t best = min_window_size;
+    double best_error = std::numeric_limits<double>::infinity();
 
-    ret.window_factors.resize(ret.window_size_samples);
-    switch (type)
+    for (std::size_t odd : {1, 3, 5, 9, 15, 25, 45, 75, 225})
     {
-        case WindowType::HAMMING: {
-            populate_hamming_factors(ret.window_factors, symmetry_skew_factor);
-            break;
+        for (std::size_t size = 2 * odd; size <= max_window_size; size *= 2)
+        {
+            const double error = std::abs(std::log(size / ideal));
+            if (size >= min_window_size && error < best_error)
+            {
+                best = size;
+                best_error = error;
+            }
         }
-        case WindowType::BLACKMAN_HARRIS: {
-            populate_blackman_harris_factors(ret.window_factors, symmetry_skew_factor);
-            break;
-        }
-        case WindowType::RECTANGLE: {
-            populate_rectangle_factors(ret.window_factors);
-            break;
-        }
-        default:
-        assert(false && "unsupported window type");
     }
 
-    return ret;
+    return best;
+}
 }
 
-WindowedFFT::WindowedFFT(FFTConfig config) noexcept :
+std::size_t FFTHighLevelConfig::window_size(std::size_t sample_rate) const
+{
+    return fft_friendly_size(std::max(double(window_size_ms), 1.0) * sample_rate / 1000.0);
+}
+
+FFTConfig FFTHighLevelConfig::as_fft_config(std::size_t sample_rate) const
+{
+    const std::size_t size = window_size(sample_rate);
+
+    return {
+        .window_size_samples = size,
+        .window_factors = make_window_factors(size)
+    };
+}
+
+std::shared_ptr<const std::vector<float>> FFTHighLevelConfig::make_window_factors(std::size_t window_size) const
+{
+    return WindowTableCache::shared().get({type, symmetry_skew_factor, window_size});
+}
+
+std::shared_ptr<const std::vector<float>> FFTHighLevelConfig::request_window_factors(std::size_t window_size) const
+{
+    return WindowTableCache::shared().request({type, symmetry_skew_factor, window_size});
+}
+
+std::mutex& fftw_planner_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+bool fftw_has_threads()
+{
+#ifdef SPIRALVIZ_HAS_FFTW_THREADS
+    static const bool initialized = [] {
+        std::lock_guard lk{fftw_planner_mutex()};
+        return fftwf_init_threads() != 0;
+    }();
+    return initialized;
+#else
+    return false;
+#endif
+}
+
+void FFTWFPlanDeleter::operator()(fftwf_plan ptr)
+{
+    std::lock_guard lk{fftw_planner_mutex()};
+    fftwf_destroy_plan(ptr);
+}
+
+FFTPlan::FFTPlan(std::size_t size, PlanRigor rigor, std::size_t batch_count, std::size_t thread_count) :
+    FFTPlan(size, rigor, batch_count, thread_count, false)
+{
+    if (m_plan == nullptr)
+    {
+        throw std::runtime_error(
+            "FFTW failed to plan a batch of " + std::to_string(batch_count)
+            + " FFTs of size " + std::to_string(size)
+        );
+    }
+}
+
+FFTPlan::FFTPlan(
+    std::size_t size,
+    PlanRigor rigor,
+    std::size_t batch_count,
+    std::size_t thread_count,
+    bool wisdom_only) :
+    m_size{size},
+    m_batch_count{batch_count},
+    m_thread_count{fftw_has_threads() ? std::max<std::size_t>(thread_count, 1) : 1},
+    m_rigor{rigor}
+{
+    unsigned flags = FFTW_ESTIMATE;
+    switch (rigor)
+    {
+    case PlanRigor::MEASURE: flags = FFTW_MEASURE; break;
+    case PlanRigor::PATIENT: flags = FFTW_PATIENT; break;
+    default: break;
+    }
+
+    // measuring overwrites the buffers, so they must be our own. Either way,
+    // the plan remembers their alignment, which will match any other buffer
+    // from fftwf_alloc_*
+    const std::size_t out_size = batch_count == 1 ? size / 2 + 1 : batch_count * output_stride(size);
+    std::unique_ptr<FFTWFloat[], FFTWFAllocDeleter> in{fftwf_alloc_real(batch_count * size)};
+    std::unique_ptr<FFTWFloat[], FFTWFAllocDeleter> real{fftwf_alloc_real(out_size)};
+    std::unique_ptr<FFTWFloat[], FFTWFAllocDeleter> imag{fftwf_alloc_real(out_size)};
+
+    // contiguous transforms of `size` reals, repeated `batch_count` times
+    const fftwf_iodim dim{.n = int(size), .is = 1, .os = 1};
+    const fftwf_iodim batch_dim{.n = int(batch_count), .is = int(size), .os = int(output_stride(size))};
+
+    const auto make_plan = [&](unsigned plan_flags) {
+        return fftwf_plan_guru_split_dft_r2c(
+            1, &dim,
+            batch_count == 1 ? 0 : 1, &batch_dim,
+            in.get(), real.get(), imag.get(),
+            plan_flags
+        );
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::lock_guard lk{fftw_planner_mutex()};
+
+#ifdef SPIRALVIZ_HAS_FFTW_THREADS
+    // global to the planner, hence set for every plan
+    if (fftw_has_threads())
+    {
+        fftwf_plan_with_nthreads(int(m_thread_count));
+    }
+#endif
+
+    if (rigor != PlanRigor::ESTIMATE)
+    {
+        // without wisdom, this fails instantly rather than measuring
+        m_plan.reset(make_plan(flags | FFTW_WISDOM_ONLY));
+        m_from_wisdom = m_plan != nullptr;
+    }
+
+    if (m_plan == nullptr && !wisdom_only)
+    {
+        m_plan.reset(make_plan(flags));
+    }
+
+    m_planning_time = std::chrono::steady_clock::now() - start;
+}
+
+std::shared_ptr<const FFTPlan> FFTPlan::from_wisdom(
+    std::size_t size,
+    PlanRigor rigor,
+    std::size_t batch_count,
+    std::size_t thread_count)
+{
+    std::shared_ptr<const FFTPlan> ret{new FFTPlan(size, rigor, batch_count, thread_count, true)};
+    return ret->m_plan != nullptr ? ret : nullptr;
+}
+
+void FFTPlan::execute(FFTWFloat* in, FFTWFloat* real, FFTWFloat* imag) const
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    // the new-array execute function is thread-safe
+    fftwf_execute_split_dft_r2c(m_plan.get(), in, real, imag);
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    m_execute_ns.fetch_add(elapsed.count(), std::memory_order_relaxed);
+    m_execute_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+double FFTPlan::mean_execute_us() const
+{
+    const std::uint64_t count = execute_count();
+    return count != 0 ? m_execute_ns.load(std::memory_order_relaxed) * 1.0e-3 / count : 0.0;
+}
+
+WindowedFFT::WindowedFFT(FFTConfig config, SampleFormat input_format, std::shared_ptr<const FFTPlan> plan) :
     m_config{std::move(config)},
-    m_sample_buffer(m_config.window_size_samples),
+    m_input_format{input_format},
+    m_sample_buffer(input_format == SampleFormat::F32 ? m_config.window_size_samples : 0),
+    m_sample_buffer_s16(input_format == SampleFormat::S16 ? m_config.window_size_samples : 0),
     m_fft_in_buffer{fftwf_alloc_real(m_config.window_size_samples)},
-    m_fft_out_buffer{fftwf_alloc_complex(m_config.window_size_samples)},
-    m_fft_plan{fftwf_plan_dft_r2c_1d(
-        m_config.window_size_samples,
-        m_fft_in_buffer.get(),
-        m_fft_out_buffer.get(),
-        FFTW_ESTIMATE
-    )}
-{}
-
-void WindowedFFT::left_shift_sample_buffer(std::size_t by)
+    m_fft_real_buffer{fftwf_alloc_real(m_config.window_size_samples / 2 + 1)},
+    m_fft_imag_buffer{fftwf_alloc_real(m_config.window_size_samples / 2 + 1)},
+    m_fft_plan{
+        plan != nullptr && plan->size() == m_config.window_size_samples
+        ? std::move(plan)
+        : std::make_shared<const FFTPlan>(m_config.window_size_samples)
+    }
 {
-    std::move_backward(
-        m_sample_buffer.begin() + by,
-        m_sample_buffer.end(),
-        m_sample_buffer.end() - by
-    );
+    // prefault the buffers now rather than on the first transform, which also
+    // makes them resident before memory gets locked
+    std::fill_n(m_fft_in_buffer.get(), m_config.window_size_samples, 0.0f);
+    std::fill_n(m_fft_real_buffer.get(), m_config.window_size_samples / 2 + 1, 0.0f);
+    std::fill_n(m_fft_imag_buffer.get(), m_config.window_size_samples / 2 + 1, 0.0f);
 }
 
-void WindowedFFT::populate_fft_buffer()
+void WindowedFFT::populate_fft_buffer(std::span<float> fft_in)
 {
-    for (std::size_t i = 0; i < m_sample_buffer.size(); ++i)
+    const std::span<const float> window{*m_config.window_factors};
+
+    // the oldest samples start at the cursor, so the window gets applied to
+    // both segments of the history in place
+    const std::size_t oldest_count = m_config.window_size_samples - m_write_pos;
+
+    const auto multiply = [&](auto apply_segment) {
+        apply_segment(fft_in.first(oldest_count), window.first(oldest_count), m_write_pos, oldest_count);
+        apply_segment(fft_in.last(m_write_pos), window.last(m_write_pos), 0, m_write_pos);
+    };
+
+    if (m_input_format == SampleFormat::S16)
+    {
+        multiply([&](std::span<float> out, std::span<const float> factors, std::size_t offset, std::size_t count) {
+            window_multiply_s16(out, factors, std::span{m_sample_buffer_s16}.subspan(offset, count), s16_sample_scale);
+        });
+    }
+    else
     {
-        m_fft_in_buffer[i] = m_config.window_factors[i] * m_sample_buffer[i];
+        multiply([&](std::span<float> out, std::span<const float> factors, std::size_t offset, std::size_t count) {
+            window_multiply(out, factors, std::span{m_sample_buffer}.subspan(offset, count));
+        });
     }
 }
 
 void WindowedFFT::clear()
 {
     std::fill(m_sample_buffer.begin(), m_sample_buffer.end(), 0);
+    std::fill(m_sample_buffer_s16.begin(), m_sample_buffer_s16.end(), 0);
+    m_write_pos = 0;
 }
 
-void WindowedFFT::update_from_config(const FFTConfig& config)
+void WindowedFFT::update_from_config(const FFTConfig& config, std::shared_ptr<const FFTPlan> plan)
 {
-    if (config.window_size_samples != m_config.window_size_samples)
+    if (config.window_size_samples == m_config.window_size_samples)
     {
-        // need to recreate the FFT plan, so just recreate the object
-        (*this) = {config};
+        m_config = config;
         return;
     }
 
-    m_config = config;
+    WindowedFFT resized{config, m_input_format, std::move(plan)};
+
+    // copies the newest samples in order to the end of the new history, so
+    // that its oldest sample is at 0 where the next one gets written
+    const auto carry_over = [&](const auto& from, auto& to) {
+        const std::size_t count = std::min(from.size(), to.size());
+        const std::size_t start = (m_write_pos + from.size() - count) % from.size();
+        const std::size_t until_end = std::min(count, from.size() - start);
+
+        auto out = std::copy_n(from.begin() + start, until_end, to.end() - count);
+        std::copy_n(from.begin(), count - until_end, out);
+    };
+
+    if (m_input_format == SampleFormat::S16)
+    {
+        carry_over(m_sample_buffer_s16, resized.m_sample_buffer_s16);
+    }
+    else
+    {
+        carry_over(m_sample_buffer, resized.m_sample_buffer);
+    }
+
+    *this = std::move(resized);
+}
+
+void WindowedFFT::set_plan(std::shared_ptr<const FFTPlan> plan)
+{
+    assert(plan != nullptr && plan->size() == m_config.window_size_samples);
+    m_fft_plan = std::move(plan);
 }
 
 std::span<float> WindowedFFT::consume_samples(std::span<const FFTInSample> incoming)
 {
     assert(incoming.size() < m_config.window_size_samples);
 
-    left_shift_sample_buffer(incoming.size());
+    push_samples(incoming);
+    return compute();
+}
+
+void WindowedFFT::push_samples(std::span<const FFTInSample> incoming)
+{
+    push_samples(SampleSpan{incoming});
+}
+
+void WindowedFFT::push_samples(SampleSpan incoming)
+{
+    const std::size_t window_size = m_config.window_size_samples;
+
+    if (incoming.size() > window_size)
+    {
+        incoming = incoming.last(window_size);
+    }
+
+    // overwrites the oldest samples, wrapping around the end of the history
+    const std::size_t until_end = std::min(incoming.size(), window_size - m_write_pos);
+    const std::size_t wrapped = incoming.size() - until_end;
+
+    const auto write = [&](auto& buffer) {
+        copy_samples(incoming.first(until_end), std::span{buffer}.subspan(m_write_pos, until_end));
+        copy_samples(incoming.last(wrapped), std::span{buffer}.first(wrapped));
+    };
+
+    if (m_input_format == SampleFormat::S16)
+    {
+        write(m_sample_buffer_s16);
+    }
+    else
+    {
+        write(m_sample_buffer);
+    }
+
+    m_write_pos = (m_write_pos + incoming.size()) % window_size;
+}
+
+std::span<float> WindowedFFT::compute()
+{
+    transform();
+    return magnitudes();
+}
+
+void WindowedFFT::transform()
+{
+    populate_fft_buffer({m_fft_in_buffer.get(), m_config.window_size_samples});
+    m_fft_plan->execute(m_fft_in_buffer.get(), m_fft_real_buffer.get(), m_fft_imag_buffer.get());
+}
+
+SplitComplexSpan WindowedFFT::spectrum() const
+{
+    return {
+        .real = {m_fft_real_buffer.get(), output_size()},
+        .imag = {m_fft_imag_buffer.get(), output_size()}
+    };
+}
+
+float WindowedFFT::magnitude_scale() const
+{
+    // there seems to be more than one way to normalize the output of a DFT,
+    // and I am not really qualified enough in DSP to tell which is the
+    // best.
+    //
+    // however, dividing by sqrt(N) rather than N yields more sensible
+    // values for our use, so let's use that?
+    // the proper answer might also depend on the fact we're using a window
+    // function...
+    //
+    // found some discussion here:
+    // https://dsp.stackexchange.com/questions/63001/why-should-i-scale-the-fft-using-1-n
+    return 1.0f / std::sqrt(float(output_size()));
+}
+
+std::span<float> WindowedFFT::magnitudes()
+{
+    return magnitudes(0, output_size());
+}
+
+std::span<float> WindowedFFT::magnitudes(std::size_t first_bin, std::size_t bin_count)
+{
+    assert(first_bin + bin_count <= output_size());
+
+    const std::span<float> output{m_fft_real_buffer.get() + first_bin, bin_count};
+
+    complex_magnitudes(output, spectrum().subspan(first_bin, bin_count), magnitude_scale());
+
+    return output;
+}
+
+void WindowedFFT::set_batch_plan(std::shared_ptr<const FFTPlan> plan)
+{
+    const bool same_layout = m_batch_plan != nullptr && plan != nullptr
+        && m_batch_plan->batch_count() == plan->batch_count();
+
+    m_batch_plan = std::move(plan);
+
+    if (same_layout)
+    {
+        // e.g. a better plan, the slots stay as they are
+        return;
+    }
+
+    if (m_batch_plan == nullptr)
+    {
+        m_batch_in_buffer.reset();
+        m_batch_real_buffer.reset();
+        m_batch_imag_buffer.reset();
+        return;
+    }
+
+    assert(m_batch_plan->size() == m_config.window_size_samples);
 
-    std::copy(
-        incoming.begin(),
-        incoming.end(),
-        m_sample_buffer.end() - incoming.size()
-    );
+    const std::size_t in_size = m_batch_plan->batch_count() * m_config.window_size_samples;
+    const std::size_t out_size = m_batch_plan->batch_count() * FFTPlan::output_stride(m_config.window_size_samples);
+
+    // as with the regular buffers, prefault them right away
+    m_batch_in_buffer.reset(fftwf_alloc_real(in_size));
+    m_batch_real_buffer.reset(fftwf_alloc_real(out_size));
+    m_batch_imag_buffer.reset(fftwf_alloc_real(out_size));
+    std::fill_n(m_batch_in_buffer.get(), in_size, 0.0f);
+    std::fill_n(m_batch_real_buffer.get(), out_size, 0.0f);
+    std::fill_n(m_batch_imag_buffer.get(), out_size, 0.0f);
+}
 
-    populate_fft_buffer();
-    fftwf_execute(m_fft_plan.get());
+void WindowedFFT::stage_batch(std::size_t slot)
+{
+    assert(slot < batch_capacity());
 
-    // assuming no UB from the use of this cast(?), "theoretically" safe
-    // as far as the writes go
-    float* float_out_buffer = reinterpret_cast<float*>(m_fft_out_buffer.get());
+    const std::size_t window_size = m_config.window_size_samples;
+    populate_fft_buffer({m_batch_in_buffer.get() + slot * window_size, window_size});
+}
 
-    const std::size_t final_output_size = m_config.window_size_samples / 2 - 1;
+void WindowedFFT::transform_batch(std::size_t count)
+{
+    assert(count <= batch_capacity());
 
-    for (std::size_t i = 0; i < final_output_size; ++i)
+    if (count == batch_capacity())
     {
-        const auto [real, imag] = m_fft_out_buffer[i];
-        const auto amplitude = std::sqrt(real*real + imag*imag);
+        m_batch_plan->execute(m_batch_in_buffer.get(), m_batch_real_buffer.get(), m_batch_imag_buffer.get());
+        return;
+    }
 
-        // there seems to be more than one way to normalize the output of a DFT,
-        // and I am not really qualified enough in DSP to tell which is the
-        // best.
-        //
-        // however, dividing by sqrt(N) rather than N yields more sensible
-        // values for our use, so let's use that?
-        // the proper answer might also depend on the fact we're using a window
-        // function...
-        //
-        // found some discussion here:
-        // https://dsp.stackexchange.com/questions/63001/why-should-i-scale-the-fft-using-1-n
-        float_out_buffer[i] = amplitude / std::sqrt(final_output_size);
+    // slots are as aligned as the start of the buffers, see `FFTPlan`, which
+    // the regular plan requires
+    const std::size_t window_size = m_config.window_size_samples;
+    const std::size_t stride = FFTPlan::output_stride(window_size);
+
+    for (std::size_t slot = 0; slot < count; ++slot)
+    {
+        m_fft_plan->execute(
+            m_batch_in_buffer.get() + slot * window_size,
+            m_batch_real_buffer.get() + slot * stride,
+            m_batch_imag_buffer.get() + slot * stride
+        );
     }
+}
+
+SplitComplexSpan WindowedFFT::batch_spectrum(std::size_t slot) const
+{
+    const std::size_t offset = slot * FFTPlan::output_stride(m_config.window_size_samples);
+
+    return {
+        .real = {m_batch_real_buffer.get() + offset, output_size()},
+        .imag = {m_batch_imag_buffer.get() + offset, output_size()}
+    };
+}
+
+std::span<float> WindowedFFT::batch_magnitudes(std::size_t slot)
+{
+    return batch_magnitudes(slot, 0, output_size());
+}
+
+std::span<float> WindowedFFT::batch_magnitudes(std::size_t slot, std::size_t first_bin, std::size_t bin_count)
+{
+    assert(first_bin + bin_count <= output_size());
+
+    const std::size_t offset = slot * FFTPlan::output_stride(m_config.window_size_samples) + first_bin;
+    const std::span<float> output{m_batch_real_buffer.get() + offset, bin_count};
+
+    complex_magnitudes(output, batch_spectrum(slot).subspan(first_bin, bin_count), magnitude_scale());
 
-    return std::span{float_out_buffer, final_output_size};
+    return output;
 }
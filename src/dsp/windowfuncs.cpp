@@ -3,32 +3,99 @@
 
 #include <spiralviz/dsp/windowfuncs.hpp>
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <numbers>
 
 constexpr auto pi = std::numbers::pi;
 
-void populate_hamming_factors(std::span<float> factors, float alpha)
+namespace
 {
-    for (std::size_t i = 0; i < factors.size(); ++i)
+// The rotation recurrence gets reseeded from exact values this often, which
+// keeps its rounding errors far below float precision
+constexpr std::size_t recurrence_reseed_interval = 256;
+
+/// Fills `factors` with `sum_k (-1)^k coefficients[k] cos(2 pi k x)`, where
+/// `x = (i / (N - 1))^alpha`.
+///
+/// The harmonics come from the Chebyshev recurrence
+/// `cos((k + 1) t) = 2 cos(t) cos(k t) - cos((k - 1) t)`, so that each sample
+/// takes a single cosine. Without skew, `x` is linear in `i` and even that
+/// cosine comes from rotating the previous one.
+template<std::size_t Terms>
+void populate_cosine_sum_factors(std::span<float> factors, float alpha, const std::array<double, Terms>& coefficients)
+{
+    const std::size_t size = factors.size();
+
+    const auto evaluate = [&](double c1) {
+        double value = coefficients[0];
+        double previous = 1.0;
+        double current = c1;
+        double sign = -1.0;
+
+        for (std::size_t k = 1; k < Terms; ++k)
+        {
+            value += sign * coefficients[k] * current;
+
+            const double next = 2.0 * c1 * current - previous;
+            previous = current;
+            current = next;
+            sign = -sign;
+        }
+
+        return float(value);
+    };
+
+    if (size < 2)
     {
-        const double x = std::pow(double(i) / (factors.size() - 1), alpha);
-        factors[i] = 0.54 - (0.46 * std::cos(2.0 * pi * x));
+        std::fill(factors.begin(), factors.end(), evaluate(1.0));
+        return;
     }
+
+    const double step = 2.0 * pi / double(size - 1);
+
+    if (alpha != 1.0f)
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            const double x = std::pow(double(i) / (size - 1), alpha);
+            factors[i] = evaluate(std::cos(2.0 * pi * x));
+        }
+        return;
+    }
+
+    const double step_cos = std::cos(step);
+    const double step_sin = std::sin(step);
+
+    double c = 1.0;
+    double s = 0.0;
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (i % recurrence_reseed_interval == 0)
+        {
+            c = std::cos(step * double(i));
+            s = std::sin(step * double(i));
+        }
+
+        factors[i] = evaluate(c);
+
+        const double next_c = c * step_cos - s * step_sin;
+        s = s * step_cos + c * step_sin;
+        c = next_c;
+    }
+}
+}
+
+void populate_hamming_factors(std::span<float> factors, float alpha)
+{
+    populate_cosine_sum_factors<2>(factors, alpha, {0.54, 0.46});
 }
 
 void populate_blackman_harris_factors(std::span<float> factors, float alpha)
 {
-    for (std::size_t i = 0; i < factors.size(); ++i)
-    {
-        const double x = std::pow(double(i) / (factors.size() - 1), alpha);
-        factors[i] = (
-            0.35875
-            - (0.48829 * std::cos(2.0 * pi * x))
-            + (0.14128 * std::cos(4.0 * pi * x))
-            - (0.01168 * std::cos(6.0 * pi * x))
-        );
-    }
+    populate_cosine_sum_factors<4>(factors, alpha, {0.35875, 0.48829, 0.14128, 0.01168});
 }
 
 void populate_rectangle_factors(std::span<float> factors)
@@ -37,4 +104,4 @@ void populate_rectangle_factors(std::span<float> factors)
     {
         factors[i] = 1.0f;
     }
-}
\ No newline at end of file
+}
@@ -3,32 +3,1088 @@
 
 #include <spiralviz/fftstreamer.hpp>
 
-FFTStreamer::FFTStreamer(FFTHighLevelConfig config, std::size_t sample_rate) :
-    m_fft{config.as_fft_config(sample_rate)}
+#include <spiralviz/dsp/kernels.hpp>
+#include <spiralviz/dsp/util.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+std::size_t pool_worker_count(std::size_t channel_count)
+{
+    // the calling thread participates, so one less worker than channels
+    const std::size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    return std::min(channel_count, cores) - 1;
+}
+
+/// Transform size of the sliding DFT matching a linear FFT of
+/// `reference_size`. It indexes its tables by masking, so it takes the
+/// nearest power of two.
+std::size_t sliding_dft_size(std::size_t reference_size)
 {
-    m_recorder.start(sample_rate);
+    return std::bit_floor(reference_size + reference_size / 2);
+}
+
+// Below this, handing an FFT over to other threads costs about as much as it
+// saves
+constexpr std::size_t min_threaded_fft_size = 32768;
+}
+
+FFTStreamer::FFTStreamer(
+    std::unique_ptr<SampleSource> source,
+    FFTHighLevelConfig config,
+    ResamplingConfig resampling,
+    PlanningConfig planning) :
+    m_source{std::move(source)},
+    m_hl_config{config},
+    m_applied_window_ms{config.window_size_ms},
+    m_analysis_rate{resampling.analysis_rate != 0 ? resampling.analysis_rate : m_source->sample_rate()},
+    m_resampled(m_source->channel_count()),
+    m_planner{std::move(planning)},
+    m_channel_magnitudes(m_source->channel_count()),
+    m_last_update{std::chrono::steady_clock::now()},
+    m_pool{pool_worker_count(m_source->channel_count())}
+{
+    if (m_analysis_rate != m_source->sample_rate())
+    {
+        for (std::size_t i = 0; i < m_source->channel_count(); ++i)
+        {
+            m_resamplers.emplace_back(m_source->sample_rate(), m_analysis_rate, resampling.stopband_db);
+        }
+    }
+
+    // resampled samples come out as floats
+    const SampleFormat fft_format = is_resampling() ? SampleFormat::F32 : m_source->format();
+
+    const FFTConfig fft_config = config.as_fft_config(m_analysis_rate);
+    m_plan = m_planner.plan(fft_config.window_size_samples, 1, fft_thread_count(fft_config.window_size_samples));
+
+    m_channel_ffts.reserve(m_source->channel_count());
+    for (std::size_t i = 0; i < m_source->channel_count(); ++i)
+    {
+        m_channel_ffts.emplace_back(fft_config, fft_format, m_plan);
+    }
 }
 
-FFTStreamer::~FFTStreamer()
+std::span<float> FFTStreamer::update_fft()
 {
-    m_recorder.stop();
+    const std::size_t due = apply_backlog_policy();
+
+    if (due == 0)
+    {
+        return {};
+    }
+
+    return update_fft(due);
 }
 
 std::span<float> FFTStreamer::update_fft(std::size_t samples_to_load)
 {
-    if (samples_to_load >= m_fft.config().window_size_samples)
+    swap_in_upgraded_plan();
+    swap_in_window_config();
+    swap_in_batch_plan();
+
+    if (m_engine_pending)
+    {
+        rebuild_engine_spectra();
+    }
+
+    // at most a window's worth of input can matter, plus what the resampler
+    // needs to settle
+    std::size_t max_useful_samples = config().window_size_samples;
+    if (is_resampling())
+    {
+        max_useful_samples = max_useful_samples * m_source->sample_rate() / m_analysis_rate
+            + m_resamplers.front().taps_per_phase();
+    }
+
+    const bool batching = m_batch_plan != nullptr;
+
+    if (batching)
+    {
+        // the windows of the older hops of the batch reach further back
+        max_useful_samples += (m_batch_plan->batch_count() - 1) * m_hop_size;
+    }
+
+    if (!m_engine_spectra.empty())
+    {
+        // e.g. the lowest band of the multi-resolution engine sees a longer
+        // stretch of input
+        std::size_t engine_history = m_engine_spectra.front()->history_size();
+        if (is_resampling())
+        {
+            engine_history = engine_history * m_source->sample_rate() / m_analysis_rate
+                + m_resamplers.front().taps_per_phase();
+        }
+
+        max_useful_samples = std::max(max_useful_samples, engine_history);
+    }
+
+    if (samples_to_load > max_useful_samples)
     {
         // discard what we will be unable to use, max out count to the FFT size
-        m_recorder.discard_n_oldest(m_fft.config().window_size_samples - samples_to_load);
-        samples_to_load = m_fft.config().window_size_samples;
+        m_source->discard(samples_to_load - max_useful_samples);
+        samples_to_load = max_useful_samples;
+    }
+
+    // the data might be split in two if it wraps around the end of a queue.
+    // Samples keep arriving meanwhile, so every channel gets peeked for the
+    // same count, or they would drift apart.
+    std::vector<SampleViews> views(channel_count());
+    views.front() = m_source->peek(0, std::min(samples_to_load, m_source->available()));
+
+    // a source made of several segments may return less than asked for
+    const std::size_t loaded = views.front().size();
+
+    for (std::size_t i = 1; i < channel_count(); ++i)
+    {
+        views[i] = m_source->peek(i, loaded);
+    }
+
+    if (loaded == 0)
+    {
+        return {};
+    }
+
+    if (is_resampling())
+    {
+        // every channel has its own filter state, so they can go in parallel
+        m_pool.parallel_for(channel_count(), [&](std::size_t i) {
+            m_resampled[i].clear();
+            m_resamplers[i].process(views[i].first, m_resampled[i]);
+            m_resamplers[i].process(views[i].second, m_resampled[i]);
+
+            if (!batching)
+            {
+                m_channel_ffts[i].push_samples(std::span<const float>{m_resampled[i]});
+            }
+
+            if (!m_engine_spectra.empty())
+            {
+                m_engine_spectra[i]->push_samples(std::span<const float>{m_resampled[i]});
+            }
+        });
+    }
+    else
+    {
+        // feed the FFTs straight from the source
+        for (std::size_t i = 0; i < channel_count() && !batching; ++i)
+        {
+            m_channel_ffts[i].push_samples(views[i].first);
+            m_channel_ffts[i].push_samples(views[i].second);
+        }
+
+        if (!m_engine_spectra.empty())
+        {
+            m_pool.parallel_for(channel_count(), [&](std::size_t i) {
+                m_engine_spectra[i]->push_samples(views[i].first);
+                m_engine_spectra[i]->push_samples(views[i].second);
+            });
+        }
+    }
+
+    if (m_engine_mix)
+    {
+        push_engine_mix(views);
+    }
+
+    const bool mixing = m_selection.mix != ChannelMix::CHANNEL;
+
+    // channels whose spectrum is required, and whether they also need their
+    // own magnitudes
+    std::vector<std::size_t> transformed;
+    for (std::size_t i = 0; i < channel_count(); ++i)
+    {
+        const bool selected = mixing ? i < 2 : i == m_selection.channel;
+        if (selected || m_analyze_all_channels)
+        {
+            transformed.push_back(i);
+        }
+    }
+
+    // in batch mode, the FFTs get fed one hop at a time, with the window of
+    // each of the newest hops staged for a single batched transform
+    std::size_t hop_count = 0;
+
+    if (batching)
+    {
+        const std::size_t fed = is_resampling() ? m_resampled.front().size() : loaded;
+        const std::size_t fft_hop = std::max<std::size_t>(m_hop_size * m_analysis_rate / m_source->sample_rate(), 1);
+        hop_count = std::min(m_batch_plan->batch_count(), fed / fft_hop);
+
+        // samples [offset, offset + count) of a channel, as fed to its FFT
+        const auto push = [&](std::size_t channel, std::size_t offset, std::size_t count) {
+            WindowedFFT& fft = m_channel_ffts[channel];
+
+            if (is_resampling())
+            {
+                fft.push_samples(std::span<const float>{m_resampled[channel]}.subspan(offset, count));
+                return;
+            }
+
+            const SampleViews& view = views[channel];
+            if (offset < view.first.size())
+            {
+                const std::size_t from_first = std::min(count, view.first.size() - offset);
+                fft.push_samples(view.first.subspan(offset, from_first));
+                offset += from_first;
+                count -= from_first;
+            }
+
+            if (count != 0)
+            {
+                fft.push_samples(view.second.subspan(offset - view.first.size(), count));
+            }
+        };
+
+        m_pool.parallel_for(channel_count(), [&](std::size_t i) {
+            const bool staged = hop_count > 1
+                && std::find(transformed.begin(), transformed.end(), i) != transformed.end();
+
+            if (!staged)
+            {
+                push(i, 0, fed);
+                return;
+            }
+
+            const std::size_t lead = fed - hop_count * fft_hop;
+            push(i, 0, lead);
+
+            for (std::size_t hop = 0; hop < hop_count; ++hop)
+            {
+                push(i, lead + hop * fft_hop, fft_hop);
+                m_channel_ffts[i].stage_batch(hop);
+            }
+        });
+    }
+
+    m_source->consume(loaded);
+
+    m_latest_capture_time = m_source->last_capture_time();
+    if (m_latest_capture_time && is_resampling())
+    {
+        // the filter is linear-phase, and delays its output by half its length
+        const double delay_s = 0.5 * m_resamplers.front().taps_per_phase() / m_source->sample_rate();
+        *m_latest_capture_time -= std::chrono::duration_cast<CaptureClock::duration>(std::chrono::duration<double>(delay_s));
+    }
+
+    if (!m_engine_spectra.empty())
+    {
+        m_latest = compute_engine_spectra(transformed);
+        m_hop_magnitudes.assign(1, m_latest);
+        return m_latest;
+    }
+
+    if (hop_count > 1)
+    {
+        m_latest = transform_hops(transformed, hop_count);
+        return m_latest;
+    }
+
+    m_pool.parallel_for(transformed.size(), [&](std::size_t i) {
+        m_channel_ffts[transformed[i]].transform();
+    });
+
+    m_visible_bins = visible_bins({}, m_channel_ffts.front().output_size());
+    const BinSlice bins = m_visible_bins;
+
+    if (mixing)
+    {
+        // must happen before the magnitudes get written over the spectra
+        const WindowedFFT& left = m_channel_ffts[0];
+        const WindowedFFT& right = m_channel_ffts[1];
+        const float side_sign = m_selection.mix == ChannelMix::SIDE ? -1.0f : 1.0f;
+
+        m_mix_magnitudes.resize(bins.count);
+        complex_mix_magnitudes(
+            m_mix_magnitudes,
+            left.spectrum().subspan(bins.first, bins.count),
+            right.spectrum().subspan(bins.first, bins.count),
+            0.5f,
+            0.5f * side_sign,
+            left.magnitude_scale()
+        );
+    }
+
+    std::fill(m_channel_magnitudes.begin(), m_channel_magnitudes.end(), std::span<float>{});
+
+    if (!mixing || m_analyze_all_channels)
+    {
+        m_pool.parallel_for(transformed.size(), [&](std::size_t i) {
+            const std::size_t channel = transformed[i];
+            m_channel_magnitudes[channel] = m_channel_ffts[channel].magnitudes(bins.first, bins.count);
+        });
+    }
+
+    m_latest = mixing ? std::span<float>{m_mix_magnitudes} : m_channel_magnitudes[m_selection.channel];
+    m_hop_magnitudes.assign(1, m_latest);
+    return m_latest;
+}
+
+std::span<float> FFTStreamer::transform_hops(const std::vector<std::size_t>& transformed, std::size_t hop_count)
+{
+    const bool mixing = m_selection.mix != ChannelMix::CHANNEL;
+
+    m_pool.parallel_for(transformed.size(), [&](std::size_t i) {
+        m_channel_ffts[transformed[i]].transform_batch(hop_count);
+    });
+
+    m_hop_magnitudes.resize(hop_count);
+
+    m_visible_bins = visible_bins({}, m_channel_ffts.front().output_size());
+    const BinSlice bins = m_visible_bins;
+
+    if (mixing)
+    {
+        // only grows, so that the buffers get reused
+        if (m_hop_mix_magnitudes.size() < hop_count)
+        {
+            m_hop_mix_magnitudes.resize(hop_count);
+        }
+
+        const WindowedFFT& left = m_channel_ffts[0];
+        const WindowedFFT& right = m_channel_ffts[1];
+        const float side_sign = m_selection.mix == ChannelMix::SIDE ? -1.0f : 1.0f;
+
+        for (std::size_t hop = 0; hop < hop_count; ++hop)
+        {
+            m_hop_mix_magnitudes[hop].resize(bins.count);
+            complex_mix_magnitudes(
+                m_hop_mix_magnitudes[hop],
+                left.batch_spectrum(hop).subspan(bins.first, bins.count),
+                right.batch_spectrum(hop).subspan(bins.first, bins.count),
+                0.5f,
+                0.5f * side_sign,
+                left.magnitude_scale()
+            );
+            m_hop_magnitudes[hop] = m_hop_mix_magnitudes[hop];
+        }
+    }
+
+    std::fill(m_channel_magnitudes.begin(), m_channel_magnitudes.end(), std::span<float>{});
+
+    if (!mixing || m_analyze_all_channels)
+    {
+        m_pool.parallel_for(transformed.size(), [&](std::size_t i) {
+            const std::size_t channel = transformed[i];
+            const bool selected = !mixing && channel == m_selection.channel;
+
+            for (std::size_t hop = 0; hop < hop_count; ++hop)
+            {
+                m_channel_magnitudes[channel] = m_channel_ffts[channel].batch_magnitudes(hop, bins.first, bins.count);
+
+                if (selected)
+                {
+                    m_hop_magnitudes[hop] = m_channel_magnitudes[channel];
+                }
+            }
+        });
+    }
+
+    return mixing ? std::span<float>{m_hop_mix_magnitudes[hop_count - 1]} : m_channel_magnitudes[m_selection.channel];
+}
+
+void FFTStreamer::push_engine_mix(const std::vector<SampleViews>& views)
+{
+    const auto to_float = [](const SampleViews& view, std::vector<float>& out) {
+        out.resize(view.size());
+        copy_samples(view.first, std::span{out}.first(view.first.size()));
+        copy_samples(view.second, std::span{out}.last(view.second.size()));
+        return std::span<const float>{out};
+    };
+
+    // resampled samples already are floats
+    const std::span<const float> l = is_resampling() ? std::span<const float>{m_resampled[0]} : to_float(views[0], m_mix_left);
+    const std::span<const float> r = is_resampling() ? std::span<const float>{m_resampled[1]} : to_float(views[1], m_mix_right);
+
+    const float side_sign = m_selection.mix == ChannelMix::SIDE ? -1.0f : 1.0f;
+
+    m_mix_samples.resize(l.size());
+    for (std::size_t i = 0; i < l.size(); ++i)
+    {
+        m_mix_samples[i] = 0.5f * l[i] + 0.5f * side_sign * r[i];
+    }
+
+    m_engine_mix->push_samples(std::span<const float>{m_mix_samples});
+}
+
+std::span<float> FFTStreamer::compute_engine_spectra(const std::vector<std::size_t>& transformed)
+{
+    const bool mixing = m_selection.mix != ChannelMix::CHANNEL;
+
+    // bands count their hops at the analysis rate
+    const std::size_t hop = m_hop_size * m_analysis_rate / m_source->sample_rate();
+
+    std::fill(m_channel_magnitudes.begin(), m_channel_magnitudes.end(), std::span<float>{});
+
+    if (!mixing || m_analyze_all_channels)
+    {
+        m_pool.parallel_for(transformed.size(), [&](std::size_t i) {
+            const std::size_t channel = transformed[i];
+            m_channel_magnitudes[channel] = m_engine_spectra[channel]->compute(hop);
+        });
+    }
+
+    const std::span<float> output = mixing ? m_engine_mix->compute(hop) : m_channel_magnitudes[m_selection.channel];
+
+    // the engines always compute every bin, but only the visible ones get
+    // handed over
+    m_visible_bins = visible_bins(m_engine_spectra.front()->layout(), output.size());
+
+    for (std::span<float>& magnitudes : m_channel_magnitudes)
+    {
+        if (!magnitudes.empty())
+        {
+            magnitudes = magnitudes.subspan(m_visible_bins.first, m_visible_bins.count);
+        }
+    }
+
+    return output.subspan(m_visible_bins.first, m_visible_bins.count);
+}
+
+FFTStreamer::BinSlice FFTStreamer::visible_bins(const SpectrumLayout& layout, std::size_t full_size) const
+{
+    if (full_size == 0)
+    {
+        return {};
+    }
+
+    double low_bin, high_bin;
+
+    if (layout.scale == SpectrumScale::CENTS)
+    {
+        const auto to_bin = [&](double frequency) {
+            return std::log2(frequency / layout.min_frequency) * cents_per_octave / layout.cents_per_bin;
+        };
+
+        low_bin = to_bin(m_visible_range.low);
+        high_bin = to_bin(m_visible_range.high);
     }
+    else
+    {
+        // bins are spread from 0 Hz to the Nyquist frequency, as displayed
+        const double bins_per_hz = full_size / (m_analysis_rate / 2.0);
+        low_bin = m_visible_range.low * bins_per_hz;
+        high_bin = m_visible_range.high * bins_per_hz;
+    }
+
+    // the display interpolates between neighboring bins, so keep one more on
+    // either side
+    const double size = double(full_size);
+    const std::size_t first = std::size_t(std::clamp(std::floor(low_bin) - 1.0, 0.0, size - 1.0));
+    const std::size_t last = std::size_t(std::clamp(std::ceil(high_bin) + 1.0, double(first + 1), size));
+
+    return {.first = first, .count = last - first, .full_size = full_size};
+}
+
+std::size_t FFTStreamer::apply_backlog_policy()
+{
+    const auto now = std::chrono::steady_clock::now();
+    const double since_last_update_s = std::chrono::duration<double>(now - m_last_update).count();
+    m_last_update = now;
+
+    const std::size_t hop = m_hop_size;
+    const auto whole_hops = [hop](std::size_t count) { return count - count % hop; };
+
+    const std::size_t available = m_source->available();
+    const std::size_t budget = ms_to_samples(m_backlog_config.max_backlog_ms, m_source->sample_rate());
+    const bool over_budget = m_backlog_config.policy != BacklogPolicy::UNBOUNDED && available > budget;
+
+    m_backlog_stats.peak_backlog = std::max(m_backlog_stats.peak_backlog, available);
+
+    if (over_budget)
+    {
+        // the backlog must have gone over budget at some point since the last
+        // update; there is no way to tell when exactly
+        m_backlog_stats.time_over_budget_s += since_last_update_s;
+    }
+
+    std::size_t remaining = available;
+
+    const auto drop = [&](std::size_t count) {
+        const std::size_t dropped = m_source->discard(count);
+        m_backlog_stats.dropped_samples += dropped;
+        remaining -= dropped;
+    };
+
+    std::size_t due = 0;
+
+    switch (m_backlog_config.policy)
+    {
+    case BacklogPolicy::DROP_OLDEST:
+    {
+        if (over_budget)
+        {
+            drop(available - budget);
+        }
+
+        due = whole_hops(remaining);
+        break;
+    }
+    case BacklogPolicy::SKIP_TO_LIVE:
+    {
+        if (over_budget && whole_hops(available) > hop)
+        {
+            drop(whole_hops(available) - hop);
+        }
+
+        due = whole_hops(remaining);
+        break;
+    }
+    case BacklogPolicy::TIME_STRETCH:
+    {
+        m_catching_up = m_catching_up || over_budget;
+
+        if (!m_catching_up)
+        {
+            due = whole_hops(remaining);
+            break;
+        }
+
+        if (available > 2 * budget)
+        {
+            drop(available - 2 * budget);
+        }
+
+        // wall time only serves as a reference for the catch-up speed
+        const double max_advance = since_last_update_s
+            * m_backlog_config.max_catchup_rate
+            * m_source->sample_rate();
+
+        due = std::min(whole_hops(remaining), std::max(hop, whole_hops(std::size_t(max_advance))));
+        m_catching_up = remaining - due > hop;
+        break;
+    }
+    case BacklogPolicy::UNBOUNDED:
+    default:
+    {
+        due = whole_hops(remaining);
+        break;
+    }
+    }
+
+    m_backlog_stats.backlog = remaining - due;
+
+    return due;
+}
 
-    m_recorder.consume_n_oldest(m_sample_buffer, samples_to_load);
+void FFTStreamer::update_from_config(const FFTHighLevelConfig& config)
+{
+    m_hl_config = config;
+    m_window_pending = true;
+    m_window_error.clear();
+
+    // applies right away if the table is cached
+    swap_in_window_config();
+}
 
-    if (m_sample_buffer.size() > 0)
+void FFTStreamer::swap_in_window_config()
+{
+    if (!m_window_pending)
     {
-        return m_fft.consume_samples(m_sample_buffer);
+        return;
     }
 
-    return {};
-}
\ No newline at end of file
+    const std::size_t window_size = m_hl_config.window_size(m_analysis_rate);
+    auto window_factors = m_hl_config.request_window_factors(window_size);
+
+    const bool resizing = window_size != m_plan->size();
+    const bool batching = m_batch_hops > 1 && m_engine == SpectrumEngine::LINEAR_FFT;
+
+    const auto is_ready = [&](const std::shared_ptr<const FFTPlan>& plan, std::size_t batch_count) {
+        return plan != nullptr && plan->size() == window_size && plan->batch_count() == batch_count;
+    };
+
+    // even estimating a plan can take a while, and may have to wait on the
+    // measurement of another one, so new sizes get their plans from the
+    // planner thread as well
+    if (resizing)
+    {
+        const std::size_t thread_count = fft_thread_count(window_size);
+
+        try
+        {
+            if (!is_ready(m_pending_plan, 1))
+            {
+                m_planner.retire(std::move(m_pending_plan));
+                m_pending_plan = m_planner.request(PlanSlot::WINDOW, window_size, 1, thread_count);
+            }
+
+            if (batching && !is_ready(m_pending_batch_plan, m_batch_hops))
+            {
+                m_planner.retire(std::move(m_pending_batch_plan));
+                m_pending_batch_plan = m_planner.request(PlanSlot::BATCH, window_size, m_batch_hops, thread_count);
+            }
+        }
+        catch (const std::runtime_error& e)
+        {
+            // keep the current size, while still applying the rest of the
+            // config, which no longer takes new plans
+            m_window_error = e.what();
+            m_hl_config.window_size_ms = m_applied_window_ms;
+            m_planner.retire(std::move(m_pending_plan));
+            m_planner.retire(std::move(m_pending_batch_plan));
+
+            swap_in_window_config();
+            return;
+        }
+    }
+
+    const bool plans_ready = !resizing
+        || (is_ready(m_pending_plan, 1) && (!batching || is_ready(m_pending_batch_plan, m_batch_hops)));
+
+    if (window_factors == nullptr || !plans_ready)
+    {
+        return;
+    }
+
+    m_window_pending = false;
+    m_applied_window_ms = m_hl_config.window_size_ms;
+    apply_fft_config({.window_size_samples = window_size, .window_factors = std::move(window_factors)});
+}
+
+void FFTStreamer::apply_fft_config(const FFTConfig& fft_config)
+{
+    const bool resized = fft_config.window_size_samples != m_plan->size();
+
+    if (resized)
+    {
+        m_planner.retire(std::move(m_plan));
+        m_planner.retire(std::move(m_replaced_plan));
+        m_plan = m_pending_plan != nullptr && m_pending_plan->size() == fft_config.window_size_samples
+            ? std::move(m_pending_plan)
+            : m_planner.plan(fft_config.window_size_samples, 1, fft_thread_count(fft_config.window_size_samples));
+    }
+
+    // the sample history carries over, see `WindowedFFT::update_from_config`
+    for (auto& fft : m_channel_ffts)
+    {
+        fft.update_from_config(fft_config, m_plan);
+    }
+
+    if (resized)
+    {
+        swap_in_batch_plan();
+    }
+    else
+    {
+        // requests for another size dropped the upgrades of these
+        m_planner.keep_upgrading(PlanSlot::WINDOW, *m_plan);
+
+        if (m_batch_plan != nullptr)
+        {
+            m_planner.keep_upgrading(PlanSlot::BATCH, *m_batch_plan);
+        }
+    }
+
+    // e.g. after going back to the current size before the plans were ready
+    m_planner.retire(std::move(m_pending_plan));
+    m_planner.retire(std::move(m_pending_batch_plan));
+
+    update_engine_windows();
+
+    m_latest = {};
+    m_hop_magnitudes.clear();
+    m_latest_capture_time.reset();
+    std::fill(m_channel_magnitudes.begin(), m_channel_magnitudes.end(), std::span<float>{});
+}
+
+void FFTStreamer::set_engine(SpectrumEngine engine)
+{
+    if (engine == m_engine)
+    {
+        return;
+    }
+
+    m_engine = engine;
+    rebuild_engine_spectra();
+    swap_in_batch_plan();
+
+    m_latest = {};
+    m_hop_magnitudes.clear();
+    std::fill(m_channel_magnitudes.begin(), m_channel_magnitudes.end(), std::span<float>{});
+}
+
+void FFTStreamer::set_backlog_config(const BacklogConfig& config)
+{
+    m_backlog_config = config;
+    m_backlog_config.max_catchup_rate = std::max(config.max_catchup_rate, BacklogConfig::min_catchup_rate);
+}
+
+void FFTStreamer::set_batch_hops(std::size_t max_hops)
+{
+    if (max_hops == m_batch_hops)
+    {
+        return;
+    }
+
+    m_batch_hops = max_hops;
+    swap_in_batch_plan();
+}
+
+void FFTStreamer::swap_in_batch_plan()
+{
+    const std::size_t size = config().window_size_samples;
+    const bool batching = m_batch_hops > 1 && m_engine == SpectrumEngine::LINEAR_FFT;
+
+    // batching stops right away, whereas a new batch count keeps the current
+    // one until its plan is ready
+    if (m_batch_plan != nullptr && (!batching || m_batch_plan->size() != size))
+    {
+        m_planner.retire(std::move(m_batch_plan));
+        set_batch_plan(nullptr);
+    }
+
+    const auto is_ready = [&](const std::shared_ptr<const FFTPlan>& plan) {
+        return plan != nullptr && plan->size() == size && plan->batch_count() == m_batch_hops;
+    };
+
+    if (!batching || is_ready(m_batch_plan))
+    {
+        return;
+    }
+
+    // a new window size gets its batch plan along with its other plans, see
+    // `swap_in_window_config`
+    if (m_window_pending && m_hl_config.window_size(m_analysis_rate) != size)
+    {
+        return;
+    }
+
+    if (!is_ready(m_pending_batch_plan))
+    {
+        m_planner.retire(std::move(m_pending_batch_plan));
+
+        try
+        {
+            m_pending_batch_plan = m_planner.request(PlanSlot::BATCH, size, m_batch_hops, fft_thread_count(size));
+        }
+        catch (const std::runtime_error&)
+        {
+            // keep batching as before
+            m_batch_hops = m_batch_plan != nullptr ? m_batch_plan->batch_count() : 0;
+            return;
+        }
+    }
+
+    if (is_ready(m_pending_batch_plan))
+    {
+        m_planner.retire(std::move(m_batch_plan));
+        set_batch_plan(std::move(m_pending_batch_plan));
+    }
+}
+
+void FFTStreamer::set_batch_plan(std::shared_ptr<const FFTPlan> plan)
+{
+    for (auto& fft : m_channel_ffts)
+    {
+        fft.set_batch_plan(plan);
+    }
+
+    m_batch_plan = std::move(plan);
+}
+
+void FFTStreamer::set_multiresolution_config(const MultiResolutionConfig& config)
+{
+    m_multires_config = config;
+    rebuild_engine_spectra();
+}
+
+void FFTStreamer::set_sliding_dft_config(const SlidingDFTConfig& config)
+{
+    m_sliding_config = config;
+    rebuild_engine_spectra();
+}
+
+void FFTStreamer::rebuild_engine_spectra()
+{
+    std::shared_ptr<const FFTPlan> band_plan;
+
+    if (m_engine == SpectrumEngine::MULTI_RESOLUTION)
+    {
+        band_plan = find_band_plan();
+
+        // the current engine keeps going until the planner thread is done
+        if (band_plan == nullptr)
+        {
+            m_engine_pending = m_engine != m_active_engine || m_multires_config != m_active_multires_config;
+            return;
+        }
+    }
+
+    m_engine_pending = false;
+    m_planner.retire(std::move(m_pending_band_plan));
+
+    m_engine_spectra.clear();
+    m_engine_mix.reset();
+
+    if (m_band_plan != band_plan)
+    {
+        m_planner.retire(std::move(m_band_plan));
+    }
+
+    m_band_plan = std::move(band_plan);
+    m_active_engine = m_engine;
+    m_active_multires_config = m_multires_config;
+
+    if (m_engine == SpectrumEngine::LINEAR_FFT)
+    {
+        return;
+    }
+
+    m_engine_spectra.reserve(channel_count());
+    for (std::size_t i = 0; i < channel_count(); ++i)
+    {
+        m_engine_spectra.push_back(make_engine_spectrum());
+    }
+
+    if (m_selection.mix != ChannelMix::CHANNEL)
+    {
+        m_engine_mix = make_engine_spectrum();
+    }
+}
+
+std::shared_ptr<const FFTPlan> FFTStreamer::find_band_plan()
+{
+    const std::size_t band_size = m_multires_config.band_window_size;
+
+    if (band_size == m_plan->size())
+    {
+        return m_plan;
+    }
+
+    if (m_band_plan != nullptr && m_band_plan->size() == band_size)
+    {
+        return m_band_plan;
+    }
+
+    // even estimating a plan may have to wait on the measurement of another
+    // one, see `swap_in_window_config`
+    if (m_pending_band_plan == nullptr || m_pending_band_plan->size() != band_size)
+    {
+        m_planner.retire(std::move(m_pending_band_plan));
+
+        try
+        {
+            m_pending_band_plan = m_planner.request(PlanSlot::BANDS, band_size, 1, fft_thread_count(band_size));
+        }
+        catch (const std::runtime_error&)
+        {
+            // back to the engine in use
+            m_engine = m_active_engine;
+            m_multires_config = m_active_multires_config;
+            return m_engine == SpectrumEngine::MULTI_RESOLUTION ? m_band_plan : nullptr;
+        }
+    }
+
+    return std::move(m_pending_band_plan);
+}
+
+std::unique_ptr<SignalSpectrum> FFTStreamer::make_engine_spectrum() const
+{
+    // both match the levels of the linear FFT
+    const std::size_t reference_size = config().window_size_samples;
+
+    switch (m_active_engine)
+    {
+    case SpectrumEngine::MULTI_RESOLUTION:
+        return std::make_unique<MultiResolutionSpectrum>(
+            m_analysis_rate,
+            m_hl_config,
+            m_active_multires_config,
+            m_band_plan,
+            reference_size
+        );
+    case SpectrumEngine::SLIDING_DFT:
+        return std::make_unique<SlidingDFT>(
+            m_analysis_rate,
+            sliding_dft_size(reference_size),
+            m_hl_config.type,
+            m_sliding_config
+        );
+    default:
+        return nullptr;
+    }
+}
+
+void FFTStreamer::update_engine_windows()
+{
+    const std::size_t reference_size = config().window_size_samples;
+
+    switch (m_active_engine)
+    {
+    case SpectrumEngine::MULTI_RESOLUTION:
+    {
+        // the band plan does not depend on the window
+        for (auto& spectrum : m_engine_spectra)
+        {
+            static_cast<MultiResolutionSpectrum&>(*spectrum).set_window(m_hl_config, reference_size);
+        }
+
+        if (m_engine_mix)
+        {
+            static_cast<MultiResolutionSpectrum&>(*m_engine_mix).set_window(m_hl_config, reference_size);
+        }
+        break;
+    }
+    case SpectrumEngine::SLIDING_DFT:
+    {
+        // the skew does not apply, and most window sizes map to the same
+        // transform size
+        const SlidingDFT& sdft = static_cast<const SlidingDFT&>(*m_engine_spectra.front());
+        if (sdft.window_type() != m_hl_config.type || sdft.window_size() != sliding_dft_size(reference_size))
+        {
+            rebuild_engine_spectra();
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+const MultiResolutionSpectrum* FFTStreamer::multiresolution(std::size_t channel) const
+{
+    if (m_active_engine != SpectrumEngine::MULTI_RESOLUTION || channel >= m_engine_spectra.size())
+    {
+        return nullptr;
+    }
+
+    return static_cast<const MultiResolutionSpectrum*>(m_engine_spectra[channel].get());
+}
+
+const SlidingDFT* FFTStreamer::sliding_dft(std::size_t channel) const
+{
+    if (m_active_engine != SpectrumEngine::SLIDING_DFT || channel >= m_engine_spectra.size())
+    {
+        return nullptr;
+    }
+
+    return static_cast<const SlidingDFT*>(m_engine_spectra[channel].get());
+}
+
+SpectrumLayout FFTStreamer::layout() const
+{
+    SpectrumLayout layout = m_engine_spectra.empty() ? SpectrumLayout{} : m_engine_spectra.front()->layout();
+    layout.first_bin = std::uint32_t(m_visible_bins.first);
+    layout.full_size = std::uint32_t(m_visible_bins.full_size);
+    return layout;
+}
+
+void FFTStreamer::set_band_plan(std::shared_ptr<const FFTPlan> plan)
+{
+    // only the multi-resolution engine has a band plan
+    for (auto& spectrum : m_engine_spectra)
+    {
+        static_cast<MultiResolutionSpectrum&>(*spectrum).set_plan(plan);
+    }
+
+    if (m_engine_mix)
+    {
+        static_cast<MultiResolutionSpectrum&>(*m_engine_mix).set_plan(plan);
+    }
+
+    m_band_plan = std::move(plan);
+}
+
+std::size_t FFTStreamer::fft_thread_count(std::size_t size) const
+{
+    if (m_planner.config().fft_threads != 0)
+    {
+        return m_planner.config().fft_threads;
+    }
+
+    if (size < min_threaded_fft_size)
+    {
+        return 1;
+    }
+
+    // channels already get transformed in parallel, each FFT gets a share of
+    // the remaining cores
+    const std::size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    return std::max<std::size_t>(cores / (m_pool.worker_count() + 1), 1);
+}
+
+void FFTStreamer::swap_in_upgraded_plan()
+{
+    const bool bands_share_plan = m_band_plan != nullptr && m_band_plan == m_plan;
+
+    if (auto upgrade = m_planner.take_upgrade(*m_plan))
+    {
+        for (auto& fft : m_channel_ffts)
+        {
+            fft.set_plan(upgrade);
+        }
+
+        // kept around for comparison
+        m_planner.retire(std::move(m_replaced_plan));
+        m_replaced_plan = std::move(m_plan);
+        m_plan = std::move(upgrade);
+
+        if (bands_share_plan)
+        {
+            set_band_plan(m_plan);
+        }
+    }
+
+    if (m_batch_plan != nullptr)
+    {
+        if (auto upgrade = m_planner.take_upgrade(*m_batch_plan))
+        {
+            m_planner.retire(std::move(m_batch_plan));
+            set_batch_plan(std::move(upgrade));
+        }
+    }
+
+    if (m_band_plan == nullptr || bands_share_plan)
+    {
+        return;
+    }
+
+    if (auto upgrade = m_planner.take_upgrade(*m_band_plan))
+    {
+        m_planner.retire(std::move(m_band_plan));
+        set_band_plan(std::move(upgrade));
+    }
+}
+
+void FFTStreamer::select_channels(ChannelSelection selection)
+{
+    const bool valid = selection.mix == ChannelMix::CHANNEL
+        ? selection.channel < channel_count()
+        : channel_count() >= 2;
+
+    const ChannelSelection previous = m_selection;
+    m_selection = valid ? selection : ChannelSelection{};
+
+    if (m_active_engine != SpectrumEngine::LINEAR_FFT && m_selection.mix != previous.mix)
+    {
+        // the mix only gets analyzed from when it is selected on
+        m_engine_mix.reset();
+        if (m_selection.mix != ChannelMix::CHANNEL)
+        {
+            m_engine_mix = make_engine_spectrum();
+        }
+    }
+}
+
+std::span<const float> FFTStreamer::channel_magnitudes(std::size_t channel) const
+{
+    return m_channel_magnitudes[channel];
+}
+
+void FFTStreamer::apply_worker_schedule(const ThreadSchedule& schedule)
+{
+    if (schedule.is_default())
+    {
+        return;
+    }
+
+    m_pool.run_on_workers([&](std::size_t i) {
+        apply_thread_schedule(schedule, "analysis worker " + std::to_string(i + 1));
+    });
+}
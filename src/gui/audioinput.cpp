@@ -3,10 +3,17 @@
 
 #include <spiralviz/gui/audioinput.hpp>
 
+#include <spiralviz/analysisworker.hpp>
+#include <spiralviz/audio/pipesource.hpp>
+#include <spiralviz/audio/recorder.hpp>
+
 #include <imgui.h>
 
-AudioInputGUI::AudioInputGUI(sf::SoundRecorder* recorder)
-    : m_recorder(*recorder)
+AudioInputGUI::AudioInputGUI(SampleSource* source, const AnalysisWorker* analysis, AudioDeviceRegistry* devices)
+    : m_source(*source),
+    m_analysis(*analysis),
+    m_devices(*devices),
+    m_recorder(dynamic_cast<SampleQueueRecorder*>(source))
 {}
 
 void AudioInputGUI::show_gui()
@@ -18,19 +25,54 @@ void AudioInputGUI::show_gui()
     );
     ImGui::Begin("Audio input settings", &m_params.enable_input_gui, flags);
 
+    if (m_recorder != nullptr)
+    {
+        show_device_gui();
+    }
+    else
+    {
+        ImGui::TextDisabled("Not capturing from an input device");
+    }
+
+    show_source_stats_gui();
+
+    ImGui::End();
+}
+
+void AudioInputGUI::show_device_gui()
+{
     check_current_device();
 
-    const auto available_devices = sf::SoundRecorder::getAvailableDevices();
+    // cached by the registry, so this is cheap enough to do every frame
+    const auto devices = m_devices.snapshot();
 
     if (ImGui::BeginCombo("##inputdevice", m_params.input_name.c_str()))
     {
-        for (const auto& available_device : available_devices)
+        for (const AudioDeviceInfo& device : devices->devices)
         {
-            const bool is_current = available_device == m_params.input_name;
-            if (ImGui::Selectable(available_device.c_str(), is_current))
+            const bool is_current = device.name == m_params.input_name;
+            const bool is_supported = device.capabilities.supports(
+                m_source.sample_rate(),
+                m_source.channel_count()
+            );
+
+            const std::string label = device.is_default ? device.name + " (default)" : device.name;
+            const auto flags = is_supported ? ImGuiSelectableFlags_None : ImGuiSelectableFlags_Disabled;
+
+            if (ImGui::Selectable(label.c_str(), is_current, flags))
             {
-                m_params.input_name = available_device;
-                m_recorder.setDevice(available_device);
+                // the current device keeps feeding the analysis until the
+                // new one is ready
+                m_recorder->switch_device(device.name);
+            }
+
+            if (!is_supported && ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+            {
+                ImGui::SetTooltip(
+                    "Cannot capture %zu channel(s) at %zu Hz",
+                    m_source.channel_count(),
+                    m_source.sample_rate()
+                );
             }
 
             if (is_current)
@@ -41,10 +83,103 @@ void AudioInputGUI::show_gui()
         ImGui::EndCombo();
     }
 
-    ImGui::End();
+    ImGui::SameLine();
+    if (ImGui::Button("Refresh"))
+    {
+        m_devices.request_refresh();
+    }
+
+    if (m_recorder->is_switching())
+    {
+        ImGui::TextDisabled("Switching...");
+    }
+    else if (const std::string failed = m_recorder->failed_device(); !failed.empty())
+    {
+        ImGui::TextColored(ImVec4{1.0f, 0.4f, 0.4f, 1.0f}, "Failed to open %s", failed.c_str());
+    }
+
+    if (const AudioDeviceInfo* current = devices->find(m_params.input_name))
+    {
+        show_device_capabilities_gui(current->capabilities);
+    }
+}
+
+void AudioInputGUI::show_device_capabilities_gui(const AudioDeviceCapabilities& capabilities)
+{
+    if (!capabilities.probed)
+    {
+        ImGui::TextDisabled("Device capabilities unknown");
+        return;
+    }
+
+    std::string rates;
+    for (std::size_t sample_rate : capabilities.sample_rates)
+    {
+        rates += (rates.empty() ? "" : ", ") + std::to_string(sample_rate);
+    }
+
+    ImGui::TextDisabled(
+        "Supports %s Hz, up to %zu channel(s)",
+        rates.empty() ? "no common rate" : rates.c_str(),
+        capabilities.max_channels
+    );
+}
+
+void AudioInputGUI::show_source_stats_gui()
+{
+    const StreamerStatus& status = m_analysis.status();
+
+    ImGui::Text(
+        "%zu Hz, %s",
+        status.source_rate,
+        get_sample_format_string(m_source.format())
+    );
+    ImGui::Text("Queued: %zu samples", status.queued_samples);
+    ImGui::Text(
+        "Dropped: %llu, skipped: %llu samples",
+        static_cast<unsigned long long>(status.dropped_samples),
+        static_cast<unsigned long long>(status.overwritten_samples)
+    );
+
+    if (const CaptureArchiver* archiver = m_recorder != nullptr ? m_recorder->archiver() : nullptr)
+    {
+        show_archive_stats_gui(*archiver);
+    }
+
+    if (const auto* pipe = dynamic_cast<const PipeSampleSource*>(&m_source))
+    {
+        ImGui::Text(
+            "Pipe: %llu stalls, %llu short reads, %llu full queue waits",
+            static_cast<unsigned long long>(pipe->stall_count()),
+            static_cast<unsigned long long>(pipe->short_read_count()),
+            static_cast<unsigned long long>(pipe->queue_full_count())
+        );
+    }
 }
 
 void AudioInputGUI::check_current_device()
 {
-    m_params.input_name = m_recorder.getDevice();
+    m_params.input_name = m_recorder->device();
+}
+
+void AudioInputGUI::show_archive_stats_gui(const CaptureArchiver& archiver)
+{
+    if (archiver.failed())
+    {
+        ImGui::TextColored(ImVec4{1.0f, 0.4f, 0.4f, 1.0f}, "Archive: failed to write %s", archiver.params().path.c_str());
+        return;
+    }
+
+    ImGui::Text(
+        "Archive: %.1f MiB in %zu file(s), writing at %.1f MiB/s",
+        archiver.bytes_written() / (1024.0 * 1024.0),
+        archiver.segment_count(),
+        archiver.write_throughput() / (1024.0 * 1024.0)
+    );
+    ImGui::Text(
+        "Archive buffer peak: %zu/%zu KiB, dropped: %llu blocks",
+        archiver.high_water_mark() / 1024,
+        archiver.buffer_capacity() / 1024,
+        static_cast<unsigned long long>(archiver.dropped_blocks())
+    );
 }
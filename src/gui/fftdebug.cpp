@@ -6,10 +6,26 @@
 
 #include <spiralviz/dsp/windowedfft.hpp>
 
+#include <cfloat>
+#include <stdexcept>
+
+namespace
+{
+// Lets the plots read spectra in any format
+float encoded_magnitude_at(void* data, int i)
+{
+    return static_cast<const EncodedSpectrum*>(data)->magnitude(std::size_t(i));
+}
+}
+
 void FFTDebugGUI::show_params_gui()
 {
     if (!m_params.enable_params_gui) { return; }
 
+    // changes get posted to the analysis thread, which shows up in the
+    // status a few milliseconds later
+    const StreamerStatus& status = m_analysis.status();
+
     const auto flags = (
         ImGuiWindowFlags_AlwaysAutoResize
     );
@@ -20,16 +36,81 @@ void FFTDebugGUI::show_params_gui()
         | ImGuiTreeNodeFlags_Framed
     );
 
+    if (status.channel_count > 1 && ImGui::TreeNodeEx("Channels", header_flags))
+    {
+        show_channel_gui(status);
+        ImGui::TreePop();
+    }
+
     if (ImGui::TreeNodeEx("FFT parameters", header_flags))
     {
-        FFTHighLevelConfig new_cfg = m_fft_hl_config;
+        const FFTHighLevelConfig& hl_config = status.hl_config;
+        FFTHighLevelConfig new_cfg = hl_config;
 
-        // ImGui::SliderFloat("Window size (ms)", &new_cfg.window_size_ms, 5.0f, 1000.0f);
+        ImGui::SliderFloat(
+            "Window size",
+            &new_cfg.window_size_ms,
+            25.0f,
+            3000.0f,
+            "%.0f ms",
+            ImGuiSliderFlags_Logarithmic
+        );
+
+        if (ImGui::BeginCombo("##engine", get_spectrum_engine_string(status.engine)))
+        {
+            for (int n = 0; n < 3; n++)
+            {
+                bool is_selected = int(status.engine) == n;
+                if (ImGui::Selectable(get_spectrum_engine_string(SpectrumEngine(n)), is_selected))
+                    m_analysis.post([n](FFTStreamer& streamer) { streamer.set_engine(SpectrumEngine(n)); });
+                if (is_selected)
+                    ImGui::SetItemDefaultFocus();
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::SameLine();
+        ImGui::Text("Engine\n");
+
+        if (status.engine_pending)
+        {
+            ImGui::TextDisabled("Building the band plan...");
+        }
+
+        if (status.multiresolution)
+        {
+            show_multiresolution_gui(*status.multiresolution);
+        }
+
+        if (status.sliding_dft)
+        {
+            show_sliding_dft_gui(*status.sliding_dft);
+        }
+
+        if (status.resampling)
+        {
+            ImGui::Text(
+                "N=%zu at %zu Hz (resampled from %zu Hz)",
+                status.config.window_size_samples,
+                status.analysis_rate,
+                status.source_rate
+            );
+        }
+        else
+        {
+            ImGui::Text(
+                "N=%zu at %zu Hz",
+                status.config.window_size_samples,
+                status.analysis_rate
+            );
+        }
+
+        // shared with the analysis, which never modifies it
+        const std::vector<float>& window_factors = *status.config.window_factors;
 
         ImGui::PlotLines(
             "##windowplot",
-            m_fft.config().window_factors.data(),
-            m_fft.config().window_factors.size(),
+            window_factors.data(),
+            window_factors.size(),
             0,
             "",
             0.0f,
@@ -37,11 +118,21 @@ void FFTDebugGUI::show_params_gui()
             ImVec2(ImGui::GetContentRegionAvail().x, 32.0)
         );
 
-        if (ImGui::BeginCombo("##ffttype", get_window_type_string(m_fft_hl_config.type)))
+        if (status.window_pending)
+        {
+            ImGui::TextDisabled("Building the new window...");
+        }
+
+        if (!status.window_error.empty())
+        {
+            ImGui::TextDisabled("Could not resize the window: %s", status.window_error.c_str());
+        }
+
+        if (ImGui::BeginCombo("##ffttype", get_window_type_string(hl_config.type)))
         {
             for (int n = 0; n < 3; n++)
             {
-                bool is_selected = int(m_fft_hl_config.type) == n;
+                bool is_selected = int(hl_config.type) == n;
                 if (ImGui::Selectable(get_window_type_string(WindowType(n)), is_selected))
                     new_cfg.type = WindowType(n);
                 if (is_selected)
@@ -67,15 +158,20 @@ void FFTDebugGUI::show_params_gui()
             );
         }
 
-        if (new_cfg != m_fft_hl_config)
+        if (new_cfg != hl_config)
         {
-            m_fft.update_from_config(new_cfg.as_fft_config(m_recorder.getSampleRate()));
-            m_fft_hl_config = new_cfg;
+            m_analysis.post([new_cfg](FFTStreamer& streamer) { streamer.update_from_config(new_cfg); });
         }
 
         ImGui::TreePop();
     }
 
+    if (ImGui::TreeNodeEx("Latency", header_flags))
+    {
+        show_latency_gui(status);
+        ImGui::TreePop();
+    }
+
     if (ImGui::TreeNodeEx("Visualization settings", header_flags))
     {
         const auto volume_slider_flags = (
@@ -90,6 +186,38 @@ void FFTDebugGUI::show_params_gui()
         ImGui::SliderFloat("Band width", &m_viz_params.spiral_width, 0.001f, 0.2f);
         ImGui::SliderFloat("Band blur", &m_viz_params.spiral_blur, 0.001f, 0.2f);
         ImGui::Checkbox("Smooth", &m_viz_params.smooth_fft);
+        ImGui::Separator();
+
+        const SpectrumFormat format = status.output_format;
+
+        if (ImGui::BeginCombo("##spectrumformat", get_spectrum_format_string(format)))
+        {
+            for (int n = 0; n < 3; n++)
+            {
+                bool is_selected = int(format) == n;
+                if (ImGui::Selectable(get_spectrum_format_string(SpectrumFormat(n)), is_selected))
+                    m_analysis.post([this, n, range = status.log_level_range](FFTStreamer&) {
+                        m_analysis.set_output_format(SpectrumFormat(n), range);
+                    });
+                if (is_selected)
+                    ImGui::SetItemDefaultFocus();
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::SameLine();
+        ImGui::Text("Spectrum format\n");
+
+        if (ImGui::IsItemHovered())
+        {
+            ImGui::SetTooltip(
+                "Format of the spectra handed over to the display.\n"
+                "\n"
+                "The dB formats take a half or a quarter of the memory and"
+                " upload bandwidth, and clamp levels outside of %.0f to %.0f dB.",
+                status.log_level_range.min_db,
+                status.log_level_range.max_db
+            );
+        }
 
         ImGui::TreePop();
     }
@@ -97,13 +225,359 @@ void FFTDebugGUI::show_params_gui()
     // Currently hasn't been useful whatsoever
     // if (ImGui::Button("Catch up"))
     // {
-    //     m_recorder.discard_n_oldest();
+    //     m_source.discard();
     // }
 
     ImGui::End();
 }
 
-void FFTDebugGUI::show_fft_gui(std::span<const float> fft_data)
+void FFTDebugGUI::show_multiresolution_gui(const StreamerStatus::MultiResolutionStatus& multires)
+{
+    const std::size_t window_size = multires.config.band_window_size;
+
+    ImGui::Text(
+        "%zu bands of N=%zu, %.0f cents per bin",
+        multires.bands.size(),
+        window_size,
+        multires.config.cents_per_bin
+    );
+
+    for (const SpectrumBand& band : multires.bands)
+    {
+        ImGui::TextDisabled(
+            "%7.0f - %5.0f Hz: %6.0f Hz, %4.0f ms window",
+            band.low_frequency,
+            band.high_frequency,
+            band.sample_rate,
+            1000.0 * window_size / band.sample_rate
+        );
+    }
+}
+
+void FFTDebugGUI::show_sliding_dft_gui(const StreamerStatus::SlidingDFTStatus& sdft)
+{
+    ImGui::Text(
+        "%zu bins tracked over N=%zu, %.0f cents per bin",
+        sdft.tracked_bin_count,
+        sdft.window_size,
+        sdft.config.cents_per_bin
+    );
+
+    ImGui::TextDisabled(
+        "%.0f - %.0f Hz, updated every sample",
+        sdft.config.min_frequency,
+        sdft.config.max_frequency
+    );
+}
+
+void FFTDebugGUI::show_channel_gui(const StreamerStatus& status)
+{
+    const ChannelSelection selection = status.selected_channels;
+
+    const auto selection_string = [](ChannelSelection selection) {
+        if (selection.mix == ChannelMix::CHANNEL)
+        {
+            return "Channel " + std::to_string(selection.channel + 1);
+        }
+        return std::string(get_channel_mix_string(selection.mix));
+    };
+
+    std::vector<ChannelSelection> choices;
+    for (std::size_t i = 0; i < status.channel_count; ++i)
+    {
+        choices.push_back({ChannelMix::CHANNEL, i});
+    }
+    choices.push_back({ChannelMix::MID});
+    choices.push_back({ChannelMix::SIDE});
+
+    if (ImGui::BeginCombo("##channelsel", selection_string(selection).c_str()))
+    {
+        for (const ChannelSelection& choice : choices)
+        {
+            bool is_selected = choice == selection;
+            if (ImGui::Selectable(selection_string(choice).c_str(), is_selected))
+                m_analysis.post([choice](FFTStreamer& streamer) { streamer.select_channels(choice); });
+            if (is_selected)
+                ImGui::SetItemDefaultFocus();
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    ImGui::Text("Displayed channel\n");
+
+    bool analyze_all = status.analyze_all_channels;
+    if (ImGui::Checkbox("Analyze all channels", &analyze_all))
+    {
+        m_analysis.post([analyze_all](FFTStreamer& streamer) { streamer.set_analyze_all_channels(analyze_all); });
+    }
+
+    if (ImGui::IsItemHovered())
+    {
+        ImGui::SetTooltip(
+            "Computes the FFT of every channel, in parallel, rather than only\n"
+            "the displayed one. The raw FFT view then plots every channel."
+        );
+    }
+}
+
+void FFTDebugGUI::show_latency_gui(const StreamerStatus& status)
+{
+    const std::size_t hop_sizes[] = {256, 512, 1024, 2048};
+    const std::string hop_string = std::to_string(status.hop_size) + " samples";
+
+    if (ImGui::BeginCombo("##hopsize", hop_string.c_str()))
+    {
+        for (std::size_t hop_size : hop_sizes)
+        {
+            bool is_selected = status.hop_size == hop_size;
+            if (ImGui::Selectable((std::to_string(hop_size) + " samples").c_str(), is_selected))
+                m_analysis.post([hop_size](FFTStreamer& streamer) { streamer.set_hop_size(hop_size); });
+            if (is_selected)
+                ImGui::SetItemDefaultFocus();
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    ImGui::Text("Hop size\n");
+
+    int batch_hops = int(std::max<std::size_t>(status.batch_hops, 1));
+    if (ImGui::SliderInt("Batched hops", &batch_hops, 1, 16))
+    {
+        m_analysis.post([batch_hops](FFTStreamer& streamer) { streamer.set_batch_hops(std::size_t(batch_hops)); });
+    }
+
+    if (ImGui::IsItemHovered())
+    {
+        ImGui::SetTooltip(
+            "When several hops are due at once, computes up to this many of\n"
+            "them in a single batched FFT rather than only the newest one.\n"
+            "Linear engine only."
+        );
+    }
+
+    const BacklogConfig& backlog_config = status.backlog_config;
+    BacklogConfig new_cfg = backlog_config;
+
+    if (ImGui::BeginCombo("##backlogpolicy", get_backlog_policy_string(new_cfg.policy)))
+    {
+        for (int n = 0; n < 4; n++)
+        {
+            bool is_selected = int(new_cfg.policy) == n;
+            if (ImGui::Selectable(get_backlog_policy_string(BacklogPolicy(n)), is_selected))
+                new_cfg.policy = BacklogPolicy(n);
+            if (is_selected)
+                ImGui::SetItemDefaultFocus();
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    ImGui::Text("Backlog policy\n");
+
+    int max_backlog_ms = int(new_cfg.max_backlog_ms);
+    ImGui::SliderInt("Max backlog (ms)", &max_backlog_ms, 20, 1000);
+    new_cfg.max_backlog_ms = std::size_t(max_backlog_ms);
+
+    if (new_cfg.policy == BacklogPolicy::TIME_STRETCH)
+    {
+        ImGui::SliderFloat("Max catch-up rate", &new_cfg.max_catchup_rate, BacklogConfig::min_catchup_rate, 4.0f);
+    }
+
+    if (new_cfg != backlog_config)
+    {
+        m_analysis.post([new_cfg](FFTStreamer& streamer) { streamer.set_backlog_config(new_cfg); });
+    }
+
+    const BacklogStats& stats = status.backlog_stats;
+    const double ms_per_sample = 1000.0 / status.source_rate;
+
+    ImGui::Text(
+        "Backlog: %.1f ms (peak %.1f ms)",
+        stats.backlog * ms_per_sample,
+        stats.peak_backlog * ms_per_sample
+    );
+    ImGui::Text(
+        "Dropped: %llu samples, %.2f s over budget",
+        static_cast<unsigned long long>(stats.dropped_samples),
+        stats.time_over_budget_s
+    );
+
+    if (ImGui::Button("Reset counters"))
+    {
+        m_analysis.post([](FFTStreamer& streamer) { streamer.reset_backlog_stats(); });
+    }
+
+    ImGui::Separator();
+    show_display_latency_gui();
+
+    ImGui::Text(
+        "%llu spectra analyzed, %llu replaced before display",
+        static_cast<unsigned long long>(m_analysis.published_frames()),
+        static_cast<unsigned long long>(m_analysis.skipped_frames())
+    );
+
+    show_plan_gui(status);
+
+    show_realtime_report_gui();
+}
+
+void FFTDebugGUI::show_plan_gui(const StreamerStatus& status)
+{
+    if (!ImGui::TreeNode("FFT plan"))
+    {
+        return;
+    }
+
+    const PlanStatus& plan = status.plan;
+
+    // thread-safe on its own
+    const FFTPlanner& planner = m_streamer.planner();
+
+    ImGui::Text(
+        "%s plan, %s, %.1f ms to plan",
+        get_plan_rigor_string(plan.rigor),
+        plan.from_wisdom ? "from wisdom" : "freshly planned",
+        std::chrono::duration<double, std::milli>(plan.planning_time).count()
+    );
+    ImGui::Text("%.2f us per FFT, %s kernels", plan.mean_execute_us, get_kernel_isa_string(active_kernel_isa()));
+
+    if (plan.thread_count > 1)
+    {
+        ImGui::Text("Split over up to %zu FFTW threads", plan.thread_count);
+    }
+    else if (!fftw_has_threads())
+    {
+        ImGui::TextDisabled("FFTW threads unavailable, FFTs run on a single core");
+    }
+
+    if (const auto& replaced = status.replaced_plan)
+    {
+        ImGui::Text(
+            "%.2f us per FFT with the replaced %s plan",
+            replaced->mean_execute_us,
+            get_plan_rigor_string(replaced->rigor)
+        );
+    }
+
+    if (const auto& batch = status.batch_plan)
+    {
+        ImGui::Text(
+            "%.2f us per batch of %zu FFTs (%s)",
+            batch->mean_execute_us,
+            batch->batch_count,
+            get_plan_rigor_string(batch->rigor)
+        );
+    }
+
+    if (planner.is_planning())
+    {
+        ImGui::Text("Planning %s in the background...", get_plan_rigor_string(planner.config().rigor));
+    }
+
+    if (!planner.config().use_wisdom)
+    {
+        ImGui::TextDisabled("Wisdom disabled");
+    }
+    else
+    {
+        ImGui::TextWrapped(
+            "Wisdom: %s (%s)",
+            planner.wisdom_path().c_str(),
+            planner.wisdom_loaded() ? "loaded" : "not found"
+        );
+    }
+
+    ImGui::TreePop();
+}
+
+void FFTDebugGUI::show_realtime_report_gui()
+{
+    const auto report = realtime_report();
+
+    if (report.empty() || !ImGui::TreeNode("Real-time settings"))
+    {
+        return;
+    }
+
+    for (const RealtimeReportEntry& entry : report)
+    {
+        if (entry.applied)
+        {
+            ImGui::Text("%s: %s", entry.thread.c_str(), entry.setting.c_str());
+        }
+        else
+        {
+            ImGui::TextColored(
+                ImVec4{1.0f, 0.4f, 0.4f, 1.0f},
+                "%s: %s failed (%s)",
+                entry.thread.c_str(),
+                entry.setting.c_str(),
+                entry.detail.c_str()
+            );
+        }
+    }
+
+    ImGui::TreePop();
+}
+
+void FFTDebugGUI::show_display_latency_gui()
+{
+    if (m_latency.empty())
+    {
+        ImGui::TextDisabled("Capture to display latency unknown for this input");
+        return;
+    }
+
+    ImGui::Text(
+        "Capture to display: p50 %.1f ms, p99 %.1f ms, max %.1f ms",
+        m_latency.percentile_ms(0.5f),
+        m_latency.percentile_ms(0.99f),
+        m_latency.max_ms()
+    );
+
+    // 2ms buckets, the last one catching anything beyond
+    constexpr std::size_t bucket_count = 50;
+    constexpr float bucket_ms = 2.0f;
+    const std::vector<float> histogram = m_latency.histogram(bucket_count, bucket_ms);
+
+    ImGui::PlotHistogram(
+        "##latencyhistogram",
+        histogram.data(),
+        int(histogram.size()),
+        0,
+        "0-100 ms",
+        0.0f,
+        FLT_MAX,
+        ImVec2(0, 60)
+    );
+
+    if (ImGui::Button("Export CSV"))
+    {
+        const std::string path = "latency.csv";
+
+        try
+        {
+            m_latency.export_csv(path);
+            m_latency_export_status = "Exported " + std::to_string(m_latency.size()) + " measurements to " + path;
+        }
+        catch (const std::runtime_error& e)
+        {
+            m_latency_export_status = e.what();
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset##latency"))
+    {
+        m_latency.clear();
+        m_latency_export_status.clear();
+    }
+
+    if (!m_latency_export_status.empty())
+    {
+        ImGui::TextDisabled("%s", m_latency_export_status.c_str());
+    }
+}
+
+void FFTDebugGUI::show_fft_gui(const SpectrumFrame& frame)
 {
     if (!m_params.enable_fft_gui) { return; }
 
@@ -111,9 +585,39 @@ void FFTDebugGUI::show_fft_gui(std::span<const float> fft_data)
 
     ImGui::Begin("Raw FFT view", &m_params.enable_fft_gui);
 
+    if (frame.channel_magnitudes.size() > 1)
+    {
+        const std::size_t channel_count = frame.channel_magnitudes.size();
+        const float plot_height = ImGui::GetContentRegionAvail().y / channel_count
+            - ImGui::GetStyle().ItemSpacing.y;
+
+        for (std::size_t i = 0; i < channel_count; ++i)
+        {
+            const EncodedSpectrum& channel_data = frame.channel_magnitudes[i];
+
+            ImGui::PlotLines(
+                ("##fftplot" + std::to_string(i)).c_str(),
+                encoded_magnitude_at,
+                const_cast<EncodedSpectrum*>(&channel_data),
+                channel_data.size(),
+                0,
+                ("Channel " + std::to_string(i + 1)).c_str(),
+                0.0,
+                1.0,
+                ImVec2(ImGui::GetContentRegionAvail().x, plot_height)
+            );
+        }
+
+        ImGui::End();
+        return;
+    }
+
+    const EncodedSpectrum& fft_data = frame.magnitudes;
+
     ImGui::PlotLines(
         "##fftplot",
-        fft_data.data(),
+        encoded_magnitude_at,
+        const_cast<EncodedSpectrum*>(&fft_data),
         fft_data.size(),
         0,
         (std::string() + std::to_string(fft_data.size()) + " values").c_str(),
@@ -125,4 +629,4 @@ void FFTDebugGUI::show_fft_gui(std::span<const float> fft_data)
     );
 
     ImGui::End();
-}
\ No newline at end of file
+}
@@ -33,9 +33,17 @@ void VizShader::render_into(sf::RenderTarget& target)
     render_into(target, target_rect);
 }
 
-void VizShader::update_fft_texture(std::span<const float> fft_data, std::size_t sample_rate)
+void VizShader::update_fft_texture(
+    const EncodedSpectrum& fft_data,
+    std::size_t sample_rate,
+    const SpectrumLayout& layout,
+    std::optional<CaptureClock::time_point> capture_time)
 {
-    m_sample_rate = sample_rate;
+    m_params.sample_rate = sample_rate;
+    m_fft_layout = layout;
+    m_fft_format = fft_data.format;
+    m_fft_log_range = fft_data.range;
+    m_fft_capture_time = capture_time;
 
     if (m_fft.getSize().x != fft_data.size())
     {
@@ -45,6 +53,23 @@ void VizShader::update_fft_texture(std::span<const float> fft_data, std::size_t
 
     assert(fft_data.size() < m_fft.getMaximumSize());
 
+    GLint internal_format = GL_R32F;
+    GLenum type = GL_FLOAT;
+    const void* texels = fft_data.linear.data();
+
+    if (fft_data.format == SpectrumFormat::LOG_U16)
+    {
+        internal_format = GL_R16;
+        type = GL_UNSIGNED_SHORT;
+        texels = fft_data.log_u16.data();
+    }
+    else if (fft_data.format == SpectrumFormat::LOG_U8)
+    {
+        internal_format = GL_R8;
+        type = GL_UNSIGNED_BYTE;
+        texels = fft_data.log_u8.data();
+    }
+
     sf::Texture::bind(&m_fft);
     // this is very silly, but it does work, so it's fine as long as SFML
     // doesn't try to poke at the texture which it shouldn't if we don't use its
@@ -52,13 +77,13 @@ void VizShader::update_fft_texture(std::span<const float> fft_data, std::size_t
     glTexImage2D(
         GL_TEXTURE_2D,
         0,
-        GL_R32F,
+        internal_format,
         fft_data.size(),
         1,
         0,
         GL_RED,
-        GL_FLOAT,
-        fft_data.data()
+        type,
+        texels
     );
     sf::Texture::bind(nullptr);
 
@@ -91,7 +116,19 @@ void VizShader::reload_uniforms()
 {
     m_shader.setUniform("fft", m_fft);
     m_shader.setUniform("fft_size", int(m_fft.getSize().x));
-    m_shader.setUniform("sample_rate", float(m_sample_rate));
+    m_shader.setUniform("sample_rate", m_params.sample_rate);
+    m_shader.setUniform("spectrum_scale", int(m_fft_layout.scale));
+    m_shader.setUniform("spectrum_min_freq", m_fft_layout.min_frequency);
+    m_shader.setUniform("spectrum_cents_per_bin", m_fft_layout.cents_per_bin);
+
+    // the texture may only hold a slice of the spectrum
+    const std::uint32_t full_size = m_fft_layout.full_size != 0 ? m_fft_layout.full_size : m_fft.getSize().x;
+    m_shader.setUniform("spectrum_first_bin", float(m_fft_layout.first_bin));
+    m_shader.setUniform("spectrum_full_size", float(full_size));
+
+    m_shader.setUniform("spectrum_log", m_fft_format != SpectrumFormat::FLOAT);
+    m_shader.setUniform("spectrum_min_db", m_fft_log_range.min_db);
+    m_shader.setUniform("spectrum_max_db", m_fft_log_range.max_db);
 
     m_shader.setUniform("spiral_start", m_params.spiral_start);
     m_shader.setUniform("spiral_dis", m_params.spiral_dis);
@@ -6,6 +6,9 @@
 #include <spiralviz/dsp/util.hpp>
 #include <spiralviz/gui/util.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 sf::Vector2f viz_origin(sf::Vector2f target_resolution)
 {
     return target_resolution * 0.5f;
@@ -38,8 +41,7 @@ VizPointInformation viz_info_at_position(sf::Vector2f screen_pos, sf::Vector2f s
     // FIXME: why 55Hz??
     const float frequency = 55.0 * std::pow(tet_root, cents / 100.0f);
 
-    // FIXME: hardcoded sample rate
-    const float bin_float = frequency / 44100;
+    const float bin_float = frequency / params.sample_rate;
     const int bin = std::round(bin_float);
 
     return {
@@ -94,3 +96,19 @@ double viz_cents_from_frequency(double frequency)
     // FIXME: 55 or 110?
     return (std::log2(frequency) - std::log2(55)) * 1200.0 / std::log2(2);
 }
+
+FrequencyRange viz_visible_frequencies(sf::Vector2f target_resolution, const VizParams& params)
+{
+    // same coordinates as `viz_info_at_position`, where the farthest corner
+    // is half the diagonal away from the center
+    const float aspect = target_resolution.x / target_resolution.y;
+    const float max_length = 0.5f * std::sqrt(aspect * aspect + 1.0f);
+    const float turns = std::max(max_length - params.spiral_start, 0.0f) / params.spiral_dis;
+
+    // the innermost turn starts up to an octave below 110Hz, and every turn
+    // goes up an octave
+    return {
+        .low = 55.0f,
+        .high = 110.0f * std::exp2(turns)
+    };
+}
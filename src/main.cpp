@@ -2,9 +2,57 @@
 // Copyright (C) 2023 sdelang
 
 #include <spiralviz/app.hpp>
+#include <spiralviz/bench.hpp>
+#include <spiralviz/options.hpp>
 
-int main()
+#include <cstdio>
+#include <stdexcept>
+
+int main(int argc, char** argv)
 {
-    App app;
-    app.show_until_closed();
-}
\ No newline at end of file
+    Options options;
+
+    try
+    {
+        options = parse_options(argc, argv);
+
+        if (options.kernel_isa)
+        {
+            set_kernel_isa(*options.kernel_isa);
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (options.show_help)
+    {
+        print_usage(argv[0]);
+        return 0;
+    }
+
+    if (options.kernel_benchmark)
+    {
+        return run_kernel_benchmark(options);
+    }
+
+    if (options.benchmark)
+    {
+        return run_benchmark(options);
+    }
+
+    try
+    {
+        // opening the input or the archive may fail
+        App app{options};
+        app.show_until_closed();
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,478 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/options.hpp>
+
+#include <cstdio>
+#include <stdexcept>
+#include <string_view>
+
+namespace
+{
+std::size_t parse_size(std::string_view name, const char* value)
+{
+    try
+    {
+        std::size_t end;
+        const auto ret = std::stoull(value, &end);
+        if (value[end] == '\0')
+        {
+            return ret;
+        }
+    }
+    catch (...) {}
+
+    throw std::runtime_error(std::string(name) + ": expected a positive integer, got '" + value + "'");
+}
+
+SampleFormat parse_pcm_format(std::string_view name, std::string_view value)
+{
+    if (value == "s16le" || value == "s16") { return SampleFormat::S16; }
+    if (value == "f32le" || value == "f32") { return SampleFormat::F32; }
+
+    throw std::runtime_error(std::string(name) + ": expected s16le or f32le, got '" + std::string(value) + "'");
+}
+
+BacklogPolicy parse_backlog_policy(std::string_view name, std::string_view value)
+{
+    if (value == "drop") { return BacklogPolicy::DROP_OLDEST; }
+    if (value == "skip") { return BacklogPolicy::SKIP_TO_LIVE; }
+    if (value == "stretch") { return BacklogPolicy::TIME_STRETCH; }
+    if (value == "unbounded") { return BacklogPolicy::UNBOUNDED; }
+
+    throw std::runtime_error(std::string(name) + ": expected drop, skip, stretch or unbounded, got '" + std::string(value) + "'");
+}
+
+SpectrumEngine parse_spectrum_engine(std::string_view name, std::string_view value)
+{
+    if (value == "linear") { return SpectrumEngine::LINEAR_FFT; }
+    if (value == "multires") { return SpectrumEngine::MULTI_RESOLUTION; }
+    if (value == "sdft") { return SpectrumEngine::SLIDING_DFT; }
+
+    throw std::runtime_error(std::string(name) + ": expected linear, multires or sdft, got '" + std::string(value) + "'");
+}
+
+SpectrumFormat parse_spectrum_format(std::string_view name, std::string_view value)
+{
+    if (value == "f32") { return SpectrumFormat::FLOAT; }
+    if (value == "log16") { return SpectrumFormat::LOG_U16; }
+    if (value == "log8") { return SpectrumFormat::LOG_U8; }
+
+    throw std::runtime_error(std::string(name) + ": expected f32, log16 or log8, got '" + std::string(value) + "'");
+}
+
+PlanRigor parse_plan_rigor(std::string_view name, std::string_view value)
+{
+    if (value == "estimate") { return PlanRigor::ESTIMATE; }
+    if (value == "measure") { return PlanRigor::MEASURE; }
+    if (value == "patient") { return PlanRigor::PATIENT; }
+
+    throw std::runtime_error(std::string(name) + ": expected estimate, measure or patient, got '" + std::string(value) + "'");
+}
+
+KernelISA parse_kernel_isa(std::string_view name, std::string_view value)
+{
+    KernelISA ret;
+
+    if (value == "scalar") { ret = KernelISA::SCALAR; }
+    else if (value == "sse2") { ret = KernelISA::SSE2; }
+    else if (value == "avx2") { ret = KernelISA::AVX2; }
+    else if (value == "avx512") { ret = KernelISA::AVX512; }
+    else
+    {
+        throw std::runtime_error(std::string(name) + ": expected scalar, sse2, avx2 or avx512, got '" + std::string(value) + "'");
+    }
+
+    if (!is_kernel_isa_supported(ret))
+    {
+        throw std::runtime_error(std::string(name) + ": " + get_kernel_isa_string(ret) + " is not supported on this CPU");
+    }
+
+    return ret;
+}
+
+/// Parses `<fifo|rr>[:priority]` into `schedule`.
+void parse_scheduling(std::string_view name, std::string_view value, ThreadSchedule& schedule)
+{
+    const std::size_t colon = value.find(':');
+    const std::string_view policy = value.substr(0, colon);
+
+    if (policy == "fifo") { schedule.policy = SchedulingPolicy::FIFO; }
+    else if (policy == "rr") { schedule.policy = SchedulingPolicy::ROUND_ROBIN; }
+    else
+    {
+        throw std::runtime_error(std::string(name) + ": expected fifo or rr, got '" + std::string(value) + "'");
+    }
+
+    // low enough to stay below the usual priority of audio servers
+    schedule.priority = 50;
+
+    if (colon != std::string_view::npos)
+    {
+        schedule.priority = int(parse_size(name, std::string(value.substr(colon + 1)).c_str()));
+    }
+}
+
+/// Parses a list of cores such as `2,4-7`.
+std::vector<std::size_t> parse_cpu_list(std::string_view name, std::string_view value)
+{
+    std::vector<std::size_t> ret;
+
+    while (!value.empty())
+    {
+        const std::size_t comma = value.find(',');
+        const std::string_view range = value.substr(0, comma);
+        const std::size_t dash = range.find('-');
+
+        const std::size_t first = parse_size(name, std::string(range.substr(0, dash)).c_str());
+        const std::size_t last = dash != std::string_view::npos
+            ? parse_size(name, std::string(range.substr(dash + 1)).c_str())
+            : first;
+
+        for (std::size_t cpu = first; cpu <= last; ++cpu)
+        {
+            ret.push_back(cpu);
+        }
+
+        value = comma != std::string_view::npos ? value.substr(comma + 1) : std::string_view{};
+    }
+
+    if (ret.empty())
+    {
+        throw std::runtime_error(std::string(name) + ": expected a list of cores");
+    }
+
+    return ret;
+}
+}
+
+Options parse_options(int argc, char** argv)
+{
+    Options ret;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+
+        const auto value = [&]() -> const char* {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error(std::string(arg) + ": missing value");
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-h" || arg == "--help")
+        {
+            ret.show_help = true;
+        }
+        else if (arg == "--input")
+        {
+            ret.input_path = value();
+        }
+        else if (arg == "--pipe")
+        {
+            ret.pipe_path = value();
+        }
+        else if (arg == "--block")
+        {
+            ret.pipe_block_samples = parse_size(arg, value());
+        }
+        else if (arg == "--read-ahead")
+        {
+            ret.pipe_read_ahead_blocks = parse_size(arg, value());
+        }
+        else if (arg == "--raw")
+        {
+            ret.raw_params = RawPCMParams{.format = parse_pcm_format(arg, value())};
+        }
+        else if (arg == "--rate")
+        {
+            ret.sample_rate = parse_size(arg, value());
+        }
+        else if (arg == "--channels")
+        {
+            ret.channel_count = parse_size(arg, value());
+        }
+        else if (arg == "--queue-format")
+        {
+            ret.queue_format = parse_pcm_format(arg, value());
+        }
+        else if (arg == "--crossfade")
+        {
+            ret.device_switch.crossfade_ms = parse_size(arg, value());
+        }
+        else if (arg == "--archive")
+        {
+            ret.archive_path = value();
+        }
+        else if (arg == "--analysis-rate")
+        {
+            ret.resampling.analysis_rate = parse_size(arg, value());
+        }
+        else if (arg == "--resample-quality")
+        {
+            ret.resampling.stopband_db = float(parse_size(arg, value()));
+        }
+        else if (arg == "--window")
+        {
+            ret.window.window_size_ms = float(parse_size(arg, value()));
+        }
+        else if (arg == "--engine")
+        {
+            ret.engine = parse_spectrum_engine(arg, value());
+        }
+        else if (arg == "--spectrum-format")
+        {
+            ret.spectrum_format = parse_spectrum_format(arg, value());
+        }
+        else if (arg == "--fft-planning")
+        {
+            ret.planning.rigor = parse_plan_rigor(arg, value());
+        }
+        else if (arg == "--wisdom")
+        {
+            ret.planning.wisdom_path = value();
+        }
+        else if (arg == "--no-wisdom")
+        {
+            ret.planning.use_wisdom = false;
+        }
+        else if (arg == "--fft-threads")
+        {
+            const std::string_view threads = value();
+            ret.planning.fft_threads = threads == "auto" ? 0 : parse_size(arg, threads.data());
+        }
+        else if (arg == "--hop")
+        {
+            ret.hop_size = parse_size(arg, value());
+        }
+        else if (arg == "--batch-hops")
+        {
+            ret.batch_hops = parse_size(arg, value());
+        }
+        else if (arg == "--backlog")
+        {
+            ret.backlog.policy = parse_backlog_policy(arg, value());
+        }
+        else if (arg == "--max-backlog")
+        {
+            ret.backlog.max_backlog_ms = parse_size(arg, value());
+        }
+        else if (arg == "--sched-capture")
+        {
+            parse_scheduling(arg, value(), ret.realtime.capture);
+        }
+        else if (arg == "--sched-analysis")
+        {
+            parse_scheduling(arg, value(), ret.realtime.analysis);
+        }
+        else if (arg == "--sched-render")
+        {
+            parse_scheduling(arg, value(), ret.realtime.render);
+        }
+        else if (arg == "--cpus-capture")
+        {
+            ret.realtime.capture.cpus = parse_cpu_list(arg, value());
+        }
+        else if (arg == "--cpus-analysis")
+        {
+            ret.realtime.analysis.cpus = parse_cpu_list(arg, value());
+        }
+        else if (arg == "--cpus-render")
+        {
+            ret.realtime.render.cpus = parse_cpu_list(arg, value());
+        }
+        else if (arg == "--mlock")
+        {
+            ret.realtime.lock_memory = true;
+        }
+        else if (arg == "--kernels")
+        {
+            ret.kernel_isa = parse_kernel_isa(arg, value());
+        }
+        else if (arg == "--fast")
+        {
+            ret.pacing = PlaybackPacing::AS_FAST_AS_POSSIBLE;
+        }
+        else if (arg == "--bench")
+        {
+            ret.benchmark = true;
+        }
+        else if (arg == "--bench-hop")
+        {
+            ret.benchmark_hop = parse_size(arg, value());
+        }
+        else if (arg == "--bench-kernels")
+        {
+            ret.kernel_benchmark = true;
+        }
+        else
+        {
+            throw std::runtime_error("Unknown argument '" + std::string(arg) + "'");
+        }
+    }
+
+    if (ret.raw_params)
+    {
+        ret.raw_params->sample_rate = ret.sample_rate;
+        ret.raw_params->channel_count = ret.channel_count;
+    }
+
+    if (ret.channel_count == 0)
+    {
+        throw std::runtime_error("--channels must be non-zero");
+    }
+
+    if (ret.input_path && ret.pipe_path)
+    {
+        throw std::runtime_error("--input and --pipe are mutually exclusive");
+    }
+
+    if (ret.hop_size == 0)
+    {
+        throw std::runtime_error("--hop must be non-zero");
+    }
+
+    if (ret.pipe_block_samples == 0 || ret.pipe_read_ahead_blocks == 0)
+    {
+        throw std::runtime_error("--block and --read-ahead must be non-zero");
+    }
+
+    if (ret.archive_path && (ret.input_path || ret.pipe_path))
+    {
+        throw std::runtime_error("--archive only applies to capture");
+    }
+
+    if (ret.benchmark && !ret.input_path)
+    {
+        throw std::runtime_error("--bench requires --input");
+    }
+
+    return ret;
+}
+
+void print_usage(const char* program_name)
+{
+    std::printf(
+        "usage: %s [options]\n"
+        "\n"
+        "input:\n"
+        "  --input <path>         analyze a WAV file instead of capturing audio\n"
+        "  --pipe <path|->        stream raw PCM from a named FIFO or stdin\n"
+        "  --block <samples>      samples per read from the pipe (default: 1024)\n"
+        "  --read-ahead <blocks>  blocks queued ahead of the analysis (default: 64)\n"
+        "  --raw <s16le|f32le>    headerless PCM format of the input file or pipe\n"
+        "                         (default for pipes: s16le)\n"
+        "  --rate <hz>            capture or raw PCM sample rate (default: 44100)\n"
+        "  --channels <count>     capture or raw PCM interleaved channel count\n"
+        "                         (default: 1, capture supports up to 2)\n"
+        "  --fast                 do not pace file playback to real time\n"
+        "  --queue-format <s16le|f32le>\n"
+        "                         capture queue sample format (default: s16le)\n"
+        "  --crossfade <ms>       crossfade when switching capture devices\n"
+        "                         (default: 20, 0 to cut over)\n"
+        "  --archive <path>       record the captured audio to a WAV file\n"
+        "\n"
+        "analysis:\n"
+        "  --analysis-rate <hz>   resample the input to this rate before the FFT\n"
+        "                         (default: no resampling)\n"
+        "  --resample-quality <db>\n"
+        "                         resampler stopband attenuation (default: 80)\n"
+        "  --window <ms>          FFT window duration, longer windows resolve low\n"
+        "                         notes better but react slower (default: 743)\n"
+        "  --engine <linear|multires|sdft>\n"
+        "                         spectrum analysis: one long FFT, one shorter\n"
+        "                         FFT per octave band, or a sliding DFT of the\n"
+        "                         note range (default: linear)\n"
+        "  --spectrum-format <f32|log16|log8>\n"
+        "                         spectra handed to the display as linear\n"
+        "                         magnitudes, or as levels in dB quantized to 16\n"
+        "                         or 8 bits (default: f32)\n"
+        "  --fft-planning <estimate|measure|patient>\n"
+        "                         FFTW planning rigor, plans beyond estimate get\n"
+        "                         built in the background (default: measure)\n"
+        "  --wisdom <path>        FFTW wisdom file (default: keyed by CPU, under\n"
+        "                         ~/.cache/spiralviz)\n"
+        "  --no-wisdom            neither load nor save FFTW wisdom\n"
+        "  --fft-threads <n|auto> threads each FFT may be split over, auto uses\n"
+        "                         the cores left over by channels for windows of\n"
+        "                         32768 samples and more (default: auto)\n"
+        "\n"
+        "latency:\n"
+        "  --hop <samples>        samples between two spectra (default: 512)\n"
+        "  --batch-hops <count>   when several hops are due at once, compute up to\n"
+        "                         this many of them in one batched FFT rather than\n"
+        "                         only the newest one (default: off)\n"
+        "  --backlog <drop|skip|stretch|unbounded>\n"
+        "                         how to catch up with samples queued beyond the\n"
+        "                         maximum backlog (default: drop)\n"
+        "  --max-backlog <ms>     maximum backlog (default: 100)\n"
+        "\n"
+        "real-time (settings that cannot be applied are reported, not fatal):\n"
+        "  --sched-capture <fifo|rr>[:priority]\n"
+        "                         real-time scheduling of the capture thread\n"
+        "                         (default priority: 50)\n"
+        "  --sched-analysis <fifo|rr>[:priority]\n"
+        "                         same for the analysis thread and its workers\n"
+        "  --sched-render <fifo|rr>[:priority]\n"
+        "                         same for the main thread\n"
+        "  --cpus-capture <list>  pin the capture thread to cores, e.g. 2,4-7\n"
+        "  --cpus-analysis <list> same for the analysis thread and its workers\n"
+        "  --cpus-render <list>   same for the main thread\n"
+        "  --mlock                lock all memory once allocated\n"
+        "  --kernels <scalar|sse2|avx2|avx512>\n"
+        "                         force the instruction set of the SIMD kernels\n"
+        "                         (default: best supported)\n"
+        "\n"
+        "benchmarking:\n"
+        "  --bench                analyze the whole input without a window, then\n"
+        "                         print timings\n"
+        "  --bench-hop <samples>  samples per analysis hop (default: --hop)\n"
+        "  --bench-kernels        time the SIMD kernels and whole hops for each\n"
+        "                         supported instruction set and window size\n",
+        program_name
+    );
+}
+
+std::unique_ptr<SampleSource> make_sample_source(const Options& options)
+{
+    if (options.input_path)
+    {
+        return std::make_unique<FileSampleSource>(*options.input_path, options.pacing, options.raw_params);
+    }
+
+    if (options.pipe_path)
+    {
+        return std::make_unique<PipeSampleSource>(PipeSourceParams{
+            .path = *options.pipe_path,
+            .pcm = options.raw_params.value_or(RawPCMParams{
+                .sample_rate = options.sample_rate,
+                .channel_count = options.channel_count
+            }),
+            .block_samples = options.pipe_block_samples,
+            .read_ahead_blocks = options.pipe_read_ahead_blocks,
+            .reader_schedule = options.realtime.capture
+        });
+    }
+
+    auto recorder = std::make_unique<SampleQueueRecorder>(options.queue_format, options.channel_count);
+    recorder->set_switch_config(options.device_switch);
+    recorder->set_capture_schedule(options.realtime.capture);
+
+    if (options.archive_path)
+    {
+        recorder->set_archiver(std::make_unique<CaptureArchiver>(ArchiveParams{
+            .path = *options.archive_path,
+            .sample_rate = options.sample_rate,
+            .channel_count = options.channel_count
+        }));
+    }
+
+    if (!recorder->start(options.sample_rate))
+    {
+        throw std::runtime_error("Failed to start audio capture");
+    }
+
+    return recorder;
+}
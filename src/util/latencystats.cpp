@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/util/latencystats.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+LatencyStats::LatencyStats(std::size_t window_size) :
+    m_window_size{std::max<std::size_t>(window_size, 1)}
+{
+    m_samples.reserve(m_window_size);
+}
+
+void LatencyStats::record(std::chrono::steady_clock::duration latency)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    if (m_samples.empty() && m_oldest == 0)
+    {
+        m_first_record = now;
+    }
+
+    const Sample sample{
+        .recorded_at_s = std::chrono::duration<double>(now - m_first_record).count(),
+        .latency_ms = std::chrono::duration<float, std::milli>(latency).count()
+    };
+
+    if (m_samples.size() < m_window_size)
+    {
+        m_samples.push_back(sample);
+        return;
+    }
+
+    m_samples[m_oldest] = sample;
+    m_oldest = (m_oldest + 1) % m_window_size;
+}
+
+void LatencyStats::clear()
+{
+    m_samples.clear();
+    m_oldest = 0;
+}
+
+float LatencyStats::percentile_ms(float fraction) const
+{
+    if (m_samples.empty())
+    {
+        return 0.0f;
+    }
+
+    std::vector<float> sorted(m_samples.size());
+    std::transform(m_samples.begin(), m_samples.end(), sorted.begin(), [](const Sample& s) { return s.latency_ms; });
+
+    // nearest-rank percentile
+    const auto rank = std::size_t(std::ceil(std::clamp(fraction, 0.0f, 1.0f) * sorted.size()));
+    const auto nth = sorted.begin() + std::max<std::size_t>(rank, 1) - 1;
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+}
+
+float LatencyStats::max_ms() const
+{
+    float ret = 0.0f;
+    for (const Sample& sample : m_samples)
+    {
+        ret = std::max(ret, sample.latency_ms);
+    }
+    return ret;
+}
+
+std::vector<float> LatencyStats::histogram(std::size_t bucket_count, float bucket_ms) const
+{
+    std::vector<float> ret(bucket_count);
+
+    if (bucket_count == 0)
+    {
+        return ret;
+    }
+
+    for (const Sample& sample : m_samples)
+    {
+        const auto bucket = std::size_t(std::max(sample.latency_ms, 0.0f) / bucket_ms);
+        ret[std::min(bucket, bucket_count - 1)] += 1.0f;
+    }
+
+    return ret;
+}
+
+void LatencyStats::export_csv(const std::string& path) const
+{
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file{std::fopen(path.c_str(), "w"), &std::fclose};
+
+    if (file == nullptr)
+    {
+        throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+    }
+
+    std::fprintf(file.get(), "time_s,latency_ms\n");
+
+    for (std::size_t i = 0; i < m_samples.size(); ++i)
+    {
+        const Sample& sample = m_samples[(m_oldest + i) % m_samples.size()];
+        std::fprintf(file.get(), "%.6f,%.3f\n", sample.recorded_at_s, sample.latency_ms);
+    }
+
+    if (std::ferror(file.get()))
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
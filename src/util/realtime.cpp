@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/util/realtime.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+namespace
+{
+std::mutex report_lock;
+std::vector<RealtimeReportEntry> report_entries;
+
+/// `hint` replaces the generic description of `error`, if provided.
+void report(std::string thread, std::string setting, int error, const char* hint = nullptr)
+{
+    std::string detail;
+
+    if (error != 0)
+    {
+        detail = hint != nullptr ? hint : std::strerror(error);
+    }
+
+    std::lock_guard lk{report_lock};
+    report_entries.push_back({
+        .thread = std::move(thread),
+        .setting = std::move(setting),
+        .applied = error == 0,
+        .detail = std::move(detail)
+    });
+}
+
+std::string cpu_list_string(const std::vector<std::size_t>& cpus)
+{
+    std::string ret;
+    for (std::size_t cpu : cpus)
+    {
+        ret += (ret.empty() ? "" : ",") + std::to_string(cpu);
+    }
+    return ret;
+}
+
+void apply_affinity(const std::vector<std::size_t>& cpus, const std::string& thread_name)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (std::size_t cpu : cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+
+    const int error = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    report(thread_name, "CPUs " + cpu_list_string(cpus), error);
+}
+
+void apply_policy(SchedulingPolicy policy, int priority, const std::string& thread_name)
+{
+    const int native_policy = policy == SchedulingPolicy::FIFO ? SCHED_FIFO : SCHED_RR;
+
+    sched_param param{};
+    param.sched_priority = std::clamp(
+        priority,
+        ::sched_get_priority_min(native_policy),
+        ::sched_get_priority_max(native_policy)
+    );
+
+    const int error = ::pthread_setschedparam(::pthread_self(), native_policy, &param);
+    report(
+        thread_name,
+        std::string(get_scheduling_policy_string(policy)) + " priority " + std::to_string(param.sched_priority),
+        error,
+        error == EPERM ? "not permitted, requires CAP_SYS_NICE or an rtprio limit" : nullptr
+    );
+}
+}
+
+void apply_thread_schedule(const ThreadSchedule& schedule, const std::string& thread_name)
+{
+    if (!schedule.cpus.empty())
+    {
+        apply_affinity(schedule.cpus, thread_name);
+    }
+
+    if (schedule.policy != SchedulingPolicy::DEFAULT)
+    {
+        apply_policy(schedule.policy, schedule.priority, thread_name);
+    }
+}
+
+void lock_process_memory()
+{
+    // only current mappings: with MCL_FUTURE, every thread spawned later would
+    // lock its whole stack, and fail to spawn past RLIMIT_MEMLOCK
+    const int error = ::mlockall(MCL_CURRENT) == 0 ? 0 : errno;
+
+    const char* hint = nullptr;
+    if (error == ENOMEM)
+    {
+        hint = "exceeds RLIMIT_MEMLOCK";
+    }
+    else if (error == EPERM)
+    {
+        hint = "not permitted, requires CAP_IPC_LOCK";
+    }
+
+    report("process", "memory locked", error, hint);
+}
+
+std::vector<RealtimeReportEntry> realtime_report()
+{
+    std::lock_guard lk{report_lock};
+    return report_entries;
+}
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (C) 2023 sdelang
+
+#include <spiralviz/util/taskpool.hpp>
+
+TaskPool::TaskPool(std::size_t worker_count)
+{
+    for (std::size_t i = 0; i < worker_count; ++i)
+    {
+        m_workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard lk{m_lock};
+        m_stop = true;
+    }
+
+    m_job_cv.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void TaskPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& task)
+{
+    if (m_workers.empty() || count <= 1)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard lk{m_lock};
+        m_task = &task;
+        m_task_count = count;
+        m_next_task.store(0, std::memory_order_relaxed);
+        m_busy_workers = m_workers.size();
+        ++m_generation;
+    }
+
+    m_job_cv.notify_all();
+
+    run_tasks();
+
+    std::unique_lock lk{m_lock};
+    m_done_cv.wait(lk, [&] { return m_busy_workers == 0; });
+    m_task = nullptr;
+}
+
+void TaskPool::run_on_workers(const std::function<void(std::size_t)>& task)
+{
+    if (m_workers.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lk{m_lock};
+        m_worker_task = &task;
+        m_busy_workers = m_workers.size();
+        ++m_generation;
+    }
+
+    m_job_cv.notify_all();
+
+    std::unique_lock lk{m_lock};
+    m_done_cv.wait(lk, [&] { return m_busy_workers == 0; });
+    m_worker_task = nullptr;
+}
+
+void TaskPool::run_tasks()
+{
+    for (;;)
+    {
+        const std::size_t i = m_next_task.fetch_add(1, std::memory_order_relaxed);
+
+        if (i >= m_task_count)
+        {
+            return;
+        }
+
+        (*m_task)(i);
+    }
+}
+
+void TaskPool::worker_loop(std::size_t worker_index)
+{
+    std::uint64_t seen_generation = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock lk{m_lock};
+            m_job_cv.wait(lk, [&] { return m_stop || m_generation != seen_generation; });
+
+            if (m_stop)
+            {
+                return;
+            }
+
+            seen_generation = m_generation;
+        }
+
+        if (m_worker_task != nullptr)
+        {
+            (*m_worker_task)(worker_index);
+        }
+        else
+        {
+            run_tasks();
+        }
+
+        {
+            std::lock_guard lk{m_lock};
+            --m_busy_workers;
+        }
+
+        m_done_cv.notify_one();
+    }
+}
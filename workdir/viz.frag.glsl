@@ -23,10 +23,30 @@ uniform sampler2D fft;
 // texture.
 uniform int fft_size;
 
-// Sample rate of the audio signal in Hz.
-// Might have gotten resampled during recording. Typically 44100Hz.
+// Sample rate of the analyzed audio signal in Hz.
+// This is the analysis rate, which differs from the capture rate when the
+// signal gets resampled before the FFT.
 uniform float sample_rate;
 
+// How the bins of the `fft` texture map to frequencies, see `SpectrumLayout`.
+// 0: linear FFT bins from 0 Hz to sample_rate / 2
+// 1: bin i at spectrum_min_freq * 2^(i * spectrum_cents_per_bin / 1200)
+uniform int spectrum_scale;
+uniform float spectrum_min_freq;
+uniform float spectrum_cents_per_bin;
+
+// The `fft` texture may only hold the bins that get displayed: its texel i is
+// bin spectrum_first_bin + i of a spectrum of spectrum_full_size bins.
+uniform float spectrum_first_bin;
+uniform float spectrum_full_size;
+
+// Whether the `fft` texels hold levels in dB rather than linear magnitudes,
+// normalized from spectrum_min_db (0) to spectrum_max_db (1), see
+// `EncodedSpectrum`.
+uniform int spectrum_log; // bool 0/1
+uniform float spectrum_min_db;
+uniform float spectrum_max_db;
+
 // Spiral visual parameters from https://www.shadertoy.com/view/WtjSWt
 // Also some other viz related parameters
 // Uniforms because the application may need to use the same values.
@@ -60,6 +80,18 @@ void main() {
     float bin        = freq / sample_rate;
     float bri;
 
+    if (spectrum_scale == 1)
+    {
+        // the linear lookup above maps `freq` to the bin of freq / 2, as the
+        // texture only goes up to sample_rate / 2: show that same frequency
+        float bin_cents = 1200. * log2(0.5 * freq / spectrum_min_freq) / spectrum_cents_per_bin;
+        bin = (bin_cents + 0.5 - spectrum_first_bin) / float(fft_size);
+    }
+    else
+    {
+        bin = (bin * spectrum_full_size - spectrum_first_bin) / float(fft_size);
+    }
+
     if (smooth_fft == 1)
     {
         bri = texture(fft, vec2(bin, 0.25)).r;
@@ -74,6 +106,14 @@ void main() {
         return;
     }
 
+    if (spectrum_log == 1)
+    {
+        // back to the magnitude, so that the volume range means the same
+        // whatever the format, where the lowest level stands for silence
+        float db = mix(spectrum_min_db, spectrum_max_db, bri);
+        bri = bri > 0. ? pow(10., db / 20.) : 0.;
+    }
+
     bri = (bri - vol_min) / (vol_max - vol_min);
     bri = max(bri, 0.);
 
@@ -85,7 +125,7 @@ void main() {
 
     float circles = mod(offset, spiral_dis);
     vec3  col     = (
-        bin > 1.
+        bin > 1. || bin < 0.
         ? vec3(0., 0., 0.)
         : (smoothstep(circles-spiral_blur, circles, spiral_width) -
            smoothstep(circles, circles+spiral_blur, spiral_width)) * lineColor);